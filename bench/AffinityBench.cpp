@@ -0,0 +1,96 @@
+#include "BenchHarness.h"
+#include "net/CpuAffinity.h"
+
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <thread>
+
+using namespace mini_http;
+
+// What worker placement buys on multi-socket machines: the cost of a cache
+// line bouncing between two pinned threads, and of a worker touching a
+// connection buffer first-touched on its own node versus another node.
+namespace {
+    // 4096 connections' worth of 16 KiB buffers, well past the caches.
+    constexpr size_t BUFFER_SIZE = 4096 * 16 * 1024;
+
+    bool pickCpus(bool crossNode, int& a, int& b, bench::State& state) {
+        std::vector<CpuSet> nodes = numaNodes();
+
+        if (crossNode) {
+            if (nodes.size() < 2) {
+                state.skip("needs two NUMA nodes");
+                return false;
+            }
+            a = nodes[0].front();
+            b = nodes[1].front();
+        } else {
+            if (nodes[0].size() < 2) {
+                state.skip("needs two CPUs on one node");
+                return false;
+            }
+            a = nodes[0][0];
+            b = nodes[0][1];
+        }
+        return true;
+    }
+
+    void pingPong(bool crossNode, bench::State& state) {
+        int cpuA, cpuB;
+        if (!pickCpus(crossNode, cpuA, cpuB, state)) return;
+
+        alignas(64) std::atomic<size_t> turn { 0 };
+        size_t rounds = state.iterations();
+
+        std::thread peer([&] {
+            pinCurrentThread({ cpuB });
+            for (size_t i = 0; i < rounds; ++i) {
+                while (turn.load(std::memory_order_acquire) != 2 * i + 1) {}
+                turn.store(2 * i + 2, std::memory_order_release);
+            }
+        });
+
+        pinCurrentThread({ cpuA });
+
+        state.startTiming();
+        for (size_t i = 0; i < rounds; ++i) {
+            turn.store(2 * i + 1, std::memory_order_release);
+            while (turn.load(std::memory_order_acquire) != 2 * i + 2) {}
+        }
+        state.stopTiming();
+
+        peer.join();
+    }
+
+    // The buffers are allocated and first touched on one CPU, then rewritten
+    // from another, like connection buffers warmed on one node and served on
+    // the other.
+    void bufferTouch(bool crossNode, bench::State& state) {
+        int owner, worker;
+        if (!pickCpus(crossNode, owner, worker, state)) return;
+
+        std::unique_ptr<char[]> buffer;
+        std::thread([&] {
+            pinCurrentThread({ owner });
+            buffer.reset(new char[BUFFER_SIZE]);
+            std::memset(buffer.get(), 1, BUFFER_SIZE);
+        }).join();
+
+        std::thread([&] {
+            pinCurrentThread({ worker });
+
+            state.startTiming();
+            for (size_t i = 0; i < state.iterations(); ++i) {
+                std::memset(buffer.get(), static_cast<int>(i), BUFFER_SIZE);
+                bench::doNotOptimize(buffer[i % BUFFER_SIZE]);
+            }
+            state.stopTiming();
+        }).join();
+    }
+}
+
+MINI_HTTP_BENCH("Affinity::pingpong/same_node", [](bench::State& s) { pingPong(false, s); });
+MINI_HTTP_BENCH("Affinity::pingpong/cross_node", [](bench::State& s) { pingPong(true, s); });
+MINI_HTTP_BENCH("Affinity::buffers_64MiB/same_node", [](bench::State& s) { bufferTouch(false, s); });
+MINI_HTTP_BENCH("Affinity::buffers_64MiB/cross_node", [](bench::State& s) { bufferTouch(true, s); });
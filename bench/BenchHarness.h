@@ -0,0 +1,67 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace mini_http::bench {
+    uint64_t allocationCount();
+
+    // A benchmark body runs its operation state.iterations() times. Work
+    // before startTiming() or after stopTiming() is excluded from ns/op and
+    // allocs/op. The harness grows the iteration count until a timed run
+    // lasts long enough to measure reliably.
+    class State {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        explicit State(size_t iterations);
+
+        size_t iterations() const { return iterations_; }
+
+        void startTiming();
+        void stopTiming();
+
+        // Marks the benchmark as not runnable here (e.g. missing hardware).
+        void skip(std::string reason) { skipped_ = std::move(reason); }
+        const std::string& skipped() const { return skipped_; }
+
+        bool stopped() const { return stopped_; }
+        double seconds() const;
+        uint64_t allocations() const;
+
+    private:
+        size_t iterations_;
+        Clock::time_point start_;
+        Clock::time_point stop_;
+        uint64_t allocsAtStart_;
+        uint64_t allocsAtStop_;
+        bool stopped_ = false;
+        std::string skipped_;
+    };
+
+    using BenchFn = std::function<void(State& state)>;
+
+    struct Registration {
+        Registration(std::string name, BenchFn fn);
+    };
+
+    template <typename T>
+    inline void doNotOptimize(const T& value) {
+        #if defined(__GNUC__) || defined(__clang__)
+            asm volatile("" : : "r,m"(value) : "memory");
+        #else
+            static volatile const void* sink;
+            sink = &value;
+        #endif
+    }
+}
+
+#define MINI_HTTP_BENCH_CONCAT_(a, b) a##b
+#define MINI_HTTP_BENCH_CONCAT(a, b) MINI_HTTP_BENCH_CONCAT_(a, b)
+#define MINI_HTTP_BENCH(name, fn) \
+    static ::mini_http::bench::Registration \
+        MINI_HTTP_BENCH_CONCAT(benchRegistration_, __LINE__)(name, fn)
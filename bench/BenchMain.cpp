@@ -0,0 +1,132 @@
+#include "BenchHarness.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace {
+    std::atomic<uint64_t> allocations { 0 };
+
+    struct Benchmark {
+        std::string name;
+        mini_http::bench::BenchFn fn;
+    };
+
+    std::vector<Benchmark>& registry() {
+        static std::vector<Benchmark> benchmarks;
+        return benchmarks;
+    }
+}
+
+void* operator new(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+namespace mini_http::bench {
+    Registration::Registration(std::string name, BenchFn fn) {
+        registry().push_back({std::move(name), std::move(fn)});
+    }
+
+    uint64_t allocationCount() {
+        return allocations.load(std::memory_order_relaxed);
+    }
+
+    State::State(size_t iterations)
+        : iterations_(iterations)
+    {
+        startTiming();
+    }
+
+    void State::startTiming() {
+        stopped_ = false;
+        allocsAtStart_ = allocationCount();
+        start_ = Clock::now();
+    }
+
+    void State::stopTiming() {
+        stop_ = Clock::now();
+        allocsAtStop_ = allocationCount();
+        stopped_ = true;
+    }
+
+    double State::seconds() const {
+        return std::chrono::duration<double>(stop_ - start_).count();
+    }
+
+    uint64_t State::allocations() const {
+        return allocsAtStop_ - allocsAtStart_;
+    }
+}
+
+int main(int argc, char** argv) {
+    std::string filter;
+    double minSeconds = 0.2;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--min-time") == 0 && i + 1 < argc)
+            minSeconds = std::atof(argv[++i]);
+        else
+            filter = argv[i];
+    }
+
+    std::printf("%-48s %12s %12s %12s\n", "benchmark", "iterations", "ns/op", "allocs/op");
+
+    for (auto& bench : registry()) {
+        if (!filter.empty() && bench.name.find(filter) == std::string::npos)
+            continue;
+
+        size_t iterations = 1;
+        double seconds = 0;
+        uint64_t allocs = 0;
+
+        {
+            mini_http::bench::State warmup(1);
+            bench.fn(warmup);
+
+            if (!warmup.skipped().empty()) {
+                std::printf("%-48s skipped: %s\n", bench.name.c_str(), warmup.skipped().c_str());
+                continue;
+            }
+        }
+
+        while (true) {
+            mini_http::bench::State state(iterations);
+            bench.fn(state);
+            if (!state.stopped()) state.stopTiming();
+
+            seconds = state.seconds();
+            allocs = state.allocations();
+
+            if (seconds >= minSeconds || iterations >= (size_t(1) << 30))
+                break;
+
+            double scale = seconds > 0 ? (minSeconds * 1.2) / seconds : 100;
+            scale = std::clamp(scale, 2.0, 100.0);
+            iterations = static_cast<size_t>(static_cast<double>(iterations) * scale);
+        }
+
+        std::printf("%-48s %12zu %12.1f %12.2f\n",
+                    bench.name.c_str(),
+                    iterations,
+                    seconds * 1e9 / static_cast<double>(iterations),
+                    static_cast<double>(allocs) / static_cast<double>(iterations));
+    }
+
+    return 0;
+}
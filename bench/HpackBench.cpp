@@ -0,0 +1,82 @@
+#include "BenchHarness.h"
+#include "http/Hpack.h"
+
+using namespace mini_http;
+
+namespace {
+    const HeaderList REQUEST = {
+        { ":method", "GET" },
+        { ":scheme", "http" },
+        { ":path", "/api/users/42?fields=name,email" },
+        { ":authority", "localhost:8080" },
+        { "user-agent", "Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko)" },
+        { "accept", "application/json" },
+        { "accept-encoding", "gzip, deflate, br" },
+        { "cookie", "session=8f2b1c7d9e3a4f60" },
+    };
+
+    const HeaderList RESPONSE = {
+        { ":status", "200" },
+        { "content-type", "application/json" },
+        { "date", "Mon, 19 Oct 2026 10:00:00 GMT" },
+        { "content-length", "128" },
+    };
+
+    // Later blocks of a connection, once the dynamic table is warm.
+    void encode(const HeaderList& fields, bench::State& state) {
+        HpackEncoder encoder;
+        std::string block;
+        encoder.encode(fields, block);
+
+        state.startTiming();
+        for (size_t i = 0; i < state.iterations(); ++i) {
+            block.clear();
+            encoder.encode(fields, block);
+            bench::doNotOptimize(block);
+        }
+    }
+
+    // A cold block inserts every field into a fresh table; a warm one is
+    // all indexed references into the table the first block built.
+    void decode(bool warm, bench::State& state) {
+        HpackEncoder encoder;
+        std::string first, block;
+        encoder.encode(REQUEST, first);
+        encoder.encode(REQUEST, block);
+
+        HpackDecoder shared;
+        HeaderList fields;
+        shared.decode(first, fields, 16384);
+
+        state.startTiming();
+        for (size_t i = 0; i < state.iterations(); ++i) {
+            fields.clear();
+            if (warm) {
+                shared.decode(block, fields, 16384);
+            } else {
+                HpackDecoder decoder;
+                decoder.decode(first, fields, 16384);
+            }
+            bench::doNotOptimize(fields);
+        }
+    }
+
+    void huffman(bench::State& state) {
+        std::string value(REQUEST[4].value);
+        std::string encoded, decoded;
+        huffmanEncode(encoded, value);
+
+        state.startTiming();
+        for (size_t i = 0; i < state.iterations(); ++i) {
+            decoded.clear();
+            huffmanDecode(decoded, encoded);
+            bench::doNotOptimize(decoded);
+        }
+    }
+}
+
+MINI_HTTP_BENCH("Hpack::encode/request", [](bench::State& state) { encode(REQUEST, state); });
+MINI_HTTP_BENCH("Hpack::encode/response", [](bench::State& state) { encode(RESPONSE, state); });
+MINI_HTTP_BENCH("Hpack::decode/request_cold", [](bench::State& state) { decode(false, state); });
+MINI_HTTP_BENCH("Hpack::decode/request_warm", [](bench::State& state) { decode(true, state); });
+MINI_HTTP_BENCH("Hpack::huffmanDecode/user_agent", [](bench::State& state) { huffman(state); });
@@ -0,0 +1,419 @@
+#include "LoadGenerator.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace mini_http::bench {
+    namespace {
+        using Clock = std::chrono::steady_clock;
+
+        struct Client {
+            int fd = -1;
+            bool connected = false;
+            bool writing = false;
+            bool broken = false;
+            std::string in;
+            std::string out;
+            size_t outOffset = 0;
+            std::deque<Clock::time_point> inflight;
+        };
+
+        struct WorkerStats {
+            std::vector<uint64_t> counts;
+            uint64_t sumNanos = 0;
+            uint64_t requests = 0;
+            uint64_t errors = 0;
+            uint64_t reconnects = 0;
+            uint64_t maxNanos = 0;
+        };
+
+        class Worker {
+        public:
+            Worker(const LoadOptions& options, size_t connections, double rate)
+                : options(options), rate(rate), clients(connections)
+            {
+                request = "GET " + options.path + " HTTP/1.1\r\n"
+                        "Host: " + options.host + "\r\n"
+                        "User-Agent: mini_http_bench\r\n";
+                request += options.keepAlive ? "\r\n" : "Connection: close\r\n\r\n";
+            }
+
+            void run(Clock::time_point start, Clock::time_point measureFrom,
+                    Clock::time_point end)
+            {
+                this->measureFrom = measureFrom;
+
+                epollFd = epoll_create1(EPOLL_CLOEXEC);
+                if (epollFd < 0) return;
+
+                for (auto& client : clients)
+                    connect(client);
+
+                interval = rate > 0 ? std::chrono::duration_cast<Clock::duration>(
+                    std::chrono::duration<double>(1.0 / rate)) : Clock::duration::zero();
+                nextSend = start;
+
+                if (rate <= 0) {
+                    for (auto& client : clients) {
+                        for (size_t i = 0; i < options.pipeline; ++i)
+                            enqueue(client, Clock::now());
+                    }
+                }
+
+                epoll_event events[256];
+
+                while (true) {
+                    auto now = Clock::now();
+                    if (now >= end) break;
+
+                    if (rate > 0) schedule(now);
+
+                    int timeoutMs = 10;
+                    if (rate > 0) {
+                        auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(nextSend - now);
+                        timeoutMs = static_cast<int>(std::clamp<int64_t>(wait.count(), 0, 10));
+                    }
+
+                    int ready = epoll_wait(epollFd, events, 256, timeoutMs);
+                    if (ready < 0) {
+                        if (errno == EINTR) continue;
+                        break;
+                    }
+
+                    for (int i = 0; i < ready; ++i) {
+                        Client& client = clients[events[i].data.u64];
+
+                        if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                            if (!(events[i].events & EPOLLIN)) {
+                                reconnect(client);
+                                continue;
+                            }
+                        }
+
+                        if (events[i].events & EPOLLOUT) {
+                            client.connected = true;
+                            flush(client);
+                        }
+
+                        if ((events[i].events & EPOLLIN) && !client.broken)
+                            receive(client);
+
+                        if (client.broken)
+                            reconnect(client);
+                    }
+                }
+
+                for (auto& client : clients) {
+                    if (client.fd >= 0) ::close(client.fd);
+                }
+                ::close(epollFd);
+            }
+
+            WorkerStats stats;
+
+        private:
+            const LoadOptions& options;
+            double rate;
+            std::vector<Client> clients;
+            std::string request;
+            int epollFd = -1;
+
+            Clock::time_point measureFrom;
+            Clock::time_point nextSend;
+            Clock::duration interval;
+            std::deque<Clock::time_point> backlog;
+            size_t roundRobin = 0;
+
+            void connect(Client& client) {
+                client.fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+                if (client.fd < 0) return;
+
+                int one = 1;
+                setsockopt(client.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+                sockaddr_in addr{};
+                addr.sin_family = AF_INET;
+                addr.sin_port = htons(static_cast<uint16_t>(options.port));
+                inet_pton(AF_INET, options.host.c_str(), &addr.sin_addr);
+
+                client.connected = false;
+                int rc = ::connect(client.fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+                if (rc == 0) client.connected = true;
+                else if (errno != EINPROGRESS) {
+                    ::close(client.fd);
+                    client.fd = -1;
+                    return;
+                }
+
+                // Until the connect completes we wait for writability.
+                client.writing = !client.connected;
+
+                epoll_event ev{};
+                ev.events = EPOLLIN | (client.writing ? EPOLLOUT : 0u);
+                ev.data.u64 = static_cast<uint64_t>(&client - clients.data());
+                epoll_ctl(epollFd, EPOLL_CTL_ADD, client.fd, &ev);
+            }
+
+            void watchWrites(Client& client, bool enable) {
+                if (client.writing == enable || client.fd < 0) return;
+                client.writing = enable;
+
+                epoll_event ev{};
+                ev.events = EPOLLIN | (enable ? EPOLLOUT : 0u);
+                ev.data.u64 = static_cast<uint64_t>(&client - clients.data());
+                epoll_ctl(epollFd, EPOLL_CTL_MOD, client.fd, &ev);
+            }
+
+            void reconnect(Client& client) {
+                if (client.fd >= 0) {
+                    epoll_ctl(epollFd, EPOLL_CTL_DEL, client.fd, nullptr);
+                    ::close(client.fd);
+                }
+
+                ++stats.reconnects;
+
+                // Requests that never got an answer are sent again on the
+                // new connection, keeping their original start times.
+                std::deque<Clock::time_point> pending;
+                pending.swap(client.inflight);
+
+                client.in.clear();
+                client.out.clear();
+                client.outOffset = 0;
+                client.broken = false;
+
+                connect(client);
+                if (client.fd < 0) return;
+
+                for (auto sentAt : pending)
+                    enqueue(client, sentAt);
+
+                if (rate <= 0) {
+                    while (client.inflight.size() < options.pipeline)
+                        enqueue(client, Clock::now());
+                }
+            }
+
+            void schedule(Clock::time_point now) {
+                while (nextSend <= now) {
+                    backlog.push_back(nextSend);
+                    nextSend += interval;
+                }
+
+                while (!backlog.empty()) {
+                    Client* target = nullptr;
+                    for (size_t i = 0; i < clients.size(); ++i) {
+                        Client& candidate = clients[(roundRobin + i) % clients.size()];
+                        if (candidate.fd >= 0 && candidate.inflight.size() < options.pipeline) {
+                            target = &candidate;
+                            roundRobin = (roundRobin + i + 1) % clients.size();
+                            break;
+                        }
+                    }
+
+                    if (!target) break;
+
+                    enqueue(*target, backlog.front());
+                    backlog.pop_front();
+
+                    if (target->broken)
+                        reconnect(*target);
+                }
+            }
+
+            void enqueue(Client& client, Clock::time_point startedAt) {
+                if (client.fd < 0) return;
+                client.inflight.push_back(startedAt);
+                client.out += request;
+                if (client.connected) flush(client);
+            }
+
+            void flush(Client& client) {
+                while (client.outOffset < client.out.size()) {
+                    ssize_t n = ::send(client.fd, client.out.data() + client.outOffset,
+                                    client.out.size() - client.outOffset, MSG_NOSIGNAL);
+                    if (n < 0) {
+                        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                            watchWrites(client, true);
+                            return;
+                        }
+                        if (errno == EINTR) continue;
+                        client.broken = true;
+                        return;
+                    }
+                    client.outOffset += static_cast<size_t>(n);
+                }
+
+                client.out.clear();
+                client.outOffset = 0;
+                watchWrites(client, false);
+            }
+
+            void receive(Client& client) {
+                char buffer[65536];
+                bool closed = false;
+
+                while (true) {
+                    ssize_t n = ::recv(client.fd, buffer, sizeof(buffer), 0);
+                    if (n > 0) {
+                        client.in.append(buffer, static_cast<size_t>(n));
+                        continue;
+                    }
+                    if (n == 0) closed = true;
+                    else if (errno == EINTR) continue;
+                    else if (errno != EAGAIN && errno != EWOULDBLOCK) closed = true;
+                    break;
+                }
+
+                if (consume(client) || closed)
+                    client.broken = true;
+            }
+
+            // Parses every complete response in the buffer. Returns true
+            // when the server announced it is closing the connection.
+            bool consume(Client& client) {
+                size_t offset = 0;
+                bool closing = false;
+
+                while (!client.inflight.empty()) {
+                    size_t headerEnd = client.in.find("\r\n\r\n", offset);
+                    if (headerEnd == std::string::npos) break;
+
+                    size_t contentLength = 0;
+                    bool connectionClose = false;
+                    size_t line = client.in.find("\r\n", offset);
+                    int status = 0;
+                    if (client.in.size() > offset + 12)
+                        status = std::atoi(client.in.c_str() + offset + 9);
+
+                    while (line != std::string::npos && line < headerEnd) {
+                        size_t next = client.in.find("\r\n", line + 2);
+                        const char* header = client.in.c_str() + line + 2;
+                        size_t length = next - line - 2;
+
+                        if (length > 15 && strncasecmp(header, "content-length:", 15) == 0)
+                            contentLength = std::strtoul(header + 15, nullptr, 10);
+                        else if (length >= 17 && strncasecmp(header, "connection: close", 17) == 0)
+                            connectionClose = true;
+
+                        line = next;
+                    }
+
+                    size_t total = headerEnd + 4 + contentLength;
+                    if (client.in.size() < total) break;
+
+                    record(client.inflight.front(), status);
+                    client.inflight.pop_front();
+                    offset = total;
+
+                    if (connectionClose || !options.keepAlive) {
+                        closing = true;
+                        break;
+                    }
+
+                    if (rate <= 0)
+                        enqueue(client, Clock::now());
+                }
+
+                client.in.erase(0, offset);
+                return closing;
+            }
+
+            void record(Clock::time_point startedAt, int status) {
+                auto now = Clock::now();
+                if (now < measureFrom) return;
+
+                uint64_t nanos = static_cast<uint64_t>(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(now - startedAt).count());
+
+                stats.counts[LatencyHistogram::bucketIndex(nanos)]++;
+                stats.sumNanos += nanos;
+                stats.maxNanos = std::max(stats.maxNanos, nanos);
+                ++stats.requests;
+                if (status < 200 || status >= 400) ++stats.errors;
+            }
+        };
+    }
+
+    LoadResult runLoad(const LoadOptions& options) {
+        size_t threads = std::max<size_t>(1, options.threads);
+        size_t connections = std::max(options.connections, threads);
+
+        std::vector<std::unique_ptr<Worker>> workers;
+        for (size_t t = 0; t < threads; ++t) {
+            size_t share = connections / threads + (t < connections % threads ? 1 : 0);
+            auto worker = std::make_unique<Worker>(options, share, options.rate / static_cast<double>(threads));
+            worker->stats.counts.assign(LatencyHistogram::BUCKET_COUNT, 0);
+            workers.push_back(std::move(worker));
+        }
+
+        auto start = Clock::now();
+        auto measureFrom = start + options.warmup;
+        auto end = measureFrom + options.duration;
+
+        std::vector<std::thread> running;
+        for (auto& worker : workers) {
+            running.emplace_back([&worker, start, measureFrom, end] {
+                worker->run(start, measureFrom, end);
+            });
+        }
+        for (auto& thread : running) thread.join();
+
+        LoadResult result;
+        std::vector<uint64_t> counts(LatencyHistogram::BUCKET_COUNT, 0);
+        uint64_t sumNanos = 0;
+        uint64_t maxNanos = 0;
+
+        for (auto& worker : workers) {
+            for (size_t i = 0; i < counts.size(); ++i)
+                counts[i] += worker->stats.counts[i];
+            sumNanos += worker->stats.sumNanos;
+            maxNanos = std::max(maxNanos, worker->stats.maxNanos);
+            result.requests += worker->stats.requests;
+            result.errors += worker->stats.errors;
+            result.reconnects += worker->stats.reconnects;
+        }
+
+        result.seconds = std::chrono::duration<double>(options.duration).count();
+        result.requestsPerSecond = static_cast<double>(result.requests) / result.seconds;
+        result.latency = LatencyHistogram::summarize(counts, sumNanos);
+        result.maxLatency = static_cast<double>(maxNanos) / 1e9;
+        return result;
+    }
+
+    std::string formatResult(const LoadOptions& options, const LoadResult& result) {
+        char buffer[1024];
+        std::snprintf(buffer, sizeof(buffer),
+            "%s loop, %zu threads, %zu connections, pipeline %zu%s%s\n"
+            "  requests   %llu in %.2fs (%llu errors, %llu reconnects)\n"
+            "  throughput %.0f req/s\n"
+            "  latency    p50 %.1fus  p90 %.1fus  p99 %.1fus  p99.9 %.1fus  max %.1fus\n",
+            options.rate > 0 ? "open" : "closed",
+            options.threads, options.connections, options.pipeline,
+            options.keepAlive ? ", keep-alive" : ", close",
+            options.rate > 0 ? (", target " + std::to_string(static_cast<long long>(options.rate)) + " req/s").c_str() : "",
+            static_cast<unsigned long long>(result.requests), result.seconds,
+            static_cast<unsigned long long>(result.errors),
+            static_cast<unsigned long long>(result.reconnects),
+            result.requestsPerSecond,
+            result.latency.p50 * 1e6, result.latency.p90 * 1e6,
+            result.latency.p99 * 1e6, result.latency.p999 * 1e6,
+            result.maxLatency * 1e6);
+        return buffer;
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "core/LatencyHistogram.h"
+
+namespace mini_http::bench {
+    // Epoll-driven HTTP/1.1 load generator.
+    //
+    // With rate == 0 it runs closed-loop: every connection keeps `pipeline`
+    // requests in flight and sends the next one as soon as a response
+    // arrives. With rate > 0 it runs open-loop: requests are scheduled at
+    // fixed intervals and latency is measured from the scheduled send time,
+    // so stalls in the server are not hidden by the generator backing off
+    // (coordinated omission).
+    struct LoadOptions {
+        std::string host = "127.0.0.1";
+        int port = 18080;
+        std::string path = "/";
+        size_t threads = 1;
+        size_t connections = 16;
+        size_t pipeline = 1;
+        double rate = 0;
+        bool keepAlive = true;
+        std::chrono::milliseconds duration { 5000 };
+        std::chrono::milliseconds warmup { 500 };
+    };
+
+    struct LoadResult {
+        uint64_t requests = 0;
+        uint64_t errors = 0;
+        uint64_t reconnects = 0;
+        double seconds = 0;
+        double requestsPerSecond = 0;
+        LatencySnapshot latency;
+        double maxLatency = 0;
+    };
+
+    LoadResult runLoad(const LoadOptions& options);
+
+    std::string formatResult(const LoadOptions& options, const LoadResult& result);
+}
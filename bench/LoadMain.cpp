@@ -0,0 +1,257 @@
+#include "LoadGenerator.h"
+#include <mini_http/mini_http.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include <sys/resource.h>
+
+using namespace mini_http;
+
+namespace {
+    void usage() {
+        std::printf(
+            "usage: mini_http_bench [options]\n"
+            "  --target HOST:PORT   load an external server instead of the in-process App\n"
+            "  --path PATH          request path (default /plaintext)\n"
+            "  -t N                 load generator threads (default 1)\n"
+            "  -c N                 connections (default 16)\n"
+            "  -p N                 pipelined requests per connection (default 1)\n"
+            "  -R RATE              open-loop request rate per second (default closed loop)\n"
+            "  -d SECONDS           measured duration (default 5)\n"
+            "  --warmup SECONDS     unmeasured warmup (default 0.5)\n"
+            "  --close              send Connection: close on every request\n"
+            "  --server-threads N   worker threads of the in-process App (default 4)\n"
+            "  --port N             port for the in-process App (default 18080)\n"
+            "\n"
+            "in-process server tuning (see ServerOptions):\n"
+            "  --backlog N  --nagle (TCP_NODELAY off)  --defer-accept SECONDS  --fastopen N\n"
+            "  --rcvbuf BYTES  --sndbuf BYTES  --quickack  --busy-poll USEC\n"
+            "  --pin-workers CPU,CPU,...  --accept-cpu CPU  --numa\n"
+            "  --matrix             run the load once per socket option and compare\n"
+            "\n"
+            "reverse proxy overhead:\n"
+            "  --proxy N            put N in-process backends behind an in-process proxy\n"
+            "                       and compare against loading one backend directly\n"
+            "  --balance MODE       rr, least or p2c (default least)\n");
+    }
+
+    struct Variant {
+        const char* name;
+        void (*apply)(ServerOptions&);
+    };
+
+    // Each row changes one option from the defaults.
+    const Variant MATRIX[] = {
+        { "defaults",                [](ServerOptions&) {} },
+        { "TCP_NODELAY off",         [](ServerOptions& o) { o.noDelay = false; } },
+        { "backlog 4096",            [](ServerOptions& o) { o.backlog = 4096; } },
+        { "TCP_DEFER_ACCEPT 1s",     [](ServerOptions& o) { o.deferAccept = 1; } },
+        { "TCP_FASTOPEN 256",        [](ServerOptions& o) { o.fastOpen = 256; } },
+        { "SO_RCVBUF/SNDBUF 256K",   [](ServerOptions& o) { o.receiveBuffer = o.sendBuffer = 256 * 1024; } },
+        { "TCP_QUICKACK",            [](ServerOptions& o) { o.quickAck = true; } },
+        { "SO_BUSY_POLL 50us",       [](ServerOptions& o) { o.busyPoll = 50; } },
+    };
+
+    // CPU time of the whole process (server and generator threads) per
+    // completed request.
+    struct Measured {
+        bench::LoadResult result;
+        double cpuPerRequest = 0;
+    };
+
+    double cpuSeconds() {
+        rusage usage {};
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+            + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+    }
+
+    Measured measure(const bench::LoadOptions& options) {
+        Measured measured;
+        double before = cpuSeconds();
+        measured.result = bench::runLoad(options);
+        double spent = cpuSeconds() - before;
+        if (measured.result.requests > 0)
+            measured.cpuPerRequest = spent / measured.result.requests;
+        return measured;
+    }
+
+    void registerRoutes(App& app) {
+        app.get("/plaintext", [](Request&, Response& res) {
+            res.send("Hello, World!");
+        });
+        app.get("/json", [](Request&, Response& res) {
+            res.json({{"message", "Hello, World!"}});
+        });
+        app.get("/users/:id", [](Request& req, Response& res) {
+            res.json({{"id", req.params["id"]}, {"name", "User"}});
+        });
+        app.getStatic("/health", HttpStatus::OK, "ok");
+
+        // Holds each request for 10 ms without holding a worker, so -c can
+        // far exceed --server-threads.
+        app.get("/sleep", taskHandler([&app](Request&, Response& res) -> Task<> {
+            co_await sleepFor(app.loop(), std::chrono::milliseconds(10));
+            res.send("Hello, World!");
+        }));
+    }
+}
+
+int main(int argc, char** argv) {
+    bench::LoadOptions options;
+    options.path = "/plaintext";
+
+    std::string target;
+    size_t serverThreads = 4;
+    ServerOptions serverOptions;
+    bool matrix = false;
+    size_t proxyBackends = 0;
+    Balance balance = Balance::LEAST_OUTSTANDING;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&]() -> const char* {
+            if (i + 1 >= argc) { usage(); std::exit(2); }
+            return argv[++i];
+        };
+
+        if (arg == "--target") target = value();
+        else if (arg == "--path") options.path = value();
+        else if (arg == "-t") options.threads = std::strtoul(value(), nullptr, 10);
+        else if (arg == "-c") options.connections = std::strtoul(value(), nullptr, 10);
+        else if (arg == "-p") options.pipeline = std::max<size_t>(1, std::strtoul(value(), nullptr, 10));
+        else if (arg == "-R") options.rate = std::atof(value());
+        else if (arg == "-d") options.duration = std::chrono::milliseconds(static_cast<long long>(std::atof(value()) * 1000));
+        else if (arg == "--warmup") options.warmup = std::chrono::milliseconds(static_cast<long long>(std::atof(value()) * 1000));
+        else if (arg == "--close") options.keepAlive = false;
+        else if (arg == "--server-threads") serverThreads = std::strtoul(value(), nullptr, 10);
+        else if (arg == "--port") options.port = std::atoi(value());
+        else if (arg == "--backlog") serverOptions.backlog = std::atoi(value());
+        else if (arg == "--nagle") serverOptions.noDelay = false;
+        else if (arg == "--defer-accept") serverOptions.deferAccept = std::atoi(value());
+        else if (arg == "--fastopen") serverOptions.fastOpen = std::atoi(value());
+        else if (arg == "--rcvbuf") serverOptions.receiveBuffer = std::atoi(value());
+        else if (arg == "--sndbuf") serverOptions.sendBuffer = std::atoi(value());
+        else if (arg == "--quickack") serverOptions.quickAck = true;
+        else if (arg == "--busy-poll") serverOptions.busyPoll = std::atoi(value());
+        else if (arg == "--pin-workers") {
+            for (const char* p = value(); *p; ) {
+                char* end;
+                serverOptions.workerCpus.push_back(static_cast<int>(std::strtol(p, &end, 10)));
+                p = *end == ',' ? end + 1 : end + std::strlen(end);
+            }
+        }
+        else if (arg == "--accept-cpu") serverOptions.acceptCpu = std::atoi(value());
+        else if (arg == "--numa") serverOptions.numaAware = true;
+        else if (arg == "--matrix") matrix = true;
+        else if (arg == "--proxy") proxyBackends = std::strtoul(value(), nullptr, 10);
+        else if (arg == "--balance") {
+            std::string mode = value();
+            if (mode == "rr") balance = Balance::ROUND_ROBIN;
+            else if (mode == "least") balance = Balance::LEAST_OUTSTANDING;
+            else if (mode == "p2c") balance = Balance::TWO_CHOICES;
+            else { usage(); return 2; }
+        }
+        else { usage(); return arg == "-h" || arg == "--help" ? 0 : 2; }
+    }
+
+    auto startApp = [&](const ServerOptions& serverOptions, int port) {
+        auto app = std::make_unique<App>(serverThreads);
+        registerRoutes(*app);
+        app->serverOptions(serverOptions);
+        app->listen(port);
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        return app;
+    };
+
+    // Backends on the ports after --port, the proxy on --port. The direct
+    // run loads the first backend alone, so the latency and CPU columns
+    // differ by what the extra hop costs.
+    if (proxyBackends > 0) {
+        if (!target.empty() || matrix) { usage(); return 2; }
+
+        std::vector<std::unique_ptr<App>> backends;
+        std::vector<Upstream> upstreams;
+        for (size_t i = 1; i <= proxyBackends; ++i) {
+            int port = options.port + static_cast<int>(i);
+            backends.push_back(startApp(serverOptions, port));
+            upstreams.push_back({ "127.0.0.1", port });
+        }
+
+        ProxyOptions proxyOptions;
+        proxyOptions.balance = balance;
+
+        App proxy(serverThreads);
+        proxy.serverOptions(serverOptions);
+        proxy.proxy("/", upstreams, proxyOptions);
+        proxy.listen(options.port);
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        bench::LoadOptions direct = options;
+        direct.port = options.port + 1;
+        Measured baseline = measure(direct);
+        Measured proxied = measure(options);
+
+        std::printf("%-24s %12s %10s %10s %10s %12s\n",
+                    "target", "req/s", "p50 us", "p99 us", "p99.9 us", "cpu us/req");
+        auto row = [](const std::string& name, const Measured& m) {
+            const LatencySnapshot& l = m.result.latency;
+            std::printf("%-24s %12.0f %10.1f %10.1f %10.1f %12.1f\n",
+                        name.c_str(), m.result.requestsPerSecond,
+                        l.p50 * 1e6, l.p99 * 1e6, l.p999 * 1e6, m.cpuPerRequest * 1e6);
+        };
+        row("direct", baseline);
+        row("proxy x" + std::to_string(proxyBackends), proxied);
+
+        std::printf("overhead per request: p50 %+.1f us, p99 %+.1f us, cpu %+.1f us\n",
+                    (proxied.result.latency.p50 - baseline.result.latency.p50) * 1e6,
+                    (proxied.result.latency.p99 - baseline.result.latency.p99) * 1e6,
+                    (proxied.cpuPerRequest - baseline.cpuPerRequest) * 1e6);
+
+        proxy.stop();
+        for (auto& backend : backends) backend->stop();
+        return 0;
+    }
+
+    if (matrix) {
+        if (!target.empty()) { usage(); return 2; }
+
+        std::printf("%-24s %12s %10s %10s %10s %10s\n",
+                    "variant", "req/s", "p50 us", "p90 us", "p99 us", "p99.9 us");
+
+        for (const Variant& variant : MATRIX) {
+            ServerOptions tuned;
+            variant.apply(tuned);
+
+            auto app = startApp(tuned, options.port);
+            bench::LoadResult result = bench::runLoad(options);
+            app->stop();
+
+            const LatencySnapshot& l = result.latency;
+            std::printf("%-24s %12.0f %10.1f %10.1f %10.1f %10.1f\n",
+                        variant.name, result.requestsPerSecond,
+                        l.p50 * 1e6, l.p90 * 1e6, l.p99 * 1e6, l.p999 * 1e6);
+        }
+        return 0;
+    }
+
+    std::unique_ptr<App> app;
+
+    if (!target.empty()) {
+        size_t colon = target.rfind(':');
+        if (colon == std::string::npos) { usage(); return 2; }
+        options.host = target.substr(0, colon);
+        options.port = std::atoi(target.c_str() + colon + 1);
+    } else {
+        app = startApp(serverOptions, options.port);
+    }
+
+    bench::LoadResult result = bench::runLoad(options);
+    std::printf("%s", bench::formatResult(options, result).c_str());
+
+    if (app) app->stop();
+    return 0;
+}
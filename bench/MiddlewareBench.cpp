@@ -0,0 +1,33 @@
+#include "BenchHarness.h"
+#include "net/Middleware.h"
+#include "http/Request.h"
+#include "http/Response.h"
+#include "net/Connection.h"
+
+using namespace mini_http;
+
+namespace {
+    void execute(size_t middlewareCount, bench::State& state) {
+        MiddlewareChain chain;
+        for (size_t i = 0; i < middlewareCount; ++i) {
+            chain.use([](Request&, Response&, Next next) { next(); });
+        }
+
+        Connection conn;
+        Response res(conn);
+        Request req;
+        size_t reached = 0;
+
+        state.startTiming();
+        for (size_t i = 0; i < state.iterations(); ++i) {
+            chain.execute(req, res, [&reached] { ++reached; });
+        }
+
+        bench::doNotOptimize(reached);
+    }
+}
+
+MINI_HTTP_BENCH("MiddlewareChain::execute/0", [](bench::State& state) { execute(0, state); });
+MINI_HTTP_BENCH("MiddlewareChain::execute/1", [](bench::State& state) { execute(1, state); });
+MINI_HTTP_BENCH("MiddlewareChain::execute/4", [](bench::State& state) { execute(4, state); });
+MINI_HTTP_BENCH("MiddlewareChain::execute/16", [](bench::State& state) { execute(16, state); });
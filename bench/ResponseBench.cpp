@@ -0,0 +1,75 @@
+#include "BenchHarness.h"
+#include "http/Response.h"
+#include "net/Connection.h"
+
+#include <thread>
+
+using namespace mini_http;
+
+namespace {
+    const nlohmann::json userList = [] {
+        nlohmann::json list = nlohmann::json::array();
+        for (int i = 1; i <= 10; ++i) {
+            list.push_back({
+                {"id", i},
+                {"name", "User" + std::to_string(i)},
+                {"email", "user" + std::to_string(i) + "@mail.com"}
+            });
+        }
+        return list;
+    }();
+
+    void serialize(bench::State& state) {
+        Response::Headers headers {
+            {"Content-Type", "application/json"},
+            {"Connection", "keep-alive"},
+        };
+        std::string body = userList.dump();
+        std::string out;
+
+        state.startTiming();
+        for (size_t i = 0; i < state.iterations(); ++i) {
+            Response::serialize(HttpStatus::OK, headers, body, out);
+            bench::doNotOptimize(out);
+        }
+    }
+
+    // Runs send into a socketpair that a background thread keeps draining.
+    template <typename Send>
+    void throughSocket(bench::State& state, Send send) {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) return;
+
+        std::thread drain([fd = fds[1]] {
+            char buffer[65536];
+            while (::read(fd, buffer, sizeof(buffer)) > 0) {}
+        });
+
+        {
+            Connection conn(fds[0]);
+
+            state.startTiming();
+            for (size_t i = 0; i < state.iterations(); ++i) {
+                Response res(conn);
+                send(res);
+            }
+            state.stopTiming();
+        }
+
+        drain.join();
+        ::close(fds[1]);
+    }
+
+    void json(bench::State& state) {
+        throughSocket(state, [](Response& res) { res.json(userList); });
+    }
+
+    void largeBody(bench::State& state) {
+        const std::string body(256 * 1024, 'x');
+        throughSocket(state, [&](Response& res) { res.send(body); });
+    }
+}
+
+MINI_HTTP_BENCH("Response::serialize/json_body", serialize);
+MINI_HTTP_BENCH("Response::json/socketpair", json);
+MINI_HTTP_BENCH("Response::send/256KiB_body", largeBody);
@@ -0,0 +1,42 @@
+#include "BenchHarness.h"
+#include "core/Router.h"
+#include "http/Request.h"
+#include "http/Response.h"
+#include "net/Connection.h"
+
+using namespace mini_http;
+
+namespace {
+    void dispatch(size_t routeCount, bench::State& state) {
+        Router router;
+        for (size_t i = 0; i < routeCount; ++i) {
+            router.get("/resource" + std::to_string(i) + "/:id",
+                    [](Request& req, Response&) { bench::doNotOptimize(req.params); });
+        }
+
+        Connection conn;
+        Response res(conn);
+
+        Request first;
+        first.method = HttpMethod::GET;
+        first.path = "/resource0/42";
+
+        Request middle = first;
+        middle.path = "/resource" + std::to_string(routeCount / 2) + "/42";
+
+        Request last = first;
+        last.path = "/resource" + std::to_string(routeCount - 1) + "/42";
+
+        Request* requests[] = { &first, &middle, &last };
+
+        state.startTiming();
+        for (size_t i = 0; i < state.iterations(); ++i) {
+            bool found = router.dispatch(*requests[i % 3], res);
+            bench::doNotOptimize(found);
+        }
+    }
+}
+
+MINI_HTTP_BENCH("Router::dispatch/10_routes", [](bench::State& state) { dispatch(10, state); });
+MINI_HTTP_BENCH("Router::dispatch/100_routes", [](bench::State& state) { dispatch(100, state); });
+MINI_HTTP_BENCH("Router::dispatch/1000_routes", [](bench::State& state) { dispatch(1000, state); });
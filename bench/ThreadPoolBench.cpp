@@ -0,0 +1,32 @@
+#include "BenchHarness.h"
+#include "net/ThreadPool.h"
+
+#include <atomic>
+#include <thread>
+
+using namespace mini_http;
+
+namespace {
+    void enqueue(size_t threads, bench::State& state) {
+        std::atomic<size_t> completed { 0 };
+        size_t iterations = state.iterations();
+
+        ThreadPool pool(threads);
+
+        state.startTiming();
+        for (size_t i = 0; i < iterations; ++i) {
+            pool.enqueue([&completed] {
+                completed.fetch_add(1, std::memory_order_relaxed);
+            });
+        }
+
+        while (completed.load(std::memory_order_relaxed) < iterations)
+            std::this_thread::yield();
+        state.stopTiming();
+
+        pool.shutdown();
+    }
+}
+
+MINI_HTTP_BENCH("ThreadPool::enqueue/1_worker", [](bench::State& state) { enqueue(1, state); });
+MINI_HTTP_BENCH("ThreadPool::enqueue/4_workers", [](bench::State& state) { enqueue(4, state); });
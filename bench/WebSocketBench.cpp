@@ -0,0 +1,73 @@
+#include "BenchHarness.h"
+#include "http/WebSocketFrame.h"
+
+#include <cstring>
+
+using namespace mini_http;
+
+namespace {
+    const uint8_t KEY[4] = { 0x37, 0xfa, 0x21, 0x3d };
+
+    // Byte-at-a-time reference for the vectorized unmask.
+    void unmaskScalar(char* data, size_t len, const uint8_t key[4]) {
+        for (size_t i = 0; i < len; ++i)
+            data[i] = static_cast<char>(data[i] ^ key[i & 3]);
+    }
+
+    template <void (*Unmask)(char*, size_t, const uint8_t*)>
+    void unmask(size_t size, bench::State& state) {
+        std::string payload(size, 'x');
+
+        state.startTiming();
+        for (size_t i = 0; i < state.iterations(); ++i) {
+            Unmask(payload.data(), payload.size(), KEY);
+            bench::doNotOptimize(payload);
+        }
+    }
+
+    void validate(std::string text, bench::State& state) {
+        state.startTiming();
+        for (size_t i = 0; i < state.iterations(); ++i) {
+            bool valid = validUtf8(text);
+            bench::doNotOptimize(valid);
+        }
+    }
+
+    std::string mixedText(size_t size) {
+        std::string text;
+        while (text.size() < size)
+            text.append("ascii text, ñandú, 日本語, 🙂 ");
+        return text;
+    }
+
+    // A masked client text frame as it arrives on the wire.
+    std::string clientFrame(size_t size) {
+        std::string frame;
+        appendWebSocketHeader(frame, WebSocketOpcode::TEXT, size);
+        frame[1] = static_cast<char>(frame[1] | 0x80);
+        frame.append(reinterpret_cast<const char*>(KEY), 4);
+        frame.append(size, 'x');
+        return frame;
+    }
+
+    void parse(size_t size, bench::State& state) {
+        std::string frame = clientFrame(size);
+        std::string buffer;
+        buffer.reserve(frame.size());
+
+        state.startTiming();
+        for (size_t i = 0; i < state.iterations(); ++i) {
+            buffer.assign(frame);
+            WebSocketFrame parsed;
+            size_t used = parseWebSocketFrame(buffer.data(), buffer.size(), frame.size(), parsed);
+            bench::doNotOptimize(used);
+        }
+    }
+}
+
+MINI_HTTP_BENCH("WebSocket::unmask/scalar_64KiB", [](bench::State& state) { unmask<unmaskScalar>(64 * 1024, state); });
+MINI_HTTP_BENCH("WebSocket::unmask/simd_64KiB", [](bench::State& state) { unmask<unmaskWebSocket>(64 * 1024, state); });
+MINI_HTTP_BENCH("WebSocket::parseFrame/32B", [](bench::State& state) { parse(32, state); });
+MINI_HTTP_BENCH("WebSocket::parseFrame/16KiB", [](bench::State& state) { parse(16 * 1024, state); });
+MINI_HTTP_BENCH("WebSocket::validUtf8/ascii_16KiB", [](bench::State& state) { validate(std::string(16 * 1024, 'x'), state); });
+MINI_HTTP_BENCH("WebSocket::validUtf8/mixed_16KiB", [](bench::State& state) { validate(mixedText(16 * 1024), state); });
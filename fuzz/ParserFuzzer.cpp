@@ -0,0 +1,158 @@
+#include "ReferenceParser.h"
+#include "http/HttpParser.h"
+#include "net/Connection.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace mini_http;
+
+// Input layout: two bytes seeding the read-boundary split, then the raw
+// bytes a client would send. The bytes are delivered over a SOCK_SEQPACKET
+// socketpair, one message per chunk, so every recv() in parseRequest
+// returns exactly one chunk.
+namespace {
+    constexpr size_t MAX_INPUT_SIZE = 16 * 1024;
+    constexpr size_t MAX_READ = 4096;
+    constexpr size_t MAX_REQUESTS = 32;
+
+    struct Outcome {
+        bool ok = false;
+        ParseError::Kind error = ParseError::Kind::MALFORMED;
+        Request request;
+    };
+
+    [[noreturn]] void fail(const char* what, size_t index) {
+        std::fprintf(stderr, "parser fuzz failure: %s (request %zu)\n", what, index);
+        std::abort();
+    }
+
+    std::vector<size_t> splitPoints(size_t size, uint32_t seed) {
+        std::vector<size_t> chunks;
+        uint32_t state = seed * 2654435761u + 1;
+
+        size_t remaining = size;
+        while (remaining > 0) {
+            state = state * 1103515245u + 12345u;
+            size_t limit = remaining < MAX_READ ? remaining : MAX_READ;
+            size_t chunk = chunks.size() < 64 ? 1 + (state >> 8) % limit : limit;
+            chunks.push_back(chunk);
+            remaining -= chunk;
+        }
+
+        return chunks;
+    }
+
+    std::vector<Outcome> parseAll(const std::string& payload,
+                                const std::vector<size_t>& chunks)
+    {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds) != 0)
+            std::abort();
+
+        int bufferSize = 1 << 20;
+        setsockopt(fds[1], SOL_SOCKET, SO_SNDBUF, &bufferSize, sizeof(bufferSize));
+
+        size_t offset = 0;
+        for (size_t chunk : chunks) {
+            if (::send(fds[1], payload.data() + offset, chunk, 0) != static_cast<ssize_t>(chunk))
+                std::abort();
+            offset += chunk;
+        }
+        ::shutdown(fds[1], SHUT_WR);
+
+        std::vector<Outcome> outcomes;
+        Connection conn(fds[0]);
+
+        while (outcomes.size() < MAX_REQUESTS) {
+            Outcome outcome;
+            try {
+                outcome.request = parseRequest(conn);
+                outcome.ok = true;
+            } catch (const ParseError& e) {
+                outcome.error = e.kind();
+            } catch (const std::exception&) {
+                fail("parseRequest threw something other than ParseError", outcomes.size());
+            }
+
+            outcomes.push_back(std::move(outcome));
+            if (!outcomes.back().ok) break;
+        }
+
+        ::close(fds[1]);
+        return outcomes;
+    }
+
+    bool sameRequest(const Request& a, const Request& b) {
+        return a.method == b.method
+            && a.path == b.path
+            && a.query == b.query
+            && a.version == b.version
+            && a.headers == b.headers
+            && a.body == b.body;
+    }
+
+    void checkInvariants(const Request& req, size_t index) {
+        if (req.path.empty())
+            fail("empty path accepted", index);
+        if (req.path.find('?') != std::string::npos)
+            fail("query left in path", index);
+
+        auto it = req.headers.find("content-length");
+        size_t expected = it == req.headers.end() ? 0 : std::stoul(it->second);
+        if (req.body.size() != expected)
+            fail("body size differs from Content-Length", index);
+    }
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    if (size < 2) return 0;
+
+    uint32_t seed = static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8);
+    std::string payload(reinterpret_cast<const char*>(data + 2),
+                        size - 2 < MAX_INPUT_SIZE ? size - 2 : MAX_INPUT_SIZE);
+
+    // Random read boundaries must not change the result.
+    std::vector<Outcome> split = parseAll(payload, splitPoints(payload.size(), seed));
+    std::vector<size_t> natural;
+    for (size_t left = payload.size(); left > 0; left -= natural.back())
+        natural.push_back(left < MAX_READ ? left : MAX_READ);
+    std::vector<Outcome> whole = parseAll(payload, natural);
+
+    if (split.size() != whole.size())
+        fail("request count depends on read boundaries", split.size());
+
+    for (size_t i = 0; i < split.size(); ++i) {
+        if (split[i].ok != whole[i].ok)
+            fail("success depends on read boundaries", i);
+        if (!split[i].ok) continue;
+        if (!sameRequest(split[i].request, whole[i].request))
+            fail("parsed request depends on read boundaries", i);
+
+        checkInvariants(split[i].request, i);
+    }
+
+    // Differential check: wherever the reference parser accepts the input,
+    // parseRequest must produce the same requests.
+    size_t offset = 0;
+    for (size_t i = 0; i < split.size() && offset < payload.size(); ++i) {
+        Request expected;
+        size_t consumed = fuzz::referenceParse(payload, offset, expected);
+        if (consumed == 0) break;
+
+        if (!split[i].ok)
+            fail("request rejected that the reference parser accepts", i);
+        if (!sameRequest(split[i].request, expected))
+            fail("request differs from the reference parser", i);
+
+        offset += consumed;
+    }
+
+    return 0;
+}
@@ -0,0 +1,99 @@
+#include "ReferenceParser.h"
+
+#include <algorithm>
+#include <cctype>
+#include <sstream>
+
+namespace mini_http::fuzz {
+    static bool parseMethod(const std::string& methodStr, HttpMethod& method) {
+        if (methodStr == "GET") method = HttpMethod::GET;
+        else if (methodStr == "POST") method = HttpMethod::POST;
+        else if (methodStr == "PUT") method = HttpMethod::PUT;
+        else if (methodStr == "DELETE") method = HttpMethod::DELETE_;
+        else if (methodStr == "PATCH") method = HttpMethod::PATCH;
+        else if (methodStr == "OPTIONS") method = HttpMethod::OPTIONS;
+        else if (methodStr == "HEAD") method = HttpMethod::HEAD;
+        else return false;
+        return true;
+    }
+
+    size_t referenceParse(const std::string& input, size_t offset, Request& out) {
+        size_t headerEnd = input.find("\r\n\r\n", offset);
+        if (headerEnd == std::string::npos || headerEnd - offset + 4 > 8192)
+            return 0;
+
+        if (input.compare(offset, headerEnd - offset, "PRI * HTTP/2.0") == 0) {
+            out = Request();
+            out.method = HttpMethod::GET;
+            out.path = "*";
+            out.version = "HTTP/2.0";
+            return headerEnd - offset + 4;
+        }
+
+        std::istringstream stream(input.substr(offset, headerEnd - offset));
+
+        std::string methodStr, path, version;
+        stream >> methodStr >> path >> version;
+
+        if (methodStr.empty() || path.empty() || version.empty())
+            return 0;
+
+        Request req;
+        if (!parseMethod(methodStr, req.method))
+            return 0;
+        req.version = version;
+
+        size_t qmark = path.find('?');
+        if (qmark != std::string::npos) {
+            req.query = path.substr(qmark + 1);
+            req.path = path.substr(0, qmark);
+        } else {
+            req.path = path;
+        }
+
+        if (req.path.empty())
+            return 0;
+
+        std::string line;
+        std::getline(stream, line);
+
+        while (std::getline(stream, line)) {
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+
+            size_t colon = line.find(':');
+            if (line.empty() || colon == std::string::npos)
+                continue;
+
+            std::string key = line.substr(0, colon);
+            std::string value = line.substr(colon + 1);
+
+            if (!value.empty() && value[0] == ' ')
+                value.erase(0, 1);
+
+            std::transform(key.begin(), key.end(), key.begin(), [](unsigned char c) {
+                return static_cast<char>(std::tolower(c));
+            });
+
+            req.headers[key] = value;
+        }
+
+        size_t contentLength = 0;
+        auto it = req.headers.find("content-length");
+        if (it != req.headers.end()) {
+            try {
+                contentLength = std::stoul(it->second);
+            } catch (const std::logic_error&) {
+                return 0;
+            }
+        }
+
+        size_t bodyStart = headerEnd + 4;
+        if (contentLength > input.size() - bodyStart)
+            return 0;
+
+        req.body = input.substr(bodyStart, contentLength);
+        out = std::move(req);
+        return bodyStart + contentLength - offset;
+    }
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <string>
+#include "http/Request.h"
+
+namespace mini_http::fuzz {
+    // The original istringstream-based request parser, kept as the
+    // reference a faster parseRequest must agree with. It works on a fully
+    // buffered input: parses the request starting at offset and returns the
+    // number of bytes it spans, or 0 if the input is not a valid request.
+    size_t referenceParse(const std::string& input, size_t offset, Request& out);
+}
@@ -0,0 +1,103 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+// Driver used when the compiler has no libFuzzer: replays files or
+// directories given on the command line, and with --random N also runs N
+// mutations of them. Works as an AFL target with a single file argument.
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+namespace fs = std::filesystem;
+
+static std::string readFile(const fs::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+static void run(const std::string& input) {
+    LLVMFuzzerTestOneInput(reinterpret_cast<const uint8_t*>(input.data()), input.size());
+}
+
+static std::string mutate(std::string input, const std::vector<std::string>& corpus, std::mt19937& rng) {
+    static const char* tokens[] = {
+        "\r\n", "\r\n\r\n", "\n", ":", " ", "?", "Content-Length: ", "content-length:",
+        "4294967296", "18446744073709551616", "-1", "GET ", "POST ", "HTTP/1.1", "\xff", "\x80"
+    };
+
+    int rounds = 1 + rng() % 8;
+    for (int i = 0; i < rounds; ++i) {
+        size_t pos = input.empty() ? 0 : rng() % (input.size() + 1);
+
+        switch (rng() % 6) {
+            case 0:
+                if (!input.empty() && pos < input.size())
+                    input[pos] = static_cast<char>(rng());
+                break;
+            case 1:
+                if (!input.empty() && pos < input.size())
+                    input.erase(pos, 1 + rng() % 16);
+                break;
+            case 2:
+                input.insert(pos, tokens[rng() % std::size(tokens)]);
+                break;
+            case 3:
+                input.insert(pos, std::string(1 + rng() % 4096, static_cast<char>('a' + rng() % 26)));
+                break;
+            case 4: {
+                const std::string& other = corpus[rng() % corpus.size()];
+                input.insert(pos, other.substr(2));
+                break;
+            }
+            default:
+                if (input.size() >= 2) {
+                    input[0] = static_cast<char>(rng());
+                    input[1] = static_cast<char>(rng());
+                }
+                break;
+        }
+    }
+
+    return input;
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string> corpus;
+    long iterations = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--random") == 0 && i + 1 < argc) {
+            iterations = std::strtol(argv[++i], nullptr, 10);
+            continue;
+        }
+
+        fs::path path(argv[i]);
+        if (fs::is_directory(path)) {
+            for (const auto& entry : fs::directory_iterator(path))
+                if (entry.is_regular_file())
+                    corpus.push_back(readFile(entry.path()));
+        } else {
+            corpus.push_back(readFile(path));
+        }
+    }
+
+    if (corpus.empty()) {
+        std::fprintf(stderr, "usage: %s [--random N] <file|dir>...\n", argv[0]);
+        return 1;
+    }
+
+    for (const auto& input : corpus)
+        run(input);
+
+    std::mt19937 rng(std::random_device{}());
+    for (long i = 0; i < iterations; ++i)
+        run(mutate(corpus[rng() % corpus.size()], corpus, rng));
+
+    std::printf("%zu inputs, %ld mutations: ok\n", corpus.size(), iterations);
+    return 0;
+}
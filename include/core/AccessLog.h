@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "http/HttpMethod.h"
+#include "http/HttpStatus.h"
+
+namespace mini_http {
+    struct AccessRecord {
+        int64_t timestamp;      // unix time, nanoseconds
+        uint64_t bytes;
+        uint64_t latencyNanos;
+        uint32_t routeId;
+        uint16_t status;
+        HttpMethod method;
+    };
+
+    // Request log fed through one single-producer ring per worker thread.
+    // Workers never block: when their ring is full the record is counted
+    // as dropped. A background thread drains the rings, formats the
+    // records and writes them out in batches.
+    class AccessLog {
+    public:
+        explicit AccessLog(std::ostream& out = std::cout,
+                        size_t ringCapacity = 4096);
+        ~AccessLog();
+
+        AccessLog(const AccessLog&) = delete;
+        AccessLog& operator=(const AccessLog&) = delete;
+
+        void start();
+        void stop();
+
+        void record(const AccessRecord& record);
+        void setRoutes(std::vector<std::string> labels);
+
+        uint64_t dropped() const;
+
+    private:
+        struct Ring {
+            explicit Ring(size_t capacity);
+
+            alignas(64) std::atomic<size_t> head { 0 };
+            alignas(64) std::atomic<size_t> tail { 0 };
+            std::atomic<uint64_t> dropped { 0 };
+            std::vector<AccessRecord> slots;
+            size_t mask;
+        };
+
+        std::ostream& out;
+        const size_t ringCapacity;
+        const uint64_t instance;
+
+        mutable std::mutex mtx;
+        std::condition_variable cv;
+        std::vector<std::unique_ptr<Ring>> rings;
+        std::vector<std::string> routes;
+
+        std::atomic<bool> running { false };
+        std::thread writer;
+
+        Ring& local();
+        void writeLoop();
+        size_t drain(std::string& batch);
+        void format(const AccessRecord& record, std::string& line) const;
+    };
+}
@@ -4,43 +4,158 @@
 #include <iostream>
 #include <csignal>
 #include "Router.h"
+#include "Task.h"
+#include "Metrics.h"
+#include "AccessLog.h"
 #include "net/Middleware.h"
 #include "net/TcpServer.h"
+#include "net/WebSocket.h"
+#include "net/EventStream.h"
+#include "net/Http2Session.h"
+#include "net/HttpClient.h"
+#include "net/ReverseProxy.h"
 #include "http/Request.h"
 #include "http/Response.h"
+#include "http/PreparedResponse.h"
 #include "http/HttpParser.h"
 
 namespace mini_http {
 
+    struct RouteLatency {
+        LatencySnapshot handler;
+        LatencySnapshot total;
+    };
+
     class App {
     public:
         using Handler = std::function<void(Request&, Response&)>;
 
         App(size_t threads = 4);
 
-        void get(const std::string& path, Handler handler);
-        void post(const std::string& path, Handler handler);
-        void put(const std::string& path, Handler handler);
-        void del(const std::string& path, Handler handler);
-        void patch(const std::string& path, Handler handler);
-        void options(const std::string& path, Handler handler);
-        void head(const std::string& path, Handler handler);
+        RouteHandle get(const std::string& path, Handler handler);
+        RouteHandle post(const std::string& path, Handler handler);
+        RouteHandle put(const std::string& path, Handler handler);
+        RouteHandle del(const std::string& path, Handler handler);
+        RouteHandle patch(const std::string& path, Handler handler);
+        RouteHandle options(const std::string& path, Handler handler);
+        RouteHandle head(const std::string& path, Handler handler);
+
+        // WebSocket endpoint at path. The returned hub broadcasts to every
+        // socket connected through it. POSIX only.
+        WebSocketHub& ws(const std::string& path, WebSocketHandlers handlers);
+
+        // Server-Sent Events endpoint at path. Streams subscribe to topics
+        // in handlers.open; the returned hub publishes to them. POSIX only.
+        EventStreamHub& sse(const std::string& path, EventStreamHandlers handlers = {});
+
+        // Answers GET path with a response serialized now, without
+        // middleware or routing. Must be called before listen().
+        void getStatic(const std::string& path,
+                    HttpStatus status,
+                    const Response::Headers& headers,
+                    const std::string& body);
+        void getStatic(const std::string& path,
+                    HttpStatus status,
+                    const std::string& body);
+
+        void cacheLimit(size_t maxBytes);
+
+        // Size of the executor that runs routes marked offload(), separate
+        // from the I/O workers. Defaults to the worker count.
+        void handlerThreads(size_t threads);
+
+        // Serves the Prometheus text exposition of the server metrics at path.
+        void exposeMetrics(const std::string& path = "/metrics");
+
+        // Handler and end-to-end latency percentiles for a registered route,
+        // merged across worker threads at call time.
+        RouteLatency latency(HttpMethod method, const std::string& path) const;
+
+        void enableAccessLog(std::ostream& out = std::cout);
+
+        // Keep-alive connections are closed after maxRequests requests
+        // (0 for no limit) or after idleTimeout without a new request.
+        void keepAlive(size_t maxRequests,
+                    std::chrono::milliseconds idleTimeout = std::chrono::seconds(5));
+
+        // Socket tuning for the listener and accepted connections. Takes
+        // effect on the next listen().
+        void serverOptions(const ServerOptions& options);
+        const ServerOptions& serverOptions() const { return config; }
+
+        // HTTP/2 cleartext: clients starting with the HTTP/2 preface, or
+        // asking for "Upgrade: h2c", are served over HTTP/2 with the same
+        // routes and middleware. On by default; POSIX only.
+        void http2(const Http2Options& options);
+
+        #ifndef _WIN32
+            // The server's event loop, which resumes suspended coroutine
+            // handlers. Valid once listen() has been called.
+            EventLoop& loop() { return server->eventLoop(); }
+
+            // Pooled HTTP/1.1 client on the server's event loop, for handlers
+            // that call other services. Valid once listen() has been called.
+            HttpClient& client() { return *httpClient; }
+            void clientOptions(const HttpClientOptions& options);
+
+            // Forwards every request under prefix to upstreams through
+            // client(); see Router::proxy() and ProxyOptions.
+            ReverseProxy& proxy(const std::string& prefix, std::vector<Upstream> upstreams,
+                                ProxyOptions options = {});
+        #endif
 
         void use(Middleware middleware);
         void use(const std::string& prefix, Router& subrouter);
         
+        // Blocks until SIGINT/SIGTERM, then shuts the server down.
         void start(int port);
+
+        // Starts serving in the background and returns immediately.
+        void listen(int port);
+        void stop();
     private:
         static inline std::atomic<bool> shutdownRequested{false};
         static inline std::condition_variable shutdownCv;
         static inline std::mutex shutdownMutex;
         size_t count;
+        size_t handlerCount;
+        ServerOptions config;
+        Http2Options http2Config;
+        HttpClientOptions clientConfig;
+        Metrics metrics;
         Router router;
         MiddlewareChain middlewareChain;
+        // Registered before listen(), which gives each a route id after
+        // the router's, and only read afterwards.
+        struct StaticRoute {
+            PreparedResponse response;
+            size_t id = 0;
+        };
+        std::unordered_map<std::string, StaticRoute> staticRoutes;
+        PreparedResponse notFoundResponse;
+        std::unique_ptr<AccessLog> accessLog;
+        std::vector<std::unique_ptr<WebSocketHub>> webSockets;
+        std::vector<std::unique_ptr<EventStreamHub>> eventStreams;
+        std::vector<std::shared_ptr<ReverseProxy>> proxies;
+        std::unique_ptr<ThreadPool> handlerPool;
         std::unique_ptr<TcpServer> server;
+        std::unique_ptr<HttpClient> httpClient;
 
-        bool handleClient(Connection& conn);
-        void listen(int port);
+        struct Exchange;
+
+        TcpServer::HandlerResult handleClient(Connection& conn);
+        void route(Request& req, Response& res);
+        bool finish(Connection& conn);
+        void record(const Request& req, const Response& res);
+        void record(const Request& req, const StaticRoute& route, uint64_t bytesOut);
+        std::vector<std::string> routeLabels();
+        #ifndef _WIN32
+            TcpServer::HandlerResult startHttp2(Connection& conn, Request* upgrade);
+            void serveStream(Request& req, Response& res, std::function<void()> done);
+        #endif
+        void logAccess(const Request& req, HttpStatus status,
+                    size_t routeId, uint64_t bytesOut,
+                    std::chrono::nanoseconds latency);
         static void signalHandler(int signal);
     };
 }
\ No newline at end of file
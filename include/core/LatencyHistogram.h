@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace mini_http {
+    struct LatencySnapshot {
+        uint64_t count = 0;
+        double sum = 0;   // seconds
+        double p50 = 0;
+        double p90 = 0;
+        double p99 = 0;
+        double p999 = 0;
+    };
+
+    // HDR-style log-linear histogram of nanosecond durations: 32 linear
+    // sub-buckets per power of two, so any recorded value is reported
+    // within ~3% of its true value. Values above ~18 minutes saturate.
+    // record() is meant for a single writer; readers may run concurrently.
+    class LatencyHistogram {
+    public:
+        static constexpr unsigned SUB_BUCKET_BITS = 5;
+        static constexpr uint64_t SUB_BUCKETS = 1ull << SUB_BUCKET_BITS;
+        static constexpr unsigned MAX_VALUE_BITS = 40;
+        static constexpr size_t BUCKET_COUNT =
+            (MAX_VALUE_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+        LatencyHistogram();
+
+        void record(uint64_t nanos);
+
+        // Adds this histogram's counts into counts (resized to BUCKET_COUNT).
+        void mergeInto(std::vector<uint64_t>& counts, uint64_t& sumNanos) const;
+
+        static size_t bucketIndex(uint64_t nanos);
+        static uint64_t bucketValue(size_t index);
+
+        static LatencySnapshot summarize(const std::vector<uint64_t>& counts,
+                                        uint64_t sumNanos);
+        static double percentile(const std::vector<uint64_t>& counts,
+                                uint64_t total, double quantile);
+
+    private:
+        std::atomic<uint64_t> counts[BUCKET_COUNT];
+        std::atomic<uint64_t> sum;
+    };
+}
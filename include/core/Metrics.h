@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "http/HttpStatus.h"
+#include "LatencyHistogram.h"
+
+namespace mini_http {
+    // Process metrics recorded into per-thread shards. Each shard is only
+    // ever written by the thread that owns it, so recording is a relaxed
+    // load/store pair with no shared cache lines. Shards are summed when
+    // the metrics are rendered.
+    class Metrics {
+    public:
+        enum Counter : size_t {
+            ACCEPTED_CONNECTIONS,
+            CLOSED_CONNECTIONS,
+            ACCEPT_ERRORS,
+            BYTES_IN,
+            BYTES_OUT,
+            PARSE_ERRORS,
+            TIMEOUTS,
+            HANDLER_ERRORS,
+            STATIC_HITS,
+            DEADLINE_DROPS,
+            COALESCED,
+            COUNTER_COUNT
+        };
+
+        enum Latency : size_t {
+            HANDLER_LATENCY,
+            TOTAL_LATENCY,
+            LATENCY_COUNT
+        };
+
+        Metrics();
+
+        Metrics(const Metrics&) = delete;
+        Metrics& operator=(const Metrics&) = delete;
+
+        void increment(Counter counter, uint64_t amount = 1);
+        void recordRequest(size_t routeId, HttpStatus status);
+        void recordLatency(size_t routeId, Latency kind,
+                        std::chrono::nanoseconds elapsed);
+
+        // Route labels indexed by Route::id; id 0 collects unmatched requests.
+        void setRoutes(std::vector<std::string> labels);
+
+        void gauge(const std::string& name,
+                const std::string& help,
+                std::function<double()> read);
+
+        uint64_t total(Counter counter) const;
+        LatencySnapshot latency(size_t routeId, Latency kind) const;
+        size_t routeId(const std::string& label) const;
+
+        std::string render() const;
+
+    private:
+        struct alignas(64) Shard {
+            std::atomic<uint64_t> counters[COUNTER_COUNT] {};
+            std::unique_ptr<std::atomic<uint64_t>[]> requests;
+            std::unique_ptr<std::atomic<LatencyHistogram*>[]> latencies;
+            size_t routeSlots = 0;
+
+            Shard() = default;
+            ~Shard();
+        };
+
+        struct Gauge {
+            std::string name;
+            std::string help;
+            std::function<double()> read;
+        };
+
+        // Request counters per route: one per HTTP_STATUSES entry, then one
+        // per class (1xx..5xx) for other codes in 100-599, then the rest.
+        static constexpr size_t STATUS_SLOTS = HTTP_STATUS_COUNT + 6;
+
+        const uint64_t instance;
+
+        mutable std::mutex mtx;
+        std::vector<std::unique_ptr<Shard>> shards;
+        std::vector<std::string> routes;
+        std::vector<Gauge> gauges;
+
+        Shard& local();
+        Shard& registerShard();
+        LatencySnapshot mergeLatency(size_t routeId, Latency kind) const;
+    };
+}
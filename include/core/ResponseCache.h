@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "http/PreparedResponse.h"
+
+namespace mini_http {
+    class ResponseCache {
+    public:
+        using Entry = std::shared_ptr<const PreparedResponse>;
+        using Clock = std::chrono::steady_clock;
+
+        explicit ResponseCache(size_t maxBytes = 64 * 1024 * 1024,
+                            size_t shardCount = 16);
+
+        ResponseCache(const ResponseCache&) = delete;
+        ResponseCache& operator=(const ResponseCache&) = delete;
+
+        // Returns the fresh entry for key, or nullptr. Concurrent misses are
+        // not coalesced here; Router pairs the cache with a SingleFlight.
+        Entry get(const std::string& key);
+        void put(const std::string& key, Entry entry, std::chrono::milliseconds ttl);
+
+        void setLimit(size_t maxBytes);
+
+    private:
+        struct Item {
+            std::string key;
+            Entry entry;
+            Clock::time_point expires;
+            size_t size;
+        };
+
+        struct Shard {
+            std::mutex mtx;
+            std::list<Item> lru;
+            std::unordered_map<std::string, std::list<Item>::iterator> index;
+            size_t bytes = 0;
+        };
+
+        std::vector<std::unique_ptr<Shard>> shards;
+        std::atomic<size_t> shardLimit;
+
+        Shard& shardFor(const std::string& key);
+        void store(Shard& shard, const std::string& key,
+                Entry entry, std::chrono::milliseconds ttl);
+        void evict(Shard& shard, std::list<Item>::iterator it);
+    };
+}
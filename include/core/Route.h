@@ -1,9 +1,11 @@
 #pragma once
 
+#include <chrono>
 #include <string>
 #include <vector>
 #include <regex>
 #include <functional>
+#include "net/ThreadPool.h"
 
 namespace mini_http {
     struct Request;
@@ -11,10 +13,22 @@ namespace mini_http {
 
     using Handler = std::function<void(Request&, Response&)>;
 
+    struct RouteOptions {
+        std::chrono::milliseconds cacheTtl { 0 };
+        bool coalesce = false;
+        // Lowercase header names that key cached and coalesced responses.
+        std::vector<std::string> vary;
+        bool offload = false;
+        Priority priority = Priority::NORMAL;
+        std::chrono::milliseconds deadline { 0 };
+    };
+
     struct Route {
+        size_t id = 0;
         std::string path;
         std::regex pattern;
         std::vector<std::string> paramNames;
         Handler handler;
+        RouteOptions options;
     };
 }
\ No newline at end of file
@@ -1,21 +1,68 @@
 #pragma once
 
+#include <deque>
+#include <functional>
 #include <unordered_map>
+#include <memory>
 #include <vector>
 #include <string>
 
 #include "http/HttpMethod.h"
-#include "route.h"
+#include "Route.h"
+#include "ResponseCache.h"
+#include "SingleFlight.h"
+#include "Metrics.h"
+#include "Task.h"
+#include "net/ThreadPool.h"
+#include "net/ReverseProxy.h"
 
 namespace mini_http {
     struct Request;
     class Response;
+    class Connection;
 
     struct FlatRoute {
         HttpMethod method;
         Route route;
     };
 
+    class Router;
+
+    class RouteHandle {
+    public:
+        RouteHandle(Router& router, Route& route)
+            : router(router), route(route) {}
+
+        // Serve GET hits from a shared micro-cache for ttl. Requests are keyed
+        // on method, path, query and the values of the listed headers. Only
+        // 200s that Response::shareable() allows are cached.
+        RouteHandle& cache(std::chrono::milliseconds ttl,
+                        std::vector<std::string> vary = {});
+
+        // Share one run of the handler among concurrent GETs with the same
+        // key (as for cache()): while it runs, identical requests wait for
+        // its response without holding a worker thread. Only responses the
+        // handler sends before returning, and that Response::shareable()
+        // allows, are shared; for the rest, each waiting request runs the
+        // handler itself.
+        RouteHandle& coalesce(std::vector<std::string> vary = {});
+
+        // Run the handler on the app's handler executor instead of the I/O
+        // worker that parsed the request, for routes that block or burn CPU.
+        RouteHandle& offload();
+
+        // Order among offloaded requests waiting for the handler executor.
+        RouteHandle& priority(Priority priority);
+
+        // Requests still unhandled this long after they arrived, including
+        // time queued for a worker, are dropped with a 503.
+        RouteHandle& deadline(std::chrono::milliseconds budget);
+
+    private:
+        Router& router;
+        Route& route;
+    };
+
     class Router {
     public:
 
@@ -23,28 +70,71 @@ namespace mini_http {
             HttpMethod method;
             std::string path;
             Handler handler;
+            RouteOptions options;
         };
 
-        void add(HttpMethod method,
+        RouteHandle add(HttpMethod method,
                 const std::string& path,
-                Handler handler);
-
-        void get(const std::string& path, Handler handler);
-        void post(const std::string& path, Handler handler);
-        void put(const std::string& path, Handler handler);
-        void del(const std::string& path, Handler handler);
-        void patch(const std::string& path, Handler handler);
-        void options(const std::string& path, Handler handler);
-        void head(const std::string& path, Handler handler);
+                Handler handler,
+                RouteOptions options = {});
+
+        RouteHandle get(const std::string& path, Handler handler);
+        RouteHandle post(const std::string& path, Handler handler);
+        RouteHandle put(const std::string& path, Handler handler);
+        RouteHandle del(const std::string& path, Handler handler);
+        RouteHandle patch(const std::string& path, Handler handler);
+        RouteHandle options(const std::string& path, Handler handler);
+        RouteHandle head(const std::string& path, Handler handler);
+
+        #ifndef _WIN32
+            // Forwards every request under prefix to upstreams. The proxy
+            // sends through the client of the App the router ends up in.
+            ReverseProxy& proxy(const std::string& prefix, std::vector<Upstream> upstreams,
+                                ProxyOptions options = {});
+            const std::vector<std::shared_ptr<ReverseProxy>>& proxies() const { return proxies_; }
+        #endif
+
         bool dispatch(Request& req, Response& res);
 
+        void cacheLimit(size_t maxBytes);
+        bool offloads() const;
+        void instrument(Metrics* metrics) { metrics_ = metrics; }
+        void executor(ThreadPool* pool) { executor_ = pool; }
+
+        // Queues a task on the I/O workers that serve a connection.
+        using Submit = std::function<void(Connection&, std::function<void()>)>;
+        void workers(Submit submit) { submit_ = std::move(submit); }
+
         std::vector<MountableRoute> getMountableRoutes() const;
+        std::vector<std::string> routeLabels() const;
         const std::vector<FlatRoute>& flatRoutes() const { return flat_; }
     private:
-        std::unordered_map<HttpMethod, std::vector<Route>> routes;
+        // A deque, so adding a route never moves the others: RouteHandle,
+        // Request::route and queued offloaded tasks hold references to them.
+        std::unordered_map<HttpMethod, std::deque<Route>> routes;
         std::vector<FlatRoute> flat_;
+        std::shared_ptr<ResponseCache> cache_;
+        std::shared_ptr<SingleFlight<PreparedResponse>> flights_;
+        size_t cacheLimit_ = 64 * 1024 * 1024;
+        size_t nextRouteId_ = 1;
+        Metrics* metrics_ = nullptr;
+        ThreadPool* executor_ = nullptr;
+        Submit submit_;
+        std::vector<std::shared_ptr<ReverseProxy>> proxies_;
+
+        friend class RouteHandle;
 
         Route buildRoute(const std::string& path,
                         Handler handler);
+        void enableCache();
+        void enableCoalescing();
+        void dispatchCached(Route& route, Request& req, Response& res);
+        void dispatchCoalesced(Route& route, Request& req, Response& res,
+                            const std::string& key);
+        void invoke(Route& route, Request& req, Response& res);
+        void dispatchOffloaded(Route& route, Request& req, Response& res);
+        void enqueueOffloaded(Route& route, Request& req, Response& res);
+        void redispatch(Route& route, Request& req, Response& res);
+        void dropExpired(Response& res);
     };
 }
\ No newline at end of file
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Task.h"
+
+namespace mini_http {
+    // Coalesces concurrent calls that share a key: the first caller does
+    // the work, and callers arriving before it is done get its result
+    // instead of repeating it. Nothing is remembered once a call finishes;
+    // pair it with a cache for that. Waiting callers hold no thread.
+    template<typename T>
+    class SingleFlight {
+    public:
+        using Result = std::shared_ptr<const T>;
+
+        // Gets the result, or the exception the work threw.
+        using Callback = std::function<void(const Result& result, std::exception_ptr error)>;
+
+        SingleFlight() = default;
+        SingleFlight(const SingleFlight&) = delete;
+        SingleFlight& operator=(const SingleFlight&) = delete;
+
+        // Thread-safe. If a call for key is running, queues done for its
+        // result and returns true. Otherwise returns false, leaving done
+        // untouched: the caller now leads a call for key and must end it
+        // with finish().
+        bool join(const std::string& key, Callback&& done) {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = flights.find(key);
+            if (it == flights.end()) {
+                flights.emplace(key, std::vector<Callback>());
+                return false;
+            }
+
+            it->second.push_back(std::move(done));
+            return true;
+        }
+
+        // Ends the call for key. The callers that joined it are answered
+        // on this thread, in the order they joined.
+        void finish(const std::string& key, Result result, std::exception_ptr error = nullptr) {
+            std::vector<Callback> waiters;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                auto it = flights.find(key);
+                if (it == flights.end()) return;
+                waiters = std::move(it->second);
+                flights.erase(it);
+            }
+
+            for (Callback& done : waiters)
+                done(result, error);
+        }
+
+        // Thread-safe. Runs produce here unless a call for key is already
+        // running, and hands its result to done either way. Returns
+        // whether this call ran produce.
+        template<typename F>
+        bool run(const std::string& key, F produce, Callback done) {
+            if (join(key, std::move(done)))
+                return false;
+
+            Result result;
+            std::exception_ptr error;
+            try {
+                result = std::make_shared<const T>(produce());
+            } catch (...) {
+                error = std::current_exception();
+            }
+
+            finish(key, result, error);
+            done(result, error);
+            return true;
+        }
+
+        // Calls running, each with any number of callers waiting.
+        size_t inFlight() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return flights.size();
+        }
+
+    private:
+        mutable std::mutex mutex;
+        std::unordered_map<std::string, std::vector<Callback>> flights;
+    };
+
+    #ifdef MINI_HTTP_HAS_COROUTINES
+        namespace detail {
+            template<typename U>
+            struct IsTask : std::false_type {};
+            template<typename U>
+            struct IsTask<Task<U>> : std::true_type {};
+
+            // Resumes at once, as the leader, or once the leader is done.
+            template<typename T>
+            struct FlightWait {
+                using Result = typename SingleFlight<T>::Result;
+                using Callback = typename SingleFlight<T>::Callback;
+
+                SingleFlight<T>& group;
+                EventLoop& loop;
+                const std::string& key;
+                bool leader = false;
+                Result result;
+                std::exception_ptr error;
+
+                bool await_ready() const noexcept { return false; }
+
+                // Once joined, the leader may resume the caller before this
+                // returns, so nothing here is touched after join().
+                bool await_suspend(std::coroutine_handle<> h) {
+                    Callback resume = [this, h](const Result& shared, std::exception_ptr failure) {
+                        result = shared;
+                        error = failure;
+                        loop.post([h]() { h.resume(); });
+                    };
+                    if (group.join(key, std::move(resume)))
+                        return true;
+
+                    leader = true;
+                    return false;
+                }
+
+                bool await_resume() const noexcept { return leader; }
+            };
+        }
+
+        // co_await share(group, loop, key, fn) in a coroutine handler. The
+        // first caller runs fn, which returns T or Task<T>; later ones suspend
+        // until it is done and resume on loop with the same result, or rethrow
+        // the same exception.
+        template<typename T, typename F>
+        Task<typename SingleFlight<T>::Result> share(SingleFlight<T>& group, EventLoop& loop,
+                                                     std::string key, F fn) {
+            detail::FlightWait<T> wait { group, loop, key };
+            if (!co_await wait) {
+                if (wait.error) std::rethrow_exception(wait.error);
+                co_return wait.result;
+            }
+
+            typename SingleFlight<T>::Result result;
+            try {
+                if constexpr (detail::IsTask<std::invoke_result_t<F&>>::value)
+                    result = std::make_shared<const T>(co_await fn());
+                else
+                    result = std::make_shared<const T>(fn());
+            } catch (...) {
+                group.finish(key, nullptr, std::current_exception());
+                throw;
+            }
+
+            group.finish(key, result);
+            co_return result;
+        }
+    #endif
+}
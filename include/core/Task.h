@@ -0,0 +1,274 @@
+#pragma once
+
+// C++20 coroutine handlers. Everything here is header-only and compiled in
+// only when the including translation unit builds as C++20, so the library
+// itself stays C++17.
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>) && !defined(_WIN32)
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <cerrno>
+
+#include "http/Request.h"
+#include "http/Response.h"
+#include "net/EventLoop.h"
+#include "net/ThreadPool.h"
+
+#define MINI_HTTP_HAS_COROUTINES 1
+
+namespace mini_http {
+    template<typename T = void>
+    class Task;
+
+    namespace detail {
+        struct TaskPromiseBase {
+            std::coroutine_handle<> continuation = std::noop_coroutine();
+            std::exception_ptr error;
+
+            std::suspend_always initial_suspend() noexcept { return {}; }
+
+            struct FinalAwaiter {
+                bool await_ready() noexcept { return false; }
+
+                template<typename P>
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept {
+                    return h.promise().continuation;
+                }
+
+                void await_resume() noexcept {}
+            };
+
+            FinalAwaiter final_suspend() noexcept { return {}; }
+            void unhandled_exception() { error = std::current_exception(); }
+        };
+
+        template<typename T>
+        struct TaskPromise : TaskPromiseBase {
+            std::optional<T> value;
+
+            Task<T> get_return_object();
+            void return_value(T v) { value.emplace(std::move(v)); }
+
+            T result() {
+                if (error) std::rethrow_exception(error);
+                return std::move(*value);
+            }
+        };
+
+        template<>
+        struct TaskPromise<void> : TaskPromiseBase {
+            Task<void> get_return_object();
+            void return_void() {}
+
+            void result() {
+                if (error) std::rethrow_exception(error);
+            }
+        };
+    }
+
+    // Lazily started coroutine. It runs when first awaited and resumes its
+    // awaiter directly when it finishes.
+    template<typename T>
+    class Task {
+    public:
+        using promise_type = detail::TaskPromise<T>;
+        using Handle = std::coroutine_handle<promise_type>;
+
+        explicit Task(Handle h) : handle(h) {}
+        Task(Task&& o) noexcept : handle(std::exchange(o.handle, {})) {}
+        Task(const Task&) = delete;
+        Task& operator=(const Task&) = delete;
+
+        ~Task() {
+            if (handle) handle.destroy();
+        }
+
+        bool await_ready() const noexcept { return !handle || handle.done(); }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept {
+            handle.promise().continuation = awaiter;
+            return handle;
+        }
+
+        T await_resume() { return handle.promise().result(); }
+
+    private:
+        Handle handle;
+    };
+
+    namespace detail {
+        template<typename T>
+        Task<T> TaskPromise<T>::get_return_object() {
+            return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+        }
+
+        inline Task<void> TaskPromise<void>::get_return_object() {
+            return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+        }
+
+        // Fire-and-forget frame that owns a handler's task and frees itself.
+        struct Detached {
+            struct promise_type {
+                Detached get_return_object() { return {}; }
+                std::suspend_never initial_suspend() noexcept { return {}; }
+                std::suspend_never final_suspend() noexcept { return {}; }
+                void return_void() {}
+                void unhandled_exception() { std::terminate(); }
+            };
+        };
+
+        // Runs a handler's task to completion and hands the connection back.
+        // A task that throws or never sends answers with a 500.
+        inline Detached run(Task<void> task, Response& res) {
+            try {
+                co_await task;
+            } catch (...) {
+            }
+
+            try {
+                if (!res.isSent()) {
+                    res.keepAlive(false);
+                    res.internalServerError();
+                }
+            } catch (...) {
+            }
+
+            res.complete();
+        }
+    }
+
+    // Suspends for at least delay, then resumes on the loop thread.
+    inline auto sleepFor(EventLoop& loop, std::chrono::milliseconds delay) {
+        struct Awaiter {
+            EventLoop& loop;
+            std::chrono::milliseconds delay;
+
+            bool await_ready() const noexcept { return delay.count() <= 0; }
+
+            void await_suspend(std::coroutine_handle<> h) {
+                loop.post([this, h]() {
+                    loop.after(delay, [h]() { h.resume(); });
+                });
+            }
+
+            void await_resume() noexcept {}
+        };
+
+        return Awaiter { loop, delay };
+    }
+
+    // Suspends until fd is readable or writable (or has failed), then
+    // resumes on the loop thread.
+    inline auto ready(EventLoop& loop, socket_t fd, int interest) {
+        struct Awaiter {
+            EventLoop& loop;
+            socket_t fd;
+            int interest;
+
+            bool await_ready() const noexcept { return false; }
+
+            void await_suspend(std::coroutine_handle<> h) {
+                loop.post([this, h]() {
+                    loop.watch(fd, interest, [h]() { h.resume(); });
+                });
+            }
+
+            void await_resume() noexcept {}
+        };
+
+        return Awaiter { loop, fd, interest };
+    }
+
+    inline auto readable(EventLoop& loop, socket_t fd) { return ready(loop, fd, EventLoop::READABLE); }
+    inline auto writable(EventLoop& loop, socket_t fd) { return ready(loop, fd, EventLoop::WRITABLE); }
+
+    // Reads what is available from a non-blocking socket, waiting on the
+    // loop while there is nothing. Returns recv()'s result.
+    inline Task<ssize_t> recvSome(EventLoop& loop, socket_t fd, void* buf, size_t len) {
+        while (true) {
+            ssize_t n = ::recv(fd, buf, len, 0);
+            if (n >= 0 || errno == EINTR) {
+                if (n >= 0) co_return n;
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) co_return n;
+
+            co_await readable(loop, fd);
+        }
+    }
+
+    // Writes all of buf to a non-blocking socket, waiting on the loop
+    // whenever its send buffer is full.
+    inline Task<bool> sendAll(EventLoop& loop, socket_t fd, const void* buf, size_t len) {
+        const char* data = static_cast<const char*>(buf);
+
+        while (len > 0) {
+            ssize_t n = ::send(fd, data, len, SEND_FLAGS);
+            if (n > 0) {
+                data += n;
+                len -= static_cast<size_t>(n);
+                continue;
+            }
+            if (n < 0 && errno == EINTR) continue;
+            if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) co_return false;
+
+            co_await writable(loop, fd);
+        }
+
+        co_return true;
+    }
+
+    // Runs fn on pool and resumes with its result on the loop thread, so
+    // blocking work stays off both the loop and the handler's worker.
+    template<typename F>
+    auto offload(ThreadPool& pool, EventLoop& loop, F fn) {
+        using T = std::invoke_result_t<F&>;
+
+        struct Awaiter {
+            ThreadPool& pool;
+            EventLoop& loop;
+            F fn;
+            std::conditional_t<std::is_void_v<T>, bool, std::optional<T>> result {};
+            std::exception_ptr error;
+
+            bool await_ready() const noexcept { return false; }
+
+            void await_suspend(std::coroutine_handle<> h) {
+                pool.enqueue([this, h]() {
+                    try {
+                        if constexpr (std::is_void_v<T>) fn();
+                        else result.emplace(fn());
+                    } catch (...) {
+                        error = std::current_exception();
+                    }
+                    loop.post([h]() { h.resume(); });
+                });
+            }
+
+            T await_resume() {
+                if (error) std::rethrow_exception(error);
+                if constexpr (!std::is_void_v<T>) return std::move(*result);
+            }
+        };
+
+        return Awaiter { pool, loop, std::move(fn) };
+    }
+
+    // Adapts a coroutine handler to a plain Handler, for registering it
+    // like any other: app.get(path, taskHandler([](Request&, Response&)
+    // -> Task<> {...})). The response is detached and the task started,
+    // running on the worker until its first suspension and on the event
+    // loop after that.
+    template<typename F>
+    std::function<void(Request&, Response&)> taskHandler(F fn) {
+        return [fn = std::move(fn)](Request& req, Response& res) mutable {
+            res.detach();
+            detail::run(fn(req, res), res);
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace mini_http {
+    struct HeaderField {
+        std::string name;
+        std::string value;
+    };
+
+    using HeaderList = std::vector<HeaderField>;
+
+    // Malformed header block; the connection's compression state is lost.
+    class HpackError : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    // Entries of the dynamic table, newest first (RFC 7541 section 2.3).
+    class HpackTable {
+    public:
+        explicit HpackTable(size_t maxSize) : maxSize_(maxSize) {}
+
+        // Index 1 is the newest entry.
+        const HeaderField& at(size_t index) const { return entries[index - 1]; }
+        size_t count() const { return entries.size(); }
+        size_t size() const { return size_; }
+        size_t maxSize() const { return maxSize_; }
+
+        void add(std::string name, std::string value);
+        void resize(size_t maxSize);
+
+        static size_t entrySize(std::string_view name, std::string_view value) {
+            return name.size() + value.size() + 32;
+        }
+
+    private:
+        std::deque<HeaderField> entries;
+        size_t size_ = 0;
+        size_t maxSize_;
+
+        void evict(size_t target);
+    };
+
+    class HpackDecoder {
+    public:
+        // maxTableSize is the SETTINGS_HEADER_TABLE_SIZE this side advertised.
+        explicit HpackDecoder(size_t maxTableSize = 4096);
+
+        // Decodes one complete header block into out. Every block of the
+        // connection must go through here in order, even refused ones.
+        // Throws HpackError, also once the decoded list exceeds maxListSize.
+        void decode(std::string_view block, HeaderList& out, size_t maxListSize);
+
+    private:
+        HpackTable table;
+        size_t maxTableSize;
+
+        const HeaderField& field(size_t index) const;
+        std::string_view name(size_t index) const;
+    };
+
+    class HpackEncoder {
+    public:
+        explicit HpackEncoder(size_t maxTableSize = 4096);
+
+        // The peer's SETTINGS_HEADER_TABLE_SIZE. The change is signalled at
+        // the start of the next block.
+        void tableSize(size_t maxSize);
+
+        // Appends the header block of fields. Names must be lowercase.
+        // Fields are indexed unless their values rarely repeat, and string
+        // literals are Huffman coded whenever that is shorter.
+        void encode(const HeaderList& fields, std::string& out);
+
+    private:
+        HpackTable table;
+        size_t limit;
+        size_t pendingUpdate;
+        bool updatePending = false;
+
+        void encodeField(const HeaderField& field, std::string& out);
+    };
+
+    // Primitive codings, exposed for the benchmarks.
+    void hpackEncodeInteger(std::string& out, uint64_t value, int prefixBits, uint8_t firstByte);
+    void hpackEncodeString(std::string& out, std::string_view value);
+    size_t huffmanEncodedSize(std::string_view value);
+    void huffmanEncode(std::string& out, std::string_view value);
+    void huffmanDecode(std::string& out, std::string_view encoded);
+}
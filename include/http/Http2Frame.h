@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace mini_http {
+    enum class Http2FrameType : uint8_t {
+        DATA = 0x0,
+        HEADERS = 0x1,
+        PRIORITY = 0x2,
+        RST_STREAM = 0x3,
+        SETTINGS = 0x4,
+        PUSH_PROMISE = 0x5,
+        PING = 0x6,
+        GOAWAY = 0x7,
+        WINDOW_UPDATE = 0x8,
+        CONTINUATION = 0x9
+    };
+
+    namespace Http2Flag {
+        constexpr uint8_t END_STREAM = 0x1;
+        constexpr uint8_t ACK = 0x1;
+        constexpr uint8_t END_HEADERS = 0x4;
+        constexpr uint8_t PADDED = 0x8;
+        constexpr uint8_t PRIORITY = 0x20;
+    }
+
+    // Error codes of RST_STREAM and GOAWAY (RFC 9113 section 7).
+    namespace Http2ErrorCode {
+        constexpr uint32_t NONE = 0x0;
+        constexpr uint32_t PROTOCOL = 0x1;
+        constexpr uint32_t INTERNAL = 0x2;
+        constexpr uint32_t FLOW_CONTROL = 0x3;
+        constexpr uint32_t STREAM_CLOSED = 0x5;
+        constexpr uint32_t FRAME_SIZE = 0x6;
+        constexpr uint32_t REFUSED_STREAM = 0x7;
+        constexpr uint32_t CANCEL = 0x8;
+        constexpr uint32_t COMPRESSION = 0x9;
+        constexpr uint32_t ENHANCE_YOUR_CALM = 0xb;
+        constexpr uint32_t HTTP_1_1_REQUIRED = 0xd;
+    }
+
+    namespace Http2Setting {
+        constexpr uint16_t HEADER_TABLE_SIZE = 0x1;
+        constexpr uint16_t ENABLE_PUSH = 0x2;
+        constexpr uint16_t MAX_CONCURRENT_STREAMS = 0x3;
+        constexpr uint16_t INITIAL_WINDOW_SIZE = 0x4;
+        constexpr uint16_t MAX_FRAME_SIZE = 0x5;
+        constexpr uint16_t MAX_HEADER_LIST_SIZE = 0x6;
+    }
+
+    // Client connection preface, sent before its first frame.
+    inline constexpr std::string_view HTTP2_PREFACE = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+    inline constexpr size_t HTTP2_FRAME_HEADER_SIZE = 9;
+    inline constexpr uint32_t HTTP2_DEFAULT_WINDOW = 65535;
+    inline constexpr uint32_t HTTP2_MAX_WINDOW = 0x7FFFFFFF;
+    inline constexpr uint32_t HTTP2_DEFAULT_FRAME_SIZE = 16384;
+
+    // Type is kept raw: frames of unknown types must be ignored, not rejected.
+    struct Http2Frame {
+        uint8_t type = 0;
+        uint8_t flags = 0;
+        uint32_t streamId = 0;
+        std::string_view payload;
+
+        bool is(Http2FrameType t) const { return type == static_cast<uint8_t>(t); }
+        bool has(uint8_t flag) const { return (flags & flag) != 0; }
+    };
+
+    // Protocol violation by the peer. With a stream id it only fails that
+    // stream (RST_STREAM); otherwise the whole connection (GOAWAY).
+    class Http2Error : public std::runtime_error {
+    public:
+        Http2Error(uint32_t code, const std::string& message, uint32_t streamId = 0)
+            : std::runtime_error(message), code_(code), streamId_(streamId) {}
+
+        uint32_t code() const { return code_; }
+        uint32_t streamId() const { return streamId_; }
+
+    private:
+        uint32_t code_;
+        uint32_t streamId_;
+    };
+
+    // Parses one frame from the front of data. Returns the bytes consumed,
+    // or 0 if the frame is incomplete. Throws Http2Error for frames longer
+    // than maxFrameSize.
+    size_t parseHttp2Frame(const char* data, size_t len, uint32_t maxFrameSize,
+                        Http2Frame& frame);
+
+    // Strips the padding of a PADDED DATA or HEADERS payload in place.
+    void removeHttp2Padding(Http2Frame& frame);
+
+    void appendHttp2FrameHeader(std::string& out, size_t length, Http2FrameType type,
+                            uint8_t flags, uint32_t streamId);
+
+    inline uint32_t readUint32(const char* p) {
+        const auto* b = reinterpret_cast<const uint8_t*>(p);
+        return (uint32_t(b[0]) << 24) | (uint32_t(b[1]) << 16) | (uint32_t(b[2]) << 8) | b[3];
+    }
+
+    inline void appendUint32(std::string& out, uint32_t value) {
+        out.push_back(static_cast<char>(value >> 24));
+        out.push_back(static_cast<char>(value >> 16));
+        out.push_back(static_cast<char>(value >> 8));
+        out.push_back(static_cast<char>(value));
+    }
+}
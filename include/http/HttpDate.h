@@ -0,0 +1,10 @@
+#pragma once
+#include <string>
+
+namespace mini_http {
+    // IMF-fixdate for the current second ("Sun, 06 Nov 1994 08:49:37 GMT").
+    // Each thread keeps its own copy and reformats it at most once per second.
+    const std::string& httpDate();
+
+    constexpr size_t HTTP_DATE_LENGTH = 29;
+}
@@ -10,4 +10,17 @@ namespace mini_http {
         OPTIONS,
         HEAD
     };
+
+    inline const char* methodName(HttpMethod method) {
+        switch (method) {
+            case HttpMethod::GET: return "GET";
+            case HttpMethod::POST: return "POST";
+            case HttpMethod::PUT: return "PUT";
+            case HttpMethod::DELETE_: return "DELETE";
+            case HttpMethod::PATCH: return "PATCH";
+            case HttpMethod::OPTIONS: return "OPTIONS";
+            case HttpMethod::HEAD: return "HEAD";
+            default: return "";
+        }
+    }
 }
\ No newline at end of file
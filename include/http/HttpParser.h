@@ -1,8 +1,65 @@
 #pragma once
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 #include "Request.h"
 
 namespace mini_http {
     class Connection;
 
+    class ParseError : public std::runtime_error {
+    public:
+        enum class Kind { CLOSED, TIMEOUT, MALFORMED };
+
+        ParseError(Kind kind, const std::string& message)
+            : std::runtime_error(message), kind_(kind) {}
+
+        Kind kind() const { return kind_; }
+
+    private:
+        Kind kind_;
+    };
+
+    // The HTTP/2 prior-knowledge preface comes back as a request with
+    // version "HTTP/2.0", path "*" and nothing else.
     Request parseRequest(Connection& conn);
+
+    // Status line and headers of a response from an upstream server.
+    // Header names are lowercased; repeated headers are kept in order.
+    struct ResponseHead {
+        int status = 0;
+        std::string reason;
+        std::string version;
+        std::vector<std::pair<std::string, std::string>> headers;
+
+        // First value of header name (lowercase), or null.
+        const std::string* header(std::string_view name) const;
+    };
+
+    // Parses the head at the start of data, which the caller buffers.
+    // Returns the bytes it took, or 0 while the head is incomplete.
+    // Throws ParseError (MALFORMED).
+    size_t parseResponseHead(std::string_view data, ResponseHead& out);
+
+    // Incremental decoder for a chunked body. Extensions and trailers are
+    // dropped.
+    class ChunkedDecoder {
+    public:
+        // Appends the payload found in data to out and returns the bytes
+        // used, stopping after the last chunk. Throws ParseError (MALFORMED).
+        size_t decode(std::string_view data, std::string& out);
+
+        bool done() const { return state == State::DONE; }
+        void reset();
+
+    private:
+        enum class State { SIZE, DATA, DATA_END, TRAILER, DONE };
+
+        State state = State::SIZE;
+        uint64_t remaining = 0;
+        std::string line;
+    };
 }
\ No newline at end of file
@@ -1,7 +1,10 @@
 #pragma once
 
+#include <cstddef>
+
 namespace mini_http {
     enum class HttpStatus {
+        SWITCHING_PROTOCOLS = 101,
         OK = 200,
         CREATED = 201,
         NO_CONTENT = 204,
@@ -15,6 +18,40 @@ namespace mini_http {
         FORBIDDEN = 403,
         NOT_FOUND = 404,
         METHOD_NOT_ALLOWED = 405,
-        INTERNAL_SERVER_ERROR = 500
+        INTERNAL_SERVER_ERROR = 500,
+        BAD_GATEWAY = 502,
+        SERVICE_UNAVAILABLE = 503,
+        GATEWAY_TIMEOUT = 504
+    };
+
+    inline constexpr HttpStatus HTTP_STATUSES[] = {
+        HttpStatus::SWITCHING_PROTOCOLS,
+        HttpStatus::OK,
+        HttpStatus::CREATED,
+        HttpStatus::NO_CONTENT,
+        HttpStatus::MOVED_PERMANENTLY,
+        HttpStatus::FOUND,
+        HttpStatus::SEE_OTHER,
+        HttpStatus::TEMPORARY_REDIRECT,
+        HttpStatus::PERMANENT_REDIRECT,
+        HttpStatus::BAD_REQUEST,
+        HttpStatus::UNAUTHORIZED,
+        HttpStatus::FORBIDDEN,
+        HttpStatus::NOT_FOUND,
+        HttpStatus::METHOD_NOT_ALLOWED,
+        HttpStatus::INTERNAL_SERVER_ERROR,
+        HttpStatus::BAD_GATEWAY,
+        HttpStatus::SERVICE_UNAVAILABLE,
+        HttpStatus::GATEWAY_TIMEOUT
     };
+
+    inline constexpr size_t HTTP_STATUS_COUNT =
+        sizeof(HTTP_STATUSES) / sizeof(HTTP_STATUSES[0]);
+
+    inline size_t statusIndex(HttpStatus status) {
+        for (size_t i = 0; i < HTTP_STATUS_COUNT; ++i) {
+            if (HTTP_STATUSES[i] == status) return i;
+        }
+        return HTTP_STATUS_COUNT;
+    }
 }
\ No newline at end of file
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+#include "Response.h"
+
+namespace mini_http {
+    class Connection;
+
+    // A response serialized once up front. Only the Date value is
+    // refreshed each time the bytes are sent, and a Connection header
+    // matching the connection is added unless the bytes carry their own.
+    class PreparedResponse {
+    public:
+        PreparedResponse(HttpStatus status,
+                        const Response::Headers& headers,
+                        const std::string& body);
+
+        PreparedResponse(HttpStatus status, std::string serialized);
+
+        // Queues the response on conn without copying it; the bytes stay
+        // owned by this object and must outlive conn.flush().
+        void queueTo(Connection& conn, bool keepAlive) const;
+
+        const std::string& bytes() const { return bytes_; }
+
+        // Headers and body parsed back out, for protocols that frame them
+        // differently. An automatic Date header is left out.
+        Response::Headers headers() const;
+        std::string_view body() const;
+
+        HttpStatus status() const { return status_; }
+        bool closesConnection() const { return closes_; }
+
+    private:
+        HttpStatus status_;
+        std::string bytes_;
+        size_t dateOffset_;
+        size_t headersOffset_;
+        bool hasConnection_;
+        bool closes_;
+
+        void locateHeaders(bool findDate);
+    };
+}
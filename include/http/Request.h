@@ -1,10 +1,37 @@
 #pragma once
 
+#include <algorithm>
+#include <cctype>
+#include <chrono>
 #include <string>
+#include <string_view>
 #include <unordered_map>
-#include "httpmethod.h"
+#include "HttpMethod.h"
 
 namespace mini_http {
+    struct Route;
+
+    // Whether the comma-separated list contains token, ignoring case.
+    inline bool tokenListContains(std::string_view list, std::string_view token) {
+        size_t pos = 0;
+        while (pos <= list.size()) {
+            size_t end = list.find(',', pos);
+            if (end == std::string_view::npos) end = list.size();
+
+            size_t first = pos, last = end;
+            while (first < last && std::isspace(static_cast<unsigned char>(list[first]))) ++first;
+            while (last > first && std::isspace(static_cast<unsigned char>(list[last - 1]))) --last;
+
+            if (last - first == token.size()
+                && std::equal(token.begin(), token.end(), list.begin() + first,
+                            [](char a, char b) { return std::tolower(a) == std::tolower(b); }))
+                return true;
+
+            pos = end + 1;
+        }
+        return false;
+    }
+
     struct Request {
         HttpMethod method;
         std::string path;
@@ -16,18 +43,38 @@ namespace mini_http {
 
         std::string body;
 
-        bool keepAlive() const {
-            auto it = headers.find("connection");
+        const Route* route = nullptr;
+        std::chrono::steady_clock::time_point received;
 
+        // Past this point the request is answered 503 instead of reaching
+        // its handler. Set from the route's deadline unless middleware set
+        // an earlier one; the epoch means none.
+        std::chrono::steady_clock::time_point deadline;
+
+        bool expired() const {
+            return deadline != std::chrono::steady_clock::time_point()
+                && std::chrono::steady_clock::now() > deadline;
+        }
+
+        // Whether header name, a comma-separated list, contains token,
+        // ignoring case (e.g. "upgrade" in Connection).
+        bool hasToken(const std::string& name, std::string_view token) const;
+
+        bool keepAlive() const {
             if (version == "HTTP/1.1") {
-                return it == headers.end() || it->second != "close";
+                return !hasToken("connection", "close");
             }
 
             if (version == "HTTP/1.0") {
-                return it != headers.end() && it->second == "keep-alive";
+                return hasToken("connection", "keep-alive");
             }
 
             return false;
         }
     };
-}
\ No newline at end of file
+
+    inline bool Request::hasToken(const std::string& name, std::string_view token) const {
+        auto it = headers.find(name);
+        return it != headers.end() && tokenListContains(it->second, token);
+    }
+}
@@ -1,22 +1,62 @@
 #pragma once
 
 #include "nlohmann/json.hpp"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <vector>
 
-#ifdef _WIN32
-    #include <winsock2.h>
-    using socket_t = SOCKET;
-#else
-    using socket_t = int;
-#endif
-
-#include "httpstatus.h"
+#include "HttpStatus.h"
 
 namespace mini_http {
+    class Connection;
+    class PreparedResponse;
+
 class Response {
     public:
-        explicit Response(socket_t socket);
+        using Headers = std::unordered_map<std::string, std::string>;
+
+        // Handle to a deferred response. Copies share one completion; the
+        // first resolve() wins and later ones are ignored. Dropping the last
+        // copy unresolved answers 500.
+        class Deferred {
+        public:
+            // Thread-safe. Runs fn on the connection's event loop once the
+            // handler has returned, then completes the response; it is
+            // answered with a 500 if fn throws or does not send.
+            void resolve(std::function<void(Response&)> fn) const;
+
+            void send(std::string body) const;
+            void json(nlohmann::json data) const;
+
+        private:
+            friend class Response;
+            struct State;
+
+            std::shared_ptr<State> state;
+        };
+
+        // Takes the finished response in place of the connection, for
+        // protocols that frame it themselves (HTTP/2 streams). Called on
+        // whichever thread sends; conn is then only used for its event loop.
+        class Sink {
+        public:
+            virtual ~Sink() = default;
+            virtual void respond(HttpStatus status, const Headers& headers,
+                                std::string_view body) = 0;
+
+            // Protocol switches and open-ended streams need the connection.
+            virtual void refuseTakeover() = 0;
+
+            // Size of the response taken so far, for the access log.
+            virtual uint64_t bytesOut() const = 0;
+        };
+
+        explicit Response(Connection& conn, Sink* sink = nullptr);
 
         void setStatus(HttpStatus status);
         void setHeader(const std::string& key,
@@ -28,7 +68,73 @@ class Response {
         void redirect(const std::string& location,
                 HttpStatus status = HttpStatus::FOUND);
 
+        void sendPrepared(const PreparedResponse& prepared);
+
+        // Sends 101 Switching Protocols with headers. Once the request is
+        // finished, takeover receives the connection, which then no longer
+        // belongs to the request/response loop.
+        void switchProtocols(const Headers& headers,
+                            std::function<void(Connection&)> takeover);
+        // Sends the status and headers without a Content-Length and hands
+        // the connection to takeover the same way, to write the body over
+        // time. The connection is closed when its new owner is done.
+        void stream(std::function<void(Connection&)> takeover);
+
+        bool upgraded() const { return static_cast<bool>(takeover_); }
+
         bool isSent() const;
+        HttpStatus status() const { return status_; }
+
+        // The client connection, for responses written to it directly (a
+        // relayed upstream response); markSent() then records the response
+        // so it is logged and the connection reused as usual. Framed
+        // responses (HTTP/2 streams) cannot be written that way.
+        Connection& connection() { return conn_; }
+        bool framed() const { return sink_ != nullptr; }
+
+        // Bytes written for this response: the connection's count, or the
+        // sink's for a framed response sharing its connection with others.
+        uint64_t bytesOut() const;
+        void markSent(HttpStatus status);
+
+        // Whether the connection stays open after this response. Sent as
+        // the Connection header unless the handler set one itself.
+        void keepAlive(bool enabled) { keepAlive_ = enabled; }
+        bool keepAlive() const { return keepAlive_; }
+
+        // Whether a route that caches or coalesces may hand this response
+        // to other requests. Turn it off for content meant for this client
+        // only; responses with Set-Cookie, Cache-Control private or
+        // no-store, or a Vary outside the route's key are never shared.
+        void shareable(bool enabled) { shareable_ = enabled; }
+        bool shareable() const { return shareable_; }
+
+        const Headers& headers() const { return headers_; }
+
+        // While set, every serialized response is also copied into sink.
+        void capture(std::string* sink) { capture_ = sink; }
+
+        // Lets the handler return before the response is sent. The worker
+        // moves on to other connections, and whoever sends the response
+        // calls complete() afterwards, from any thread; the request and
+        // response stay valid until then. Detaches nest: the response is
+        // done once every detach() has been matched by a complete().
+        void detach();
+        void complete();
+        bool detached() const { return state_.load() != State::SYNC; }
+
+        // Detaches the response and returns a handle that sends it later,
+        // from any thread. The handler must not touch res after calling
+        // defer(): it belongs to whoever resolves the handle, and resolve()
+        // only runs once the handler and the middleware around it have
+        // returned.
+        Deferred defer();
+
+        // Runs fn once the handler and the middleware around it have
+        // returned: right away if they have, otherwise on the thread that
+        // unwound them. For work that continues a detached response
+        // elsewhere, which must not race the middleware still using it.
+        void whenReturned(std::function<void()> fn);
 
         // 2xx
         void ok(const nlohmann::json& data);
@@ -51,14 +157,47 @@ class Response {
 
         // 5xx
         void internalServerError(const std::string& message = "Internal Server Error");
+        void badGateway(const std::string& message = "Bad Gateway");
+        void serviceUnavailable(const std::string& message = "Service Unavailable");
+        void gatewayTimeout(const std::string& message = "Gateway Timeout");
+
+        static void serialize(HttpStatus status,
+                            const Headers& headers,
+                            const std::string& body,
+                            std::string& out,
+                            std::string_view connection = {});
     private:
-        socket_t socket_;
+        friend class App;
+
+        enum class State { SYNC, DETACHED, HANDED_OFF, COMPLETED };
+
+        Connection& conn_;
+        Sink* sink_;
         HttpStatus status_;
-        std::unordered_map<std::string, std::string> headers_;
+        Headers headers_;
         bool sent_;
+        bool keepAlive_;
+        bool shareable_;
+        std::string* capture_;
+        std::atomic<State> state_;
+        std::atomic<int> holds_;
+        std::function<void()> onComplete_;
+        std::mutex returnMutex_;
+        bool returned_;
+        std::vector<std::function<void()>> onReturn_;
+        std::function<void(Connection&)> takeover_;
+        static void appendHeaders(const Headers& headers,
+                                size_t contentLength,
+                                std::string& out,
+                                std::string_view connection);
+
+        // Called once the handler has returned; runs what whenReturned()
+        // held back. False if the response was already completed, so the
+        // caller finishes it synchronously.
+        bool handOff(std::function<void()> onComplete);
+        void sendOpenEnded(std::function<void(Connection&)> takeover);
 
-        std::string buildResponse(const std::string& body) const;
-        void write(const std::string& data);
+        void flush();
         void sendError(HttpStatus status, const std::string& message);
     };
 }
\ No newline at end of file
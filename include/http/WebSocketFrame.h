@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace mini_http {
+    enum class WebSocketOpcode : uint8_t {
+        CONTINUATION = 0x0,
+        TEXT = 0x1,
+        BINARY = 0x2,
+        CLOSE = 0x8,
+        PING = 0x9,
+        PONG = 0xA
+    };
+
+    struct WebSocketFrame {
+        bool fin = false;
+        WebSocketOpcode opcode = WebSocketOpcode::CONTINUATION;
+        std::string_view payload;
+    };
+
+    // Protocol violation by the peer, carrying the close code to answer with.
+    class WebSocketError : public std::runtime_error {
+    public:
+        WebSocketError(uint16_t code, const std::string& message)
+            : std::runtime_error(message), code_(code) {}
+
+        uint16_t code() const { return code_; }
+
+    private:
+        uint16_t code_;
+    };
+
+    namespace WebSocketClose {
+        constexpr uint16_t NORMAL = 1000;
+        constexpr uint16_t GOING_AWAY = 1001;
+        constexpr uint16_t PROTOCOL_ERROR = 1002;
+        constexpr uint16_t NO_STATUS = 1005;
+        constexpr uint16_t ABNORMAL = 1006;
+        constexpr uint16_t INVALID_PAYLOAD = 1007;
+        constexpr uint16_t POLICY_VIOLATION = 1008;
+        constexpr uint16_t TOO_BIG = 1009;
+    }
+
+    // Parses one client frame from the front of data, unmasking its payload
+    // in place. Returns the bytes consumed, or 0 if the frame is incomplete.
+    // Throws WebSocketError on unmasked, oversized or malformed frames.
+    size_t parseWebSocketFrame(char* data, size_t len, size_t maxPayload,
+                            WebSocketFrame& frame);
+
+    // XORs data with the 4-byte masking key, 16 or 32 bytes at a time
+    // where SSE2/AVX2/NEON is available.
+    void unmaskWebSocket(char* data, size_t len, const uint8_t key[4]);
+
+    // Whether data is well-formed UTF-8 (no overlong forms, surrogates or
+    // code points past U+10FFFF). ASCII is skipped 8 bytes at a time.
+    bool validUtf8(std::string_view data);
+
+    // Whether a peer may send code in a close frame (RFC 6455 7.4): 1005,
+    // 1006 and 1015 are for local use only, and 1016-2999 are reserved.
+    bool validCloseCode(uint16_t code);
+
+    // Appends the header of an unmasked (server) frame.
+    void appendWebSocketHeader(std::string& out, WebSocketOpcode opcode,
+                            size_t payloadLength, bool fin = true);
+
+    // Sec-WebSocket-Accept value for a client's Sec-WebSocket-Key.
+    std::string webSocketAccept(std::string_view key);
+}
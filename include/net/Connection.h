@@ -1,8 +1,17 @@
 #pragma once
 #include <http/HttpParser.h>
 #include <functional>
+#include <algorithm>
 #include <atomic>
+#include <chrono>
+#include <climits>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
 #include <thread>
+#include <cerrno>
 #include "ThreadPool.h"
 
 #ifdef _WIN32
@@ -18,16 +27,60 @@
     #include <unistd.h>
     #include <poll.h>
     #include <sys/types.h>
+    #include <sys/uio.h>
 
     using socket_t = int;
     static constexpr socket_t INVALID_SOCK = -1;
 #endif
 
+#ifdef MSG_NOSIGNAL
+    static constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+    static constexpr int SEND_FLAGS = 0;
+#endif
+
 namespace mini_http {
+    class EventLoop;
+
     class Connection {
     public:
+        // Bytes the queue keeps alive until written. Shared, so a message
+        // fanned out to many connections is encoded once.
+        using Buffer = std::shared_ptr<const std::string>;
+
         std::string readBuffer;
-        explicit Connection(socket_t fd) : fd(fd) {}
+        std::string writeBuffer;
+
+        uint64_t bytesIn = 0;
+        uint64_t bytesOut = 0;
+
+        // Requests started on this connection, and whether the server is
+        // still willing to keep it open after the current one.
+        size_t requests = 0;
+        bool allowKeepAlive = true;
+
+        // Index of the server shard (worker and connection pool) that owns it.
+        size_t shard = 0;
+
+        // When the server found the connection readable and queued it for a
+        // worker. The parser dates a fresh request from here, so queueing
+        // counts toward its latency and deadline.
+        std::chrono::steady_clock::time_point readyAt;
+
+        // Event loop that watches the connection between requests, and that
+        // deferred responses are completed on. Null on Windows.
+        EventLoop* loop = nullptr;
+
+        // On a non-blocking socket, how long read/write/flush wait for it to
+        // become ready before failing with EAGAIN. Negative for blocking
+        // sockets, where the kernel's SO_RCVTIMEO applies instead.
+        std::chrono::milliseconds ioTimeout { -1 };
+
+        // Per-connection state owned by the connection handler, kept across
+        // requests and pool reuse.
+        std::shared_ptr<void> context;
+
+        explicit Connection(socket_t fd = INVALID_SOCK) : fd(fd) {}
 
         ~Connection() { close(); }
 
@@ -37,20 +90,193 @@ namespace mini_http {
 
         socket_t raw() const { return fd; }
 
-        ssize_t read(void* buf, size_t len) const {
+        void reset(socket_t newFd) {
+            close();
+            fd = newFd;
+        }
+
+        void recycle(size_t bufferSize, size_t maxRetained) {
+            close();
+            bytesIn = 0;
+            bytesOut = 0;
+            requests = 0;
+            allowKeepAlive = true;
+            ioTimeout = std::chrono::milliseconds(-1);
+            discardQueue();
+            readBuffer.clear();
+            writeBuffer.clear();
+
+            if (readBuffer.capacity() > maxRetained)
+                std::string().swap(readBuffer);
+            if (writeBuffer.capacity() > maxRetained)
+                std::string().swap(writeBuffer);
+
+            readBuffer.reserve(bufferSize);
+            writeBuffer.reserve(bufferSize);
+        }
+
+        ssize_t read(void* buf, size_t len) {
+            #ifdef _WIN32
+                ssize_t n = ::recv(fd, static_cast<char*>(buf), static_cast<int>(len), 0);
+            #else
+                ssize_t n;
+                while ((n = ::recv(fd, buf, len, 0)) < 0 && retry(POLLIN)) {}
+            #endif
+            if (n > 0) bytesIn += static_cast<uint64_t>(n);
+            return n;
+        }
+
+        ssize_t write(const void* buf, size_t len) {
             #ifdef _WIN32
-                return ::recv(fd, static_cast<char*>(buf), static_cast<int>(len), 0);
+                ssize_t n = ::send(fd, static_cast<const char*>(buf), static_cast<int>(len), 0);
             #else
-                return ::recv(fd, buf, len, 0);
+                ssize_t n;
+                while ((n = ::send(fd, buf, len, SEND_FLAGS)) < 0 && retry(POLLOUT)) {}
             #endif
+            if (n > 0) bytesOut += static_cast<uint64_t>(n);
+            return n;
         }
 
-        ssize_t write(const void* buf, size_t len) const {
+        bool writeAll(const void* buf, size_t len) {
+            const char* data = static_cast<const char*>(buf);
+            size_t totalSent = 0;
+
+            while (totalSent < len) {
+                auto sent = write(data + totalSent, len - totalSent);
+
+                if (sent <= 0) {
+                    #ifndef _WIN32
+                        if (sent < 0 && errno == EINTR) continue;
+                    #endif
+                    return false;
+                }
+                totalSent += static_cast<size_t>(sent);
+            }
+
+            return true;
+        }
+
+        // Scatter-gather output. Queued buffers are borrowed, not copied, and
+        // must stay valid until they are written: until flush() returns, or
+        // for flushSome() until the queue is empty. Both send them with as
+        // few writev-style calls as the socket allows.
+        void queue(const void* data, size_t len) {
+            if (len == 0) return;
             #ifdef _WIN32
-                return ::send(fd, static_cast<const char*>(buf), static_cast<int>(len), 0);
+                WSABUF buf;
+                buf.buf = static_cast<CHAR*>(const_cast<void*>(data));
+                buf.len = static_cast<ULONG>(len);
+                outQueue.push_back(buf);
             #else
-                return ::send(fd, buf, len, 0);
+                outQueue.push_back({ const_cast<void*>(data), len });
             #endif
+            outBytes += len;
+        }
+
+        void queue(std::string_view data) { queue(data.data(), data.size()); }
+
+        // Queues a buffer the connection holds on to until it is written.
+        void queue(Buffer buffer) {
+            if (buffer->empty()) return;
+            queue(buffer->data(), buffer->size());
+            outOwners.emplace_back(outBase + outQueue.size() - 1, std::move(buffer));
+        }
+
+        bool hasQueued() const { return outHead < outQueue.size(); }
+        size_t queuedBytes() const { return outBytes; }
+
+        // Writes until the queue is empty or the socket would block; the
+        // rest stays queued for the next call. For event-loop owners, which
+        // must not wait on one client. False on a socket error, which drops
+        // the queue.
+        bool flushSome() {
+            while (outHead < outQueue.size()) {
+                size_t count = std::min<size_t>(outQueue.size() - outHead, MAX_IOV);
+
+                #ifdef _WIN32
+                    DWORD sent = 0;
+                    if (WSASend(fd, &outQueue[outHead], static_cast<DWORD>(count),
+                                &sent, 0, nullptr, nullptr) != 0 || sent == 0) {
+                        discardQueue();
+                        return false;
+                    }
+                    size_t n = sent;
+                #else
+                    msghdr msg {};
+                    msg.msg_iov = &outQueue[outHead];
+                    msg.msg_iovlen = count;
+
+                    ssize_t result = ::sendmsg(fd, &msg, SEND_FLAGS);
+                    if (result < 0 && errno == EINTR) continue;
+                    if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+                    if (result <= 0) {
+                        discardQueue();
+                        return false;
+                    }
+                    size_t n = static_cast<size_t>(result);
+                #endif
+
+                bytesOut += n;
+                outBytes -= n;
+
+                while (n > 0) {
+                    auto& buf = outQueue[outHead];
+                    size_t len = bufferLength(buf);
+
+                    if (n < len) {
+                        advance(buf, n);
+                        break;
+                    }
+
+                    n -= len;
+                    ++outHead;
+                }
+            }
+
+            releaseWritten();
+            return true;
+        }
+
+        // Writes the whole queue, waiting up to ioTimeout each time the
+        // socket would block.
+        bool flush() {
+            while (true) {
+                if (!flushSome()) return false;
+                if (!hasQueued()) return true;
+
+                #ifdef _WIN32
+                    discardQueue();
+                    return false;
+                #else
+                    errno = EAGAIN;
+                    if (!retry(POLLOUT)) {
+                        discardQueue();
+                        return false;
+                    }
+                #endif
+            }
+        }
+
+        // Copies what is left of the queue into one owned buffer, so it can
+        // be written after the borrowed buffers are gone.
+        void retainQueued() {
+            if (!hasQueued()) return;
+
+            std::string rest;
+            rest.reserve(outBytes);
+            for (size_t i = outHead; i < outQueue.size(); ++i)
+                rest.append(bufferData(outQueue[i]), bufferLength(outQueue[i]));
+
+            discardQueue();
+            queue(std::make_shared<const std::string>(std::move(rest)));
+        }
+
+        void discardQueue() {
+            outQueue.clear();
+            outOwners.clear();
+            outBase = 0;
+            outHead = 0;
+            outBytes = 0;
         }
 
         void close() {
@@ -65,5 +291,75 @@ namespace mini_http {
 
     private:
         socket_t fd;
+
+        #ifdef _WIN32
+            static constexpr size_t MAX_IOV = 64;
+            std::vector<WSABUF> outQueue;
+
+            static size_t bufferLength(const WSABUF& buf) { return buf.len; }
+            static const char* bufferData(const WSABUF& buf) { return buf.buf; }
+            static void advance(WSABUF& buf, size_t n) {
+                buf.buf += n;
+                buf.len -= static_cast<ULONG>(n);
+            }
+        #else
+            #ifdef IOV_MAX
+                static constexpr size_t MAX_IOV = IOV_MAX;
+            #else
+                static constexpr size_t MAX_IOV = 64;
+            #endif
+            std::vector<iovec> outQueue;
+
+            static size_t bufferLength(const iovec& buf) { return buf.iov_len; }
+            static const char* bufferData(const iovec& buf) { return static_cast<const char*>(buf.iov_base); }
+            static void advance(iovec& buf, size_t n) {
+                buf.iov_base = static_cast<char*>(buf.iov_base) + n;
+                buf.iov_len -= n;
+            }
+        #endif
+        size_t outHead = 0;
+        size_t outBytes = 0;
+
+        // Buffers queued with ownership, by position in the queue counted
+        // from its last reset; outBase is the position of outQueue[0].
+        std::deque<std::pair<size_t, Buffer>> outOwners;
+        size_t outBase = 0;
+
+        // Drops what has been written: all of it once the queue is empty,
+        // otherwise the owned buffers, and the entries once they pile up
+        // on a connection whose queue never empties.
+        void releaseWritten() {
+            if (outHead == outQueue.size()) {
+                discardQueue();
+                return;
+            }
+
+            while (!outOwners.empty() && outOwners.front().first < outBase + outHead)
+                outOwners.pop_front();
+
+            if (outHead >= 64 && outHead * 2 >= outQueue.size()) {
+                outQueue.erase(outQueue.begin(), outQueue.begin() + static_cast<std::ptrdiff_t>(outHead));
+                outBase += outHead;
+                outHead = 0;
+            }
+        }
+
+        #ifndef _WIN32
+            // Decides whether a failed call should be repeated, waiting for
+            // readiness first when the socket is non-blocking.
+            bool retry(short events) {
+                if (errno == EINTR) return true;
+                if ((errno != EAGAIN && errno != EWOULDBLOCK) || ioTimeout.count() < 0)
+                    return false;
+
+                pollfd pfd { fd, events, 0 };
+                int ready;
+                while ((ready = ::poll(&pfd, 1, static_cast<int>(ioTimeout.count()))) < 0
+                    && errno == EINTR) {}
+
+                if (ready == 0) errno = EAGAIN;
+                return ready > 0;
+            }
+        #endif
     };
 }
\ No newline at end of file
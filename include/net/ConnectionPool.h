@@ -0,0 +1,32 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "Connection.h"
+
+namespace mini_http {
+    class ConnectionPool {
+    public:
+        explicit ConnectionPool(size_t capacity,
+                                size_t bufferSize = 16 * 1024,
+                                size_t maxRetained = 64 * 1024);
+
+        ConnectionPool(const ConnectionPool&) = delete;
+        ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+        Connection* acquire(socket_t fd);
+        void release(Connection* conn);
+
+        // Fills the free list and touches every buffer, so that on a
+        // first-touch NUMA policy the memory lands on the calling thread's node.
+        void prewarm();
+
+    private:
+        size_t capacity;
+        size_t bufferSize;
+        size_t maxRetained;
+
+        std::mutex mtx;
+        std::vector<std::unique_ptr<Connection>> freeList;
+    };
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace mini_http {
+    using CpuSet = std::vector<int>;
+
+    // CPUs of each NUMA node as listed in sysfs. Falls back to a single node
+    // holding every CPU when the topology is unavailable.
+    std::vector<CpuSet> numaNodes();
+
+    // Restricts the calling thread to cpus. Returns false where affinity is
+    // unsupported or the call fails.
+    bool pinCurrentThread(const CpuSet& cpus);
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "Connection.h"
+
+namespace mini_http {
+    // Single-threaded reactor: fd readiness callbacks and timers, all run on
+    // the thread inside run(). Other threads hand it work through post().
+    // epoll on Linux, poll() on other POSIX systems.
+    class EventLoop {
+    public:
+        using Callback = std::function<void()>;
+        using TimerId = uint64_t;
+
+        enum Interest { READABLE = 1, WRITABLE = 2 };
+
+        EventLoop();
+        ~EventLoop();
+
+        EventLoop(const EventLoop&) = delete;
+        EventLoop& operator=(const EventLoop&) = delete;
+
+        // Runs callbacks until stop() is called.
+        void run();
+
+        // Thread-safe and lock-free; only a post into an empty queue wakes
+        // the loop.
+        void stop();
+        void post(Callback fn);
+        bool inLoopThread() const { return std::this_thread::get_id() == owner; }
+
+        // Loop thread only. A watch fires once and is then removed unless
+        // persistent; watching an fd again replaces its callback.
+        void watch(socket_t fd, int interest, Callback fn, bool persistent = false);
+        void unwatch(socket_t fd);
+
+        TimerId after(std::chrono::milliseconds delay, Callback fn);
+        void cancel(TimerId timer);
+
+    private:
+        struct Watch {
+            int interest;
+            bool persistent;
+            Callback fn;
+        };
+
+        struct Timer {
+            std::chrono::steady_clock::time_point deadline;
+            TimerId id;
+            bool operator>(const Timer& o) const { return deadline > o.deadline; }
+        };
+
+        std::thread::id owner;
+        bool running = false;
+
+        #ifdef __linux__
+            int epollFd = -1;
+            int wakeFd = -1;
+        #else
+            int wakePipe[2] { -1, -1 };
+        #endif
+
+        std::unordered_map<socket_t, Watch> watches;
+
+        std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timerQueue;
+        std::unordered_map<TimerId, Callback> timers;
+        TimerId nextTimer = 1;
+
+        // Treiber stack of posted callbacks, newest first.
+        struct Posted {
+            Callback fn;
+            Posted* next;
+        };
+        std::atomic<Posted*> posted { nullptr };
+
+        int nextTimeout();
+        void runTimers();
+        void runPosted();
+        void dispatch(socket_t fd, int ready);
+        void wake();
+    };
+}
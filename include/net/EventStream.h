@@ -0,0 +1,128 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "EventLoop.h"
+
+namespace mini_http {
+    struct Request;
+    class Response;
+    class EventStream;
+
+    // Callbacks of a Server-Sent Events endpoint, run on the server's event
+    // loop. open is where a stream subscribes to its topics.
+    struct EventStreamHandlers {
+        std::function<void(EventStream&)> open;
+        std::function<void(EventStream&)> close;
+
+        // Streams idle this long get a comment line, so proxies and clients
+        // keep the connection. Zero disables heartbeats.
+        std::chrono::milliseconds heartbeat { 15000 };
+
+        // Unsent bytes a slow client may fall behind by before it is dropped.
+        size_t maxBufferedBytes = 1024 * 1024;
+    };
+
+    class EventStreamHub;
+
+    // One subscriber connection. Owned by its hub until closed.
+    class EventStream : public std::enable_shared_from_this<EventStream> {
+    public:
+        using Params = std::unordered_map<std::string, std::string>;
+
+        EventStream(EventStreamHub& hub, Connection& conn, Params params,
+                    std::string lastEventId, std::function<void(Connection*)> release);
+
+        // All thread-safe.
+        void subscribe(const std::string& topic);
+        void unsubscribe(const std::string& topic);
+        void send(std::string_view data, std::string_view event = {}, std::string_view id = {});
+        void close();
+
+        const Params& params() const { return params_; }
+
+        // Last-Event-ID sent by a reconnecting client, or empty.
+        const std::string& lastEventId() const { return lastEventId_; }
+
+        // Free for the application, e.g. session state set in open.
+        std::shared_ptr<void> data;
+
+    private:
+        friend class EventStreamHub;
+
+        EventStreamHub& hub;
+        Connection& conn;
+        EventLoop& loop;
+        Params params_;
+        std::string lastEventId_;
+        std::function<void(Connection*)> release;
+
+        // Everything below is touched on the loop thread only.
+        size_t index = 0;
+        std::vector<std::string> topics;
+        bool active = false;
+        bool watchingWritable = false;
+        bool closed = false;
+
+        void start();
+        void onReady();
+        void enqueue(Connection::Buffer event);
+        void flush();
+        void watch(bool writable);
+        void terminate();
+        void inLoop(std::function<void()> fn);
+    };
+
+    // The streams of one app.sse() endpoint and the topics they follow.
+    class EventStreamHub {
+    public:
+        explicit EventStreamHub(EventStreamHandlers handlers);
+
+        // Thread-safe. Encodes the event once and queues those bytes to
+        // every subscriber of topic. Events published together are flushed
+        // with a single write per stream.
+        void publish(const std::string& topic, std::string_view data,
+                    std::string_view event = {}, std::string_view id = {});
+
+        size_t subscribers() const { return count.load(); }
+
+        // Starts the text/event-stream response and takes the connection over.
+        void accept(Request& req, Response& res,
+                    std::function<void(Connection*)> release);
+
+        // One event in wire format: optional id and event lines, then a data
+        // line per line of data. Throws std::invalid_argument if id or event
+        // contains CR, LF or NUL.
+        static Connection::Buffer encode(std::string_view data,
+                                        std::string_view event = {},
+                                        std::string_view id = {});
+
+    private:
+        friend class EventStream;
+
+        EventStreamHandlers handlers;
+        std::atomic<EventLoop*> loop { nullptr };
+        std::atomic<size_t> count { 0 };
+
+        // Loop thread only.
+        std::vector<std::shared_ptr<EventStream>> streams;
+        std::unordered_map<std::string, std::vector<EventStream*>> topics;
+        bool flushScheduled = false;
+        bool heartbeatArmed = false;
+
+        void add(const std::shared_ptr<EventStream>& stream);
+        void remove(EventStream& stream);
+        void subscribe(EventStream& stream, const std::string& topic);
+        void unsubscribe(EventStream& stream, const std::string& topic);
+        void scheduleFlush();
+        void flushAll();
+        void heartbeat();
+    };
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "EventLoop.h"
+#include "http/Hpack.h"
+#include "http/Http2Frame.h"
+
+namespace mini_http {
+    struct Request;
+    class Response;
+
+    // HTTP/2 over cleartext TCP (h2c), by prior knowledge or by upgrading
+    // an HTTP/1.1 request. The SETTINGS advertised to clients come from here.
+    struct Http2Options {
+        bool enabled = true;
+
+        uint32_t maxConcurrentStreams = 100;
+        uint32_t initialWindowSize = HTTP2_DEFAULT_WINDOW;
+        uint32_t maxFrameSize = HTTP2_DEFAULT_FRAME_SIZE;
+        uint32_t headerTableSize = 4096;
+        uint32_t maxHeaderListSize = 16384;
+
+        // Receive window shared by all streams of a connection.
+        uint32_t connectionWindowSize = 1024 * 1024;
+
+        // Larger request bodies reset their stream.
+        size_t maxBodySize = 8 * 1024 * 1024;
+    };
+
+    // One HTTP/2 connection. Frames are read and written on the server's
+    // event loop; each stream's request runs on a worker like an HTTP/1
+    // request, so many of them can be in flight at once.
+    class Http2Session : public std::enable_shared_from_this<Http2Session> {
+    public:
+        // Runs the request of a stream into its response. done must be
+        // called once the response is complete, from any thread.
+        using Handler = std::function<void(Request&, Response&, std::function<void()> done)>;
+        using Executor = std::function<void(std::function<void()>)>;
+
+        Http2Session(Connection& conn, const Http2Options& options,
+                    std::chrono::milliseconds idleTimeout, Executor execute,
+                    Handler handler, std::function<void(Connection*)> release);
+
+        // Takes the connection over after the parser consumed the start of
+        // the prior-knowledge preface.
+        void start();
+
+        // Takes the connection over after a 101 answer to an h2c upgrade;
+        // the upgrading request becomes stream 1. settings is the request's
+        // HTTP2-Settings header.
+        void start(Request upgraded, const std::string& settings);
+
+    private:
+        struct Stream;
+        using StreamPtr = std::shared_ptr<Stream>;
+
+        Connection& conn;
+        EventLoop& loop;
+        Http2Options options;
+        std::chrono::milliseconds idleTimeout;
+        Executor execute;
+        Handler handler;
+        std::function<void(Connection*)> release;
+
+        // Everything below is touched on the loop thread only.
+        HpackDecoder decoder;
+        HpackEncoder encoder;
+        std::unordered_map<uint32_t, StreamPtr> streams;
+        uint32_t lastStreamId = 0;
+        size_t prefaceLeft;
+
+        // Header block being collected across CONTINUATION frames.
+        std::string headerBlock;
+        uint32_t headerStream = 0;
+        bool headerEndStream = false;
+        bool continuing = false;
+
+        // Peer settings and flow control.
+        uint32_t peerWindowSize = HTTP2_DEFAULT_WINDOW;
+        uint32_t peerFrameSize = HTTP2_DEFAULT_FRAME_SIZE;
+        int64_t sendWindow = HTTP2_DEFAULT_WINDOW;
+        int64_t receiveWindow;
+
+        // Streams with response data left, served round-robin.
+        std::deque<StreamPtr> sending;
+
+        // Frames not yet handed to out.
+        std::string pending;
+
+        EventLoop::TimerId idleTimer = 0;
+        bool goingAway = false;
+        bool watchingWritable = false;
+        bool closed = false;
+
+        void begin();
+        void onReady();
+        void readAvailable();
+        void process();
+        void handle(const Http2Frame& frame);
+        void onHeaders(Http2Frame frame);
+        void onHeaderBlock();
+        void onData(Http2Frame frame);
+        void onSettings(const Http2Frame& frame);
+        void onWindowUpdate(const Http2Frame& frame);
+        void onResetStream(const Http2Frame& frame);
+        void applySettings(std::string_view payload);
+        void requeue(const StreamPtr& stream);
+
+        StreamPtr open(uint32_t id, HeaderList& fields);
+        void run(const StreamPtr& stream);
+        void complete(uint32_t id);
+        void writeData();
+        void close(const StreamPtr& stream);
+
+        void sendSettings();
+        void sendWindowUpdate(uint32_t streamId, uint32_t increment);
+        void resetStream(uint32_t id, uint32_t code);
+        void goAway(uint32_t code, std::string_view reason);
+        void armIdleTimer();
+
+        void flush();
+        void watch(bool writable);
+        void terminate();
+    };
+}
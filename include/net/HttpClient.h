@@ -0,0 +1,193 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "EventLoop.h"
+#include "core/Task.h"
+#include "http/HttpMethod.h"
+#include "http/HttpParser.h"
+
+namespace mini_http {
+    // An upstream server. host is an address or a name, resolved the first
+    // time the client sends to it.
+    struct Upstream {
+        std::string host;
+        int port = 80;
+
+        std::string authority() const { return host + ":" + std::to_string(port); }
+    };
+
+    struct HttpClientOptions {
+        // Open connections per upstream, busy or idle.
+        size_t maxConnections = 64;
+
+        // Requests written ahead of their responses on one connection.
+        // Only idempotent requests are pipelined; 1 turns it off.
+        size_t pipelineDepth = 1;
+
+        std::chrono::milliseconds connectTimeout { 2000 };
+
+        // From the call until the end of the response, including any wait
+        // for a free connection.
+        std::chrono::milliseconds requestTimeout { 30000 };
+
+        // Pooled connections unused this long are closed.
+        std::chrono::milliseconds idleTimeout { 60000 };
+
+        // Largest body send() collects.
+        size_t maxResponseSize = 64 * 1024 * 1024;
+    };
+
+    enum class ClientError { NONE, CONNECT, TIMEOUT, CLOSED, MALFORMED, TOO_LARGE, CANCELLED };
+
+    struct ClientRequest {
+        HttpMethod method = HttpMethod::GET;
+
+        // Path and query.
+        std::string target = "/";
+
+        // Host defaults to the upstream's authority; Content-Length is set
+        // by the client.
+        std::vector<std::pair<std::string, std::string>> headers;
+        std::string body;
+
+        // Overrides HttpClientOptions::requestTimeout when non-zero.
+        std::chrono::milliseconds timeout { 0 };
+    };
+
+    struct ClientResponse : ResponseHead {
+        ClientError error = ClientError::NONE;
+        std::string body;
+
+        bool ok() const { return error == ClientError::NONE; }
+    };
+
+    // HTTP/1.1 client for calling upstream services from handlers. It runs
+    // on an event loop, keeps a pool of keep-alive connections per upstream
+    // and never blocks a worker while a response is outstanding. Destroy it
+    // only once the loop has stopped.
+    class HttpClient {
+    public:
+        // Receives a streamed response, on the loop thread.
+        class Receiver {
+        public:
+            virtual ~Receiver() = default;
+
+            virtual void head(const ResponseHead& head) = 0;
+
+            // Decoded body bytes. Returning false stops reading from the
+            // upstream until HttpClient::resume().
+            virtual bool data(std::string_view bytes) = 0;
+
+            // Last call, after the body or on the first error.
+            virtual void end(ClientError error) = 0;
+        };
+
+        struct Exchange;
+        using ExchangePtr = std::shared_ptr<Exchange>;
+
+        explicit HttpClient(EventLoop& loop, HttpClientOptions options = {});
+        ~HttpClient();
+
+        HttpClient(const HttpClient&) = delete;
+        HttpClient& operator=(const HttpClient&) = delete;
+
+        // Thread-safe. Sends request to upstream and streams the response
+        // into receiver.
+        ExchangePtr start(const Upstream& upstream, ClientRequest request,
+                        std::shared_ptr<Receiver> receiver);
+
+        // Thread-safe. Collects the whole response; done runs on the loop
+        // thread, also on failure (see ClientResponse::error).
+        void send(const Upstream& upstream, ClientRequest request,
+                std::function<void(ClientResponse&)> done);
+
+        // Loop thread only. Continues a response paused by Receiver::data().
+        void resume(const ExchangePtr& exchange);
+
+        // Loop thread only, including from the receiver's own callbacks.
+        // Abandons the exchange; its receiver is not called again.
+        void cancel(const ExchangePtr& exchange);
+
+        // Open upstream connections, busy or idle.
+        size_t connections() const { return open.load(std::memory_order_relaxed); }
+
+        EventLoop& eventLoop() { return loop; }
+
+    private:
+        struct Link;
+        struct Pool;
+        using LinkPtr = std::shared_ptr<Link>;
+
+        EventLoop& loop;
+        HttpClientOptions options;
+        std::atomic<size_t> open { 0 };
+
+        // Loop thread only, keyed by authority.
+        std::unordered_map<std::string, std::unique_ptr<Pool>> pools;
+
+        void submit(const ExchangePtr& exchange);
+        Pool* poolFor(const Upstream& upstream);
+        void pump(Pool& pool);
+        Link* pick(Pool& pool, const Exchange& exchange);
+        bool connect(Pool& pool);
+        void connectFailed(Pool& pool);
+        void dispatch(Link& link, ExchangePtr exchange);
+
+        void onReady(const LinkPtr& link);
+        void onConnected(const LinkPtr& link);
+        void readAvailable(const LinkPtr& link);
+        void process(const LinkPtr& link);
+        bool startBody(const LinkPtr& link, const Exchange& exchange);
+        bool deliver(Link& link, Exchange& exchange, std::string_view bytes);
+        void finishResponse(const LinkPtr& link);
+        void onClosed(const LinkPtr& link);
+        void flush(const LinkPtr& link);
+        void updateWatch(const LinkPtr& link);
+        void makeIdle(const LinkPtr& link);
+
+        void abort(const LinkPtr& link, const Exchange* culprit, ClientError error);
+        void closeLink(const LinkPtr& link);
+        void finish(const ExchangePtr& exchange, ClientError error);
+        void timeout(const ExchangePtr& exchange);
+    };
+
+    #ifdef MINI_HTTP_HAS_COROUTINES
+        // co_await fetch(client, upstream, request) in a coroutine handler
+        // resumes on the client's loop thread with the whole response.
+        inline auto fetch(HttpClient& client, const Upstream& upstream, ClientRequest request) {
+            struct Awaiter {
+                HttpClient& client;
+                Upstream upstream;
+                ClientRequest request;
+                ClientResponse response;
+
+                bool await_ready() const noexcept { return false; }
+
+                // Sent from the loop, so h cannot resume before this call
+                // has returned.
+                void await_suspend(std::coroutine_handle<> h) {
+                    client.eventLoop().post([this, h]() {
+                        client.send(upstream, std::move(request), [this, h](ClientResponse& r) {
+                            response = std::move(r);
+                            h.resume();
+                        });
+                    });
+                }
+
+                ClientResponse await_resume() { return std::move(response); }
+            };
+
+            return Awaiter { client, upstream, std::move(request), {} };
+        }
+    #endif
+}
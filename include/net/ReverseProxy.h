@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "HttpClient.h"
+
+namespace mini_http {
+    struct Request;
+    class Response;
+
+    enum class Balance {
+        // Each upstream in turn.
+        ROUND_ROBIN,
+        // The upstream with the fewest requests in flight from this proxy.
+        LEAST_OUTSTANDING,
+        // The less busy of two upstreams picked at random: nearly as even
+        // as LEAST_OUTSTANDING without every request scanning every upstream.
+        TWO_CHOICES
+    };
+
+    struct ProxyOptions {
+        // Forward /api/users as /users instead of /api/users.
+        bool stripPrefix = false;
+
+        // Response bytes buffered for a slow client before reading from the
+        // upstream pauses.
+        size_t maxBufferedBytes = 256 * 1024;
+
+        Balance balance = Balance::ROUND_ROBIN;
+
+        // Other upstreams tried when one fails before answering. Only
+        // idempotent requests are retried.
+        size_t retries = 1;
+
+        // Consecutive failures (no answer, or 502/503/504) that take an
+        // upstream out of rotation for ejectTime. 0 never ejects.
+        size_t maxFails = 3;
+        std::chrono::milliseconds ejectTime { 10000 };
+
+        // Active health checks: every healthInterval, GET healthPath from
+        // each upstream. One that does not answer 2xx/3xx within
+        // healthTimeout is skipped until it does. Empty turns them off.
+        std::string healthPath;
+        std::chrono::milliseconds healthInterval { 5000 };
+        std::chrono::milliseconds healthTimeout { 1000 };
+    };
+
+    // Forwards requests to a set of upstream servers. HTTP/1.1 responses are
+    // relayed to the client as they arrive instead of being held whole;
+    // HTTP/2 streams get the collected response. Routes are added with
+    // Router::proxy().
+    class ReverseProxy {
+    public:
+        explicit ReverseProxy(std::vector<Upstream> upstreams, ProxyOptions options = {});
+
+        // Sends requests through client from now on, and starts the health
+        // checks on its event loop. App::listen() attaches its client().
+        void attach(HttpClient& client);
+
+        // Detaches res and answers it with the upstream's response, or with
+        // 502/504 when no upstream can be reached in time.
+        void forward(Request& req, Response& res);
+
+        const std::vector<Upstream>& upstreams() const { return upstreams_; }
+
+        // Requests in flight to upstreams()[index].
+        size_t outstanding(size_t index) const;
+
+        // Whether upstreams()[index] is in rotation: not ejected and, with
+        // health checks on, passing them.
+        bool available(size_t index) const;
+
+    private:
+        struct Backend {
+            std::atomic<size_t> outstanding { 0 };
+            std::atomic<size_t> fails { 0 };
+            std::atomic<int64_t> ejectedUntil { 0 };
+            std::atomic<bool> healthy { true };
+        };
+
+        class Relay;
+        struct Attempt;
+
+        std::vector<Upstream> upstreams_;
+        std::unique_ptr<Backend[]> backends;
+        ProxyOptions options;
+        HttpClient* client = nullptr;
+        std::atomic<size_t> next { 0 };
+
+        size_t pick(size_t avoid);
+        void acquire(size_t index);
+        void release(size_t index, bool failed);
+        void check();
+        void sendBuffered(const std::shared_ptr<Attempt>& attempt);
+
+        ClientRequest upstreamRequest(Request& req, Response& res) const;
+    };
+}
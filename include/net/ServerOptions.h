@@ -0,0 +1,39 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+namespace mini_http {
+    // Listener and per-connection socket tuning. Zero leaves the kernel
+    // default in place; options the platform lacks are ignored.
+    struct ServerOptions {
+        int backlog = 128;
+
+        // Listener
+        int deferAccept = 0;        // TCP_DEFER_ACCEPT, seconds to wait for the first data
+        int fastOpen = 0;           // TCP_FASTOPEN, pending SYN-with-data queue length
+        int receiveBuffer = 0;      // SO_RCVBUF bytes, inherited by accepted sockets
+        int sendBuffer = 0;         // SO_SNDBUF bytes, inherited by accepted sockets
+
+        // Accepted connections
+        bool noDelay = true;        // TCP_NODELAY
+        bool quickAck = false;      // TCP_QUICKACK, re-armed after every request
+        int busyPoll = 0;           // SO_BUSY_POLL, microseconds
+        std::chrono::milliseconds readTimeout { 2000 };
+
+        // Keep-alive: close after maxRequests requests (0 for no limit) or
+        // after idleTimeout without a new request.
+        size_t maxRequests = 1000;
+        std::chrono::milliseconds idleTimeout { 5000 };
+
+        // CPU placement (Linux). Workers are pinned round-robin to
+        // workerCpus and the accept thread to acceptCpu. With numaAware,
+        // each NUMA node gets its own workers and connection pool, and a
+        // connection is served on the node whose CPU received it
+        // (SO_INCOMING_CPU).
+        std::vector<int> workerCpus;
+        int acceptCpu = -1;
+        bool numaAware = false;
+    };
+}
@@ -1,10 +1,19 @@
 #pragma once
 
 #include <functional>
+#include <memory>
+#include <unordered_map>
 #include <atomic>
+#include <chrono>
+#include <mutex>
 #include <thread>
+#include <vector>
 #include "ThreadPool.h"
 #include "Connection.h"
+#include "ConnectionPool.h"
+#include "ServerOptions.h"
+#include "EventLoop.h"
+#include "core/Metrics.h"
 
 #ifdef _WIN32
     #include <winsock2.h>
@@ -20,17 +29,59 @@
 namespace mini_http {
     class TcpServer {
     public:
-        using ConnectionHandler = std::function<bool(Connection&)>;
+        // What serve() does with a connection after a request. DETACHED
+        // means the response completes later; its owner then hands the
+        // connection back through resume().
+        enum class HandlerResult { CLOSE, KEEP_ALIVE, DETACHED };
 
-        TcpServer(int port, size_t threads);
+        using ConnectionHandler = std::function<HandlerResult(Connection&)>;
+
+        TcpServer(int port, size_t threads, Metrics* metrics = nullptr,
+                const ServerOptions& options = {});
         ~TcpServer();
 
         void start(ConnectionHandler handler);
         void stop();
 
+        size_t queueDepth();
+
+        // Thread-safe. Continues or closes a connection whose handler
+        // returned DETACHED, once its response has been written. Output
+        // still queued on the connection is written first.
+        void resume(Connection* conn, bool keepAlive);
+
+        // Thread-safe. Runs task on the workers that serve conn.
+        void submit(Connection* conn, std::function<void()> task);
+
+        #ifndef _WIN32
+            // The accept thread's reactor, also used for timers and async I/O
+            // of detached responses.
+            EventLoop& eventLoop() { return loop; }
+        #endif
+
     private:
+        // Workers plus the connection pool they draw from. There is one per
+        // NUMA node with ServerOptions::numaAware, otherwise just one.
+        struct Shard {
+            ConnectionPool connections;
+            ThreadPool pool;
+
+            // Connections accepted or woken during one accept-loop pass,
+            // handed to the pool together. Accept thread only.
+            std::vector<Connection*> handoffConnections;
+            std::vector<std::function<void()>> handoffTasks;
+
+            Shard(size_t threads, std::vector<CpuSet> affinity)
+                : connections(threads * 2), pool(threads, std::move(affinity)) {}
+        };
+
         int port;
-        ThreadPool pool;
+        Metrics* metrics;
+        ServerOptions options;
+        ConnectionHandler handler;
+        std::vector<std::unique_ptr<Shard>> shards;
+        std::vector<size_t> cpuShards;
+        size_t nextShard = 0;
 
         socket_t serverSocket { INVALID_SOCK };
 
@@ -38,11 +89,55 @@ namespace mini_http {
         std::thread acceptThread;
 
         #ifndef _WIN32
-            int wakeupPipe[2] { INVALID_SOCK, INVALID_SOCK };
+            EventLoop loop;
+
+            // Keep-alive connections waiting for their next request are
+            // watched by the loop instead of holding a worker. Loop thread only.
+            std::unordered_map<Connection*, EventLoop::TimerId> idle;
+            std::mutex parkMutex;
+
+            void park(Connection* conn);
+            void watchIdle(Connection* conn);
+
+            // Connections whose response was sent from the loop and did not
+            // fit in the socket, with the deadline for the rest. Loop
+            // thread only.
+            std::unordered_map<Connection*, EventLoop::TimerId> draining;
+
+            void drain(Connection* conn, bool keepAlive);
+            void watchDrain(Connection* conn, bool keepAlive);
         #endif
 
-        void acceptLoop(ConnectionHandler handler);
+        void acceptLoop();
+        #ifdef _WIN32
+            void acceptOne();
+        #else
+            static constexpr uint64_t ACCEPT_BATCH = 64;
+            static constexpr std::chrono::milliseconds ACCEPT_BACKOFF { 100 };
+
+            // Last accept() failure written to stderr, and those since left
+            // out. Loop thread only.
+            std::chrono::steady_clock::time_point acceptErrorLogged;
+            uint64_t acceptErrorsSkipped = 0;
+
+            void watchListener();
+            void acceptBatch();
+            void pauseAccept(int error);
+        #endif
+        void createShards(size_t threads);
+        Connection* acquire(socket_t s);
+        void dispatch(Connection* conn);
+        void handOff();
+        void serve(Connection* conn);
+        void finishRequest(Connection* conn);
+        void closeConnection(Connection* conn);
         void closeSocket(socket_t s);
-        void applyReceiveTimeout(socket_t s, int seconds);
+        void configureListener();
+        void configureClient(socket_t s);
+        void applyConnectionOptions(socket_t s);
+        void rearmQuickAck(socket_t s);
+        #ifdef _WIN32
+            void applyReceiveTimeout(socket_t s, std::chrono::milliseconds timeout);
+        #endif
     };
 }
\ No newline at end of file
@@ -6,19 +6,39 @@
 #include <condition_variable>
 #include <functional>
 #include <atomic>
+#include "CpuAffinity.h"
 
 namespace mini_http {
+    // Dequeue order of a task: workers take queued HIGH tasks before any
+    // NORMAL one, and NORMAL before LOW. FIFO within a level.
+    enum class Priority { HIGH, NORMAL, LOW };
+
     class ThreadPool {
     public:
-        explicit ThreadPool(size_t threadCount);
+        // Worker i is pinned to affinity[i % affinity.size()] when given.
+        explicit ThreadPool(size_t threadCount, std::vector<CpuSet> affinity = {});
         ~ThreadPool();
 
-        void enqueue(std::function<void()> task);
+        void enqueue(std::function<void()> task, Priority priority = Priority::NORMAL);
+
+        // Queues all tasks under a single lock; tasks is left empty.
+        void enqueueBatch(std::vector<std::function<void()>>& tasks);
         void shutdown();
 
+        size_t pending();
+        size_t pending(Priority priority);
+
     private:
         std::vector<std::thread> workers;
-        std::queue<std::function<void()>> tasks;
+        static constexpr size_t PRIORITY_COUNT = 3;
+
+        // One queue per priority, all under the pool's own mutex.
+        std::queue<std::function<void()>> tasks[PRIORITY_COUNT];
+        size_t queued = 0;
+
+        std::queue<std::function<void()>>& queueOf(Priority priority) {
+            return tasks[static_cast<size_t>(priority)];
+        }
 
         std::mutex mtx;
         std::condition_variable cv;
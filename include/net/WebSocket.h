@@ -0,0 +1,129 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "EventLoop.h"
+#include "http/WebSocketFrame.h"
+
+namespace mini_http {
+    struct Request;
+    class Response;
+    class WebSocket;
+
+    // Callbacks of a WebSocket endpoint. All of them run on the server's
+    // event loop, so they must not block.
+    struct WebSocketHandlers {
+        std::function<void(WebSocket&)> open;
+        std::function<void(WebSocket&, std::string_view message, bool binary)> message;
+        std::function<void(WebSocket&, uint16_t code)> close;
+
+        size_t maxMessageSize = 1024 * 1024;
+
+        // Unsent bytes a slow client may fall behind by before it is dropped.
+        size_t maxBufferedBytes = 4 * 1024 * 1024;
+    };
+
+    class WebSocketHub;
+
+    // One upgraded connection. Owned by its hub until closed.
+    class WebSocket : public std::enable_shared_from_this<WebSocket> {
+    public:
+        using Params = std::unordered_map<std::string, std::string>;
+
+        WebSocket(WebSocketHub& hub, Connection& conn, Params params,
+                std::function<void(Connection*)> release);
+
+        // Thread-safe.
+        void send(std::string_view message, bool binary = false);
+        void close(uint16_t code = WebSocketClose::NORMAL, std::string_view reason = {});
+
+        // Route parameters of the upgrade request.
+        const Params& params() const { return params_; }
+
+        // Free for the application, e.g. session state set in open.
+        std::shared_ptr<void> data;
+
+    private:
+        friend class WebSocketHub;
+        using Frame = Connection::Buffer;
+
+        WebSocketHub& hub;
+        Connection& conn;
+        EventLoop& loop;
+        Params params_;
+        std::function<void(Connection*)> release;
+
+        // Everything below is touched on the loop thread only.
+        size_t index = 0;
+
+        std::string message;
+        WebSocketOpcode messageOpcode = WebSocketOpcode::TEXT;
+        bool inMessage = false;
+
+        // Frames are shared, so a broadcast queues the same bytes everywhere.
+
+        bool watchingWritable = false;
+        bool closeSent = false;
+        bool closed = false;
+
+        // Set once the connection is ending but frames, the close frame
+        // last, are still queued; closeCode is reported when they are out.
+        bool draining = false;
+        uint16_t closeCode = WebSocketClose::ABNORMAL;
+
+        void start();
+        void onReady();
+        void readAvailable();
+        void process();
+        void handle(const WebSocketFrame& frame);
+        void deliver(std::string_view payload, bool binary);
+        void enqueue(Frame frame);
+        void flush();
+        void watch(bool writable);
+        void sendClose(uint16_t code, std::string_view reason);
+        void fail(uint16_t code, std::string_view reason);
+        void finish(uint16_t code);
+        void terminate(uint16_t code);
+    };
+
+    // The sockets of one app.ws() endpoint.
+    class WebSocketHub {
+    public:
+        explicit WebSocketHub(WebSocketHandlers handlers);
+
+        // Thread-safe. Frames the message once and queues those bytes to
+        // every open socket. Broadcasts issued together are flushed with a
+        // single write per socket.
+        void broadcast(std::string_view message, bool binary = false);
+
+        size_t connections() const { return count.load(); }
+
+        // Answers a handshake request with 101 and takes the connection
+        // over, or with 400 if it is not a valid upgrade.
+        void upgrade(Request& req, Response& res,
+                    std::function<void(Connection*)> release);
+
+    private:
+        friend class WebSocket;
+
+        WebSocketHandlers handlers;
+        std::atomic<EventLoop*> loop { nullptr };
+        std::atomic<size_t> count { 0 };
+
+        // Loop thread only.
+        std::vector<std::shared_ptr<WebSocket>> sockets;
+        bool flushScheduled = false;
+
+        void add(const std::shared_ptr<WebSocket>& socket);
+        void remove(WebSocket& socket);
+        void flushAll();
+
+        static WebSocket::Frame frame(WebSocketOpcode opcode, std::string_view payload);
+    };
+}
@@ -0,0 +1,167 @@
+#include "core/AccessLog.h"
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+
+namespace mini_http {
+    static std::atomic<uint64_t> nextInstance { 1 };
+
+    static size_t roundUpPow2(size_t value) {
+        size_t result = 1;
+        while (result < value) result <<= 1;
+        return result;
+    }
+
+    AccessLog::Ring::Ring(size_t capacity)
+        : slots(capacity),
+        mask(capacity - 1)
+    {
+    }
+
+    AccessLog::AccessLog(std::ostream& out, size_t ringCapacity)
+        : out(out),
+        ringCapacity(roundUpPow2(ringCapacity ? ringCapacity : 1)),
+        instance(nextInstance.fetch_add(1))
+    {
+    }
+
+    AccessLog::~AccessLog() {
+        stop();
+    }
+
+    void AccessLog::start() {
+        if (running.exchange(true)) return;
+        writer = std::thread(&AccessLog::writeLoop, this);
+    }
+
+    void AccessLog::stop() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (!running.exchange(false)) return;
+        }
+        cv.notify_all();
+
+        if (writer.joinable())
+            writer.join();
+    }
+
+    AccessLog::Ring& AccessLog::local() {
+        struct Slot {
+            uint64_t owner;
+            Ring* ring;
+        };
+        thread_local std::vector<Slot> slots;
+
+        for (const auto& slot : slots) {
+            if (slot.owner == instance) return *slot.ring;
+        }
+
+        std::lock_guard<std::mutex> lock(mtx);
+        rings.push_back(std::make_unique<Ring>(ringCapacity));
+        slots.push_back({instance, rings.back().get()});
+        return *rings.back();
+    }
+
+    void AccessLog::record(const AccessRecord& record) {
+        Ring& ring = local();
+
+        size_t head = ring.head.load(std::memory_order_relaxed);
+        size_t tail = ring.tail.load(std::memory_order_acquire);
+
+        if (head - tail >= ring.slots.size()) {
+            ring.dropped.store(ring.dropped.load(std::memory_order_relaxed) + 1,
+                            std::memory_order_relaxed);
+            return;
+        }
+
+        ring.slots[head & ring.mask] = record;
+        ring.head.store(head + 1, std::memory_order_release);
+    }
+
+    void AccessLog::setRoutes(std::vector<std::string> labels) {
+        std::lock_guard<std::mutex> lock(mtx);
+        routes = std::move(labels);
+    }
+
+    uint64_t AccessLog::dropped() const {
+        std::lock_guard<std::mutex> lock(mtx);
+
+        uint64_t total = 0;
+        for (const auto& ring : rings)
+            total += ring->dropped.load(std::memory_order_relaxed);
+        return total;
+    }
+
+    void AccessLog::writeLoop() {
+        std::string batch;
+
+        while (true) {
+            bool stopping;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                cv.wait_for(lock, std::chrono::milliseconds(100),
+                            [this] { return !running.load(); });
+                stopping = !running.load();
+            }
+
+            batch.clear();
+            if (drain(batch) > 0) {
+                out.write(batch.data(), static_cast<std::streamsize>(batch.size()));
+                out.flush();
+            }
+
+            if (stopping) break;
+        }
+    }
+
+    size_t AccessLog::drain(std::string& batch) {
+        std::lock_guard<std::mutex> lock(mtx);
+
+        size_t count = 0;
+        for (auto& ring : rings) {
+            size_t tail = ring->tail.load(std::memory_order_relaxed);
+            size_t head = ring->head.load(std::memory_order_acquire);
+
+            for (; tail != head; ++tail, ++count)
+                format(ring->slots[tail & ring->mask], batch);
+
+            ring->tail.store(tail, std::memory_order_release);
+        }
+
+        return count;
+    }
+
+    void AccessLog::format(const AccessRecord& record, std::string& line) const {
+        std::time_t seconds = static_cast<std::time_t>(record.timestamp / 1000000000);
+        int millis = static_cast<int>((record.timestamp / 1000000) % 1000);
+
+        std::tm tm{};
+        #ifdef _WIN32
+            gmtime_s(&tm, &seconds);
+        #else
+            gmtime_r(&seconds, &tm);
+        #endif
+
+        char stamp[64];
+        std::snprintf(stamp, sizeof(stamp), "%04d-%02d-%02dT%02d:%02d:%02d.%03dZ",
+                    tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+                    tm.tm_hour, tm.tm_min, tm.tm_sec, millis);
+
+        line.append(stamp);
+        line.push_back(' ');
+
+        if (record.routeId > 0 && record.routeId < routes.size()) {
+            line.append(routes[record.routeId]);
+        } else {
+            line.append(methodName(record.method));
+            line.append(" -");
+        }
+
+        char tailBuffer[64];
+        std::snprintf(tailBuffer, sizeof(tailBuffer), " %u %llu %.3fms\n",
+                    static_cast<unsigned>(record.status),
+                    static_cast<unsigned long long>(record.bytes),
+                    static_cast<double>(record.latencyNanos) / 1e6);
+        line.append(tailBuffer);
+    }
+}
@@ -1,31 +1,131 @@
 #include "core/App.h"
+#include <optional>
+#include <stdexcept>
+
 namespace mini_http {
-    void App::get(const std::string& path, Handler handler) {
-        router.add(HttpMethod::GET, path, handler);
+    RouteHandle App::get(const std::string& path, Handler handler) {
+        return router.add(HttpMethod::GET, path, handler);
+    }
+
+    RouteHandle App::post(const std::string& path, Handler handler) {
+        return router.add(HttpMethod::POST, path, handler);
+    }
+
+    RouteHandle App::put(const std::string& path, Handler handler) {
+        return router.add(HttpMethod::PUT, path, handler);
+    }
+
+    RouteHandle App::del(const std::string& path, Handler handler) {
+        return router.add(HttpMethod::DELETE_, path, handler);
     }
 
-    void App::post(const std::string& path, Handler handler) {
-        router.add(HttpMethod::POST, path, handler);
+    RouteHandle App::patch(const std::string& path, Handler handler) {
+        return router.add(HttpMethod::PATCH, path, handler);
+    }
+
+    RouteHandle App::options(const std::string& path, Handler handler) {
+        return router.add(HttpMethod::OPTIONS, path, handler);
+    }
+
+    RouteHandle App::head(const std::string& path, Handler handler) {
+        return router.add(HttpMethod::HEAD, path, handler);
+    }
+
+    WebSocketHub& App::ws(const std::string& path, WebSocketHandlers handlers) {
+        webSockets.push_back(std::make_unique<WebSocketHub>(std::move(handlers)));
+        WebSocketHub* hub = webSockets.back().get();
+
+        get(path, [this, hub](Request& req, Response& res) {
+            hub->upgrade(req, res, [this](Connection* conn) {
+                server->resume(conn, false);
+            });
+        });
+
+        return *hub;
+    }
+
+    EventStreamHub& App::sse(const std::string& path, EventStreamHandlers handlers) {
+        eventStreams.push_back(std::make_unique<EventStreamHub>(std::move(handlers)));
+        EventStreamHub* hub = eventStreams.back().get();
+
+        get(path, [this, hub](Request& req, Response& res) {
+            hub->accept(req, res, [this](Connection* conn) {
+                server->resume(conn, false);
+            });
+        });
+
+        return *hub;
+    }
+
+    #ifndef _WIN32
+        void App::clientOptions(const HttpClientOptions& options) {
+            clientConfig = options;
+        }
+
+        ReverseProxy& App::proxy(const std::string& prefix, std::vector<Upstream> upstreams,
+                                ProxyOptions options)
+        {
+            ReverseProxy& reverseProxy = router.proxy(prefix, std::move(upstreams), std::move(options));
+            proxies.push_back(router.proxies().back());
+            return reverseProxy;
+        }
+    #endif
+
+    void App::getStatic(const std::string& path,
+                        HttpStatus status,
+                        const Response::Headers& headers,
+                        const std::string& body)
+    {
+        if (server)
+            throw std::runtime_error("getStatic() must be called before listen()");
+
+        staticRoutes.insert_or_assign(path, StaticRoute { PreparedResponse(status, headers, body) });
     }
 
-    void App::put(const std::string& path, Handler handler) {
-        router.add(HttpMethod::PUT, path, handler);
+    void App::getStatic(const std::string& path,
+                        HttpStatus status,
+                        const std::string& body)
+    {
+        getStatic(path, status, {}, body);
     }
 
-    void App::del(const std::string& path, Handler handler) {
-        router.add(HttpMethod::DELETE_, path, handler);
+    void App::exposeMetrics(const std::string& path) {
+        get(path, [this](Request&, Response& res) {
+            res.setHeader("Content-Type", "text/plain; version=0.0.4");
+            res.send(metrics.render());
+        });
     }
 
-    void App::patch(const std::string& path, Handler handler) {
-        router.add(HttpMethod::PATCH, path, handler);
+    RouteLatency App::latency(HttpMethod method, const std::string& path) const {
+        size_t id = metrics.routeId(std::string(methodName(method)) + " " + path);
+        if (id == 0) return {};
+
+        return {
+            metrics.latency(id, Metrics::HANDLER_LATENCY),
+            metrics.latency(id, Metrics::TOTAL_LATENCY)
+        };
     }
 
-    void App::options(const std::string& path, Handler handler) {
-        router.add(HttpMethod::OPTIONS, path, handler);
+    void App::enableAccessLog(std::ostream& out) {
+        accessLog = std::make_unique<AccessLog>(out);
     }
 
-    void App::head(const std::string& path, Handler handler) {
-        router.add(HttpMethod::HEAD, path, handler);
+    void App::logAccess(const Request& req, HttpStatus status,
+                        size_t routeId, uint64_t bytesOut,
+                        std::chrono::nanoseconds latency)
+    {
+        if (!accessLog) return;
+
+        auto now = std::chrono::system_clock::now().time_since_epoch();
+
+        accessLog->record({
+            std::chrono::duration_cast<std::chrono::nanoseconds>(now).count(),
+            bytesOut,
+            static_cast<uint64_t>(latency.count()),
+            static_cast<uint32_t>(routeId),
+            static_cast<uint16_t>(status),
+            req.method
+        });
     }
 
     void App::use(Middleware middleware) {
@@ -38,55 +138,311 @@ namespace mini_http {
             base.pop_back();
         }
 
-        for (const auto& [method, path, handler] : subrouter.getMountableRoutes()) {
+        for (const auto& [method, path, handler, options] : subrouter.getMountableRoutes()) {
             std::string fullPath = base;
             if (!path.empty() && path != "/") {
                 fullPath += path;
             }
-            router.add(method, fullPath, handler);
+            router.add(method, fullPath, handler, options);
         }
+
+        #ifndef _WIN32
+            proxies.insert(proxies.end(), subrouter.proxies().begin(), subrouter.proxies().end());
+        #endif
+    }
+
+    void App::cacheLimit(size_t maxBytes) {
+        router.cacheLimit(maxBytes);
     }
 
-    App::App(size_t threads) : count(threads) {}
+    App::App(size_t threads)
+        : count(threads),
+        handlerCount(threads),
+        notFoundResponse(HttpStatus::NOT_FOUND,
+                        {{"Content-Type", "text/plain"}},
+                        "Not Found")
+    {
+    }
+
+    void App::handlerThreads(size_t threads) {
+        handlerCount = threads;
+    }
+
+    void App::keepAlive(size_t maxRequests, std::chrono::milliseconds idleTimeout) {
+        config.maxRequests = maxRequests;
+        config.idleTimeout = idleTimeout;
+    }
+
+    void App::serverOptions(const ServerOptions& options) {
+        config = options;
+    }
+
+    void App::http2(const Http2Options& options) {
+        http2Config = options;
+    }
+
+    // Router labels by route id, then the static routes numbered after them.
+    std::vector<std::string> App::routeLabels() {
+        std::vector<std::string> labels = router.routeLabels();
+        for (auto& [path, route] : staticRoutes) {
+            route.id = labels.size();
+            labels.push_back("GET " + path);
+        }
+        return labels;
+    }
 
     void App::listen(int port) {
-        server = std::make_unique<TcpServer>(port, count);
+        std::vector<std::string> labels = routeLabels();
+        metrics.setRoutes(labels);
+        router.instrument(&metrics);
+
+        if (accessLog) {
+            accessLog->setRoutes(std::move(labels));
+            accessLog->start();
+            metrics.gauge("mini_http_access_log_dropped",
+                        "Access log records dropped because a ring was full.",
+                        [log = accessLog.get()]() {
+                            return static_cast<double>(log->dropped());
+                        });
+        }
+
+        if (router.offloads() && !handlerPool) {
+            handlerPool = std::make_unique<ThreadPool>(handlerCount);
+            router.executor(handlerPool.get());
+            metrics.gauge("mini_http_handler_queue_depth",
+                        "Offloaded requests waiting for a handler thread.",
+                        [pool = handlerPool.get()]() {
+                            return static_cast<double>(pool->pending());
+                        });
+        }
+
+        server = std::make_unique<TcpServer>(port, count, &metrics, config);
+        router.workers([server = server.get()](Connection& conn, std::function<void()> task) {
+            server->submit(&conn, std::move(task));
+        });
+        metrics.gauge("mini_http_queue_depth",
+                    "Connections waiting for an I/O worker thread.",
+                    [server = server.get()]() {
+                        return static_cast<double>(server->queueDepth());
+                    });
+        #ifndef _WIN32
+            httpClient = std::make_unique<HttpClient>(server->eventLoop(), clientConfig);
+            metrics.gauge("mini_http_upstream_connections",
+                        "Open connections to upstream servers.",
+                        [client = httpClient.get()]() {
+                            return static_cast<double>(client->connections());
+                        });
+            for (const auto& reverseProxy : proxies)
+                reverseProxy->attach(*httpClient);
+        #endif
+
         server->start([this](Connection& conn) {
             return handleClient(conn);
         });
     }
 
-    bool App::handleClient(Connection& conn) {
+    // Request and response of the connection's current exchange. Kept in
+    // the connection so a detached response outlives handleClient().
+    struct App::Exchange {
+        Request req;
+        std::optional<Response> res;
+    };
+
+    TcpServer::HandlerResult App::handleClient(Connection& conn) {
+        using Result = TcpServer::HandlerResult;
+
+        if (!conn.context)
+            conn.context = std::make_shared<Exchange>();
+        Exchange& exchange = *static_cast<Exchange*>(conn.context.get());
+        Request& req = exchange.req;
+        Response* current = nullptr;
+
         try {
-            Request req;
             try {
                 req = parseRequest(conn);
+            } catch (const ParseError& e) {
+                if (e.kind() == ParseError::Kind::MALFORMED)
+                    metrics.increment(Metrics::PARSE_ERRORS);
+                else if (e.kind() == ParseError::Kind::TIMEOUT)
+                    metrics.increment(Metrics::TIMEOUTS);
+                return Result::CLOSE;
             } catch (const std::runtime_error& e) {
-                return false;
+                metrics.increment(Metrics::PARSE_ERRORS);
+                return Result::CLOSE;
             }
 
-            Response res(conn.raw());
+            #ifndef _WIN32
+                if (req.version == "HTTP/2.0")
+                    return http2Config.enabled ? startHttp2(conn, nullptr) : Result::CLOSE;
+
+                if (http2Config.enabled && req.hasToken("upgrade", "h2c")
+                    && req.hasToken("connection", "http2-settings")
+                    && req.headers.count("http2-settings"))
+                    return startHttp2(conn, &req);
+            #endif
 
-            middlewareChain.execute(req, res, [&]() {
-                if (!router.dispatch(req, res)) {
-                    res.setStatus(HttpStatus::NOT_FOUND);
-                    res.send("Not Found");
+            bool keepAlive = conn.allowKeepAlive && req.keepAlive();
+
+            if (req.method == HttpMethod::GET && !staticRoutes.empty()) {
+                auto it = staticRoutes.find(req.path);
+                if (it != staticRoutes.end()) {
+                    const PreparedResponse& prepared = it->second.response;
+                    keepAlive = keepAlive && !prepared.closesConnection();
+
+                    prepared.queueTo(conn, keepAlive);
+                    if (!conn.flush())
+                        return Result::CLOSE;
+
+                    record(req, it->second, conn.bytesOut);
+                    return keepAlive ? Result::KEEP_ALIVE : Result::CLOSE;
                 }
-            });
+            }
+
+            Response& res = exchange.res.emplace(conn);
+            res.keepAlive(keepAlive);
+            current = &res;
+
+            route(req, res);
 
-            return req.keepAlive();
+            if (res.detached() && res.handOff([this, &conn]() {
+                    server->resume(&conn, finish(conn));
+                }))
+                return Result::DETACHED;
+
+            bool reuse = finish(conn);
+
+            // The connection now belongs to whatever took it over.
+            if (res.upgraded()) {
+                res.takeover_(conn);
+                return Result::DETACHED;
+            }
+
+            return reuse ? Result::KEEP_ALIVE : Result::CLOSE;
 
         } catch (const std::exception& e) {
+            metrics.increment(Metrics::HANDLER_ERRORS);
+
+            // A handler that deferred its response before throwing still
+            // owns the connection: it is closed once the response completes,
+            // not handed to the next request while a late send is pending.
+            if (current && current->detached()) {
+                if (current->handOff([this, &conn]() {
+                        finish(conn);
+                        server->resume(&conn, false);
+                    }))
+                    return Result::DETACHED;
+
+                if (current->isSent()) {
+                    finish(conn);
+                    return Result::CLOSE;
+                }
+            }
+
+            metrics.recordRequest(0, HttpStatus::INTERNAL_SERVER_ERROR);
             try {
-                Response res(conn.raw());
+                Response res(conn);
                 res.setStatus(HttpStatus::INTERNAL_SERVER_ERROR);
                 res.send("Internal Server Error");
             } catch (...) {
             }
-            return false;
+            return Result::CLOSE;
         }
     }
 
+    void App::route(Request& req, Response& res) {
+        middlewareChain.execute(req, res, [&]() {
+            if (!router.dispatch(req, res))
+                res.sendPrepared(notFoundResponse);
+        });
+    }
+
+    // Records a routed request once its response is out, and reports
+    // whether the connection stays open.
+    bool App::finish(Connection& conn) {
+        Exchange& exchange = *static_cast<Exchange*>(conn.context.get());
+        const Response& res = *exchange.res;
+
+        record(exchange.req, res);
+        return res.isSent() && res.keepAlive();
+    }
+
+    void App::record(const Request& req, const Response& res) {
+        size_t routeId = req.route ? req.route->id : 0;
+        auto elapsed = std::chrono::steady_clock::now() - req.received;
+
+        metrics.recordRequest(routeId, res.status());
+        metrics.recordLatency(routeId, Metrics::TOTAL_LATENCY, elapsed);
+        logAccess(req, res.status(), routeId, res.bytesOut(), elapsed);
+    }
+
+    void App::record(const Request& req, const StaticRoute& route, uint64_t bytesOut) {
+        auto elapsed = std::chrono::steady_clock::now() - req.received;
+
+        metrics.increment(Metrics::STATIC_HITS);
+        metrics.recordRequest(route.id, route.response.status());
+        metrics.recordLatency(route.id, Metrics::TOTAL_LATENCY, elapsed);
+        logAccess(req, route.response.status(), route.id, bytesOut, elapsed);
+    }
+
+    #ifndef _WIN32
+        // The connection leaves the HTTP/1 request loop for good; the server
+        // gets it back through resume() once the session ends.
+        TcpServer::HandlerResult App::startHttp2(Connection& conn, Request* upgrade) {
+            auto session = std::make_shared<Http2Session>(
+                conn, http2Config, config.idleTimeout,
+                [this, &conn](std::function<void()> task) { server->submit(&conn, std::move(task)); },
+                [this](Request& req, Response& res, std::function<void()> done) {
+                    serveStream(req, res, std::move(done));
+                },
+                [this](Connection* released) { server->resume(released, false); });
+
+            if (!upgrade) {
+                session->start();
+                return TcpServer::HandlerResult::DETACHED;
+            }
+
+            static constexpr std::string_view SWITCHING =
+                "HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\nUpgrade: h2c\r\n\r\n";
+            if (!conn.writeAll(SWITCHING.data(), SWITCHING.size()))
+                return TcpServer::HandlerResult::CLOSE;
+
+            std::string settings = upgrade->headers["http2-settings"];
+            session->start(std::move(*upgrade), settings);
+            return TcpServer::HandlerResult::DETACHED;
+        }
+
+        // One HTTP/2 stream, run on a worker: the same path as an HTTP/1
+        // request, except that the response is framed by the session.
+        void App::serveStream(Request& req, Response& res, std::function<void()> done) {
+            if (req.method == HttpMethod::GET && !staticRoutes.empty()) {
+                auto it = staticRoutes.find(req.path);
+                if (it != staticRoutes.end()) {
+                    res.sendPrepared(it->second.response);
+                    record(req, it->second, res.bytesOut());
+                    done();
+                    return;
+                }
+            }
+
+            auto finished = [this, &req, &res, done = std::move(done)]() {
+                record(req, res);
+                done();
+            };
+
+            try {
+                route(req, res);
+            } catch (const std::exception& e) {
+                metrics.increment(Metrics::HANDLER_ERRORS);
+                if (!res.isSent())
+                    res.internalServerError();
+            }
+
+            if (res.detached() && res.handOff(finished))
+                return;
+            finished();
+        }
+    #endif
+
     void App::signalHandler(int signal) {
         if (signal == SIGINT || signal == SIGTERM) {
             shutdownRequested.store(true);
@@ -104,6 +460,17 @@ namespace mini_http {
         shutdownCv.wait(lock, [] { return shutdownRequested.load(); });
 
         std::cout << "\nShutting down...\n";
-        server->stop();
+        stop();
+    }
+
+    void App::stop() {
+        if (server)
+            server->stop();
+
+        if (handlerPool)
+            handlerPool->shutdown();
+
+        if (accessLog)
+            accessLog->stop();
     }
 }
\ No newline at end of file
@@ -0,0 +1,88 @@
+#include "core/LatencyHistogram.h"
+
+#ifdef _MSC_VER
+    #include <intrin.h>
+#endif
+
+namespace mini_http {
+    static unsigned highestBit(uint64_t value) {
+        #if defined(__GNUC__) || defined(__clang__)
+            return 63u - static_cast<unsigned>(__builtin_clzll(value));
+        #elif defined(_MSC_VER)
+            unsigned long index;
+            _BitScanReverse64(&index, value);
+            return static_cast<unsigned>(index);
+        #else
+            unsigned bit = 0;
+            while (value >>= 1) ++bit;
+            return bit;
+        #endif
+    }
+
+    LatencyHistogram::LatencyHistogram() : sum(0) {
+        for (auto& count : counts)
+            count.store(0, std::memory_order_relaxed);
+    }
+
+    size_t LatencyHistogram::bucketIndex(uint64_t nanos) {
+        constexpr uint64_t maxValue = (1ull << MAX_VALUE_BITS) - 1;
+        if (nanos > maxValue) nanos = maxValue;
+        if (nanos < SUB_BUCKETS) return static_cast<size_t>(nanos);
+
+        unsigned shift = highestBit(nanos) - SUB_BUCKET_BITS;
+        return static_cast<size_t>(shift * SUB_BUCKETS + (nanos >> shift));
+    }
+
+    uint64_t LatencyHistogram::bucketValue(size_t index) {
+        if (index < 2 * SUB_BUCKETS) return index;
+
+        uint64_t shift = index / SUB_BUCKETS - 1;
+        uint64_t mantissa = index - shift * SUB_BUCKETS;
+        return (mantissa << shift) + (1ull << shift) - 1;
+    }
+
+    void LatencyHistogram::record(uint64_t nanos) {
+        auto& cell = counts[bucketIndex(nanos)];
+        cell.store(cell.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        sum.store(sum.load(std::memory_order_relaxed) + nanos, std::memory_order_relaxed);
+    }
+
+    void LatencyHistogram::mergeInto(std::vector<uint64_t>& out, uint64_t& sumNanos) const {
+        out.resize(BUCKET_COUNT, 0);
+        for (size_t i = 0; i < BUCKET_COUNT; ++i)
+            out[i] += counts[i].load(std::memory_order_relaxed);
+        sumNanos += sum.load(std::memory_order_relaxed);
+    }
+
+    double LatencyHistogram::percentile(const std::vector<uint64_t>& counts,
+                                        uint64_t total, double quantile)
+    {
+        if (total == 0) return 0;
+
+        uint64_t rank = static_cast<uint64_t>(quantile * static_cast<double>(total) + 0.5);
+        if (rank == 0) rank = 1;
+
+        uint64_t seen = 0;
+        for (size_t i = 0; i < counts.size(); ++i) {
+            seen += counts[i];
+            if (seen >= rank)
+                return static_cast<double>(bucketValue(i)) / 1e9;
+        }
+
+        return static_cast<double>(bucketValue(counts.size() - 1)) / 1e9;
+    }
+
+    LatencySnapshot LatencyHistogram::summarize(const std::vector<uint64_t>& counts,
+                                                uint64_t sumNanos)
+    {
+        LatencySnapshot snapshot;
+        for (uint64_t c : counts) snapshot.count += c;
+
+        snapshot.sum = static_cast<double>(sumNanos) / 1e9;
+        snapshot.p50 = percentile(counts, snapshot.count, 0.50);
+        snapshot.p90 = percentile(counts, snapshot.count, 0.90);
+        snapshot.p99 = percentile(counts, snapshot.count, 0.99);
+        snapshot.p999 = percentile(counts, snapshot.count, 0.999);
+        return snapshot;
+    }
+}
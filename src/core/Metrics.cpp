@@ -0,0 +1,296 @@
+#include "core/Metrics.h"
+#include <algorithm>
+#include <cstdio>
+#include <utility>
+
+namespace mini_http {
+    static std::atomic<uint64_t> nextInstance { 1 };
+
+    static void bump(std::atomic<uint64_t>& cell, uint64_t amount) {
+        cell.store(cell.load(std::memory_order_relaxed) + amount,
+                std::memory_order_relaxed);
+    }
+
+    static std::string escapeLabel(const std::string& value) {
+        std::string out;
+        out.reserve(value.size());
+        for (char c : value) {
+            if (c == '\\' || c == '"') out.push_back('\\');
+            if (c == '\n') { out.append("\\n"); continue; }
+            out.push_back(c);
+        }
+        return out;
+    }
+
+    static size_t statusSlot(HttpStatus status) {
+        size_t index = statusIndex(status);
+        if (index < HTTP_STATUS_COUNT) return index;
+
+        int code = static_cast<int>(status);
+        if (code >= 100 && code <= 599)
+            return HTTP_STATUS_COUNT + static_cast<size_t>(code / 100 - 1);
+        return HTTP_STATUS_COUNT + 5;
+    }
+
+    static std::string statusLabel(size_t slot) {
+        if (slot < HTTP_STATUS_COUNT)
+            return std::to_string(static_cast<int>(HTTP_STATUSES[slot]));
+        if (slot < HTTP_STATUS_COUNT + 5)
+            return std::to_string(slot - HTTP_STATUS_COUNT + 1) + "xx";
+        return "other";
+    }
+
+    static std::string formatValue(double value) {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%.9g", value);
+        return buffer;
+    }
+
+    static void writeHeader(std::string& out, const char* name,
+                            const char* help, const char* type)
+    {
+        out.append("# HELP ").append(name).append(" ").append(help).append("\n");
+        out.append("# TYPE ").append(name).append(" ").append(type).append("\n");
+    }
+
+    Metrics::Shard::~Shard() {
+        if (!latencies) return;
+        for (size_t i = 0; i < routeSlots * LATENCY_COUNT; ++i)
+            delete latencies[i].load(std::memory_order_relaxed);
+    }
+
+    Metrics::Metrics()
+        : instance(nextInstance.fetch_add(1))
+    {
+        routes.push_back("unmatched");
+    }
+
+    Metrics::Shard& Metrics::local() {
+        struct Slot {
+            uint64_t owner;
+            Shard* shard;
+        };
+        thread_local std::vector<Slot> slots;
+
+        for (const auto& slot : slots) {
+            if (slot.owner == instance) return *slot.shard;
+        }
+
+        Shard& shard = registerShard();
+        slots.push_back({instance, &shard});
+        return shard;
+    }
+
+    Metrics::Shard& Metrics::registerShard() {
+        std::lock_guard<std::mutex> lock(mtx);
+
+        auto shard = std::make_unique<Shard>();
+        shard->routeSlots = routes.size();
+        shard->requests.reset(
+            new std::atomic<uint64_t>[shard->routeSlots * STATUS_SLOTS]);
+
+        for (size_t i = 0; i < shard->routeSlots * STATUS_SLOTS; ++i)
+            shard->requests[i].store(0, std::memory_order_relaxed);
+
+        shard->latencies.reset(
+            new std::atomic<LatencyHistogram*>[shard->routeSlots * LATENCY_COUNT]);
+
+        for (size_t i = 0; i < shard->routeSlots * LATENCY_COUNT; ++i)
+            shard->latencies[i].store(nullptr, std::memory_order_relaxed);
+
+        shards.push_back(std::move(shard));
+        return *shards.back();
+    }
+
+    void Metrics::increment(Counter counter, uint64_t amount) {
+        bump(local().counters[counter], amount);
+    }
+
+    void Metrics::recordRequest(size_t routeId, HttpStatus status) {
+        Shard& shard = local();
+
+        if (routeId >= shard.routeSlots) routeId = 0;
+
+        bump(shard.requests[routeId * STATUS_SLOTS + statusSlot(status)], 1);
+    }
+
+    void Metrics::recordLatency(size_t routeId, Latency kind,
+                                std::chrono::nanoseconds elapsed)
+    {
+        Shard& shard = local();
+        if (routeId >= shard.routeSlots) routeId = 0;
+
+        auto& slot = shard.latencies[routeId * LATENCY_COUNT + kind];
+        LatencyHistogram* histogram = slot.load(std::memory_order_relaxed);
+
+        if (!histogram) {
+            histogram = new LatencyHistogram();
+            slot.store(histogram, std::memory_order_release);
+        }
+
+        histogram->record(elapsed.count() > 0 ? static_cast<uint64_t>(elapsed.count()) : 0);
+    }
+
+    void Metrics::setRoutes(std::vector<std::string> labels) {
+        std::lock_guard<std::mutex> lock(mtx);
+
+        if (labels.empty()) labels.push_back("unmatched");
+        else labels[0] = "unmatched";
+
+        routes = std::move(labels);
+    }
+
+    void Metrics::gauge(const std::string& name,
+                        const std::string& help,
+                        std::function<double()> read)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        gauges.push_back({name, help, std::move(read)});
+    }
+
+    uint64_t Metrics::total(Counter counter) const {
+        std::lock_guard<std::mutex> lock(mtx);
+
+        uint64_t sum = 0;
+        for (const auto& shard : shards)
+            sum += shard->counters[counter].load(std::memory_order_relaxed);
+        return sum;
+    }
+
+    LatencySnapshot Metrics::mergeLatency(size_t routeId, Latency kind) const {
+        std::vector<uint64_t> counts(LatencyHistogram::BUCKET_COUNT, 0);
+        uint64_t sumNanos = 0;
+
+        for (const auto& shard : shards) {
+            if (routeId >= shard->routeSlots) continue;
+
+            const LatencyHistogram* histogram =
+                shard->latencies[routeId * LATENCY_COUNT + kind].load(std::memory_order_acquire);
+            if (histogram)
+                histogram->mergeInto(counts, sumNanos);
+        }
+
+        return LatencyHistogram::summarize(counts, sumNanos);
+    }
+
+    LatencySnapshot Metrics::latency(size_t routeId, Latency kind) const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return mergeLatency(routeId, kind);
+    }
+
+    size_t Metrics::routeId(const std::string& label) const {
+        std::lock_guard<std::mutex> lock(mtx);
+        for (size_t i = 1; i < routes.size(); ++i) {
+            if (routes[i] == label) return i;
+        }
+        return 0;
+    }
+
+    std::string Metrics::render() const {
+        static const struct {
+            Counter counter;
+            const char* name;
+            const char* help;
+        } counterInfo[] = {
+            { ACCEPTED_CONNECTIONS, "mini_http_connections_accepted_total", "Accepted TCP connections." },
+            { CLOSED_CONNECTIONS, "mini_http_connections_closed_total", "Closed TCP connections." },
+            { ACCEPT_ERRORS, "mini_http_accept_errors_total", "Failed accept() calls." },
+            { BYTES_IN, "mini_http_bytes_received_total", "Bytes read from clients." },
+            { BYTES_OUT, "mini_http_bytes_sent_total", "Bytes written to clients." },
+            { PARSE_ERRORS, "mini_http_parse_errors_total", "Requests rejected by the parser." },
+            { TIMEOUTS, "mini_http_timeouts_total", "Connections closed on a read timeout." },
+            { HANDLER_ERRORS, "mini_http_handler_errors_total", "Requests that ended in an exception." },
+            { STATIC_HITS, "mini_http_static_hits_total", "Requests answered by a static response." },
+            { DEADLINE_DROPS, "mini_http_deadline_drops_total", "Requests answered 503 because their deadline passed before the handler ran." },
+            { COALESCED, "mini_http_coalesced_requests_total", "Requests answered with the response of an identical request already in flight." },
+        };
+
+        std::lock_guard<std::mutex> lock(mtx);
+
+        uint64_t totals[COUNTER_COUNT] = {};
+        for (const auto& shard : shards) {
+            for (size_t c = 0; c < COUNTER_COUNT; ++c)
+                totals[c] += shard->counters[c].load(std::memory_order_relaxed);
+        }
+
+        std::string out;
+
+        for (const auto& info : counterInfo) {
+            writeHeader(out, info.name, info.help, "counter");
+            out.append(info.name).append(" ")
+               .append(std::to_string(totals[info.counter])).append("\n");
+        }
+
+        uint64_t active = totals[ACCEPTED_CONNECTIONS] >= totals[CLOSED_CONNECTIONS]
+            ? totals[ACCEPTED_CONNECTIONS] - totals[CLOSED_CONNECTIONS] : 0;
+        writeHeader(out, "mini_http_connections_active", "Open client connections.", "gauge");
+        out.append("mini_http_connections_active ").append(std::to_string(active)).append("\n");
+
+        for (const auto& g : gauges) {
+            writeHeader(out, g.name.c_str(), g.help.c_str(), "gauge");
+            out.append(g.name).append(" ").append(formatValue(g.read())).append("\n");
+        }
+
+        std::vector<uint64_t> requests(routes.size() * STATUS_SLOTS, 0);
+        for (const auto& shard : shards) {
+            size_t slots = std::min(shard->routeSlots, routes.size());
+            for (size_t i = 0; i < slots * STATUS_SLOTS; ++i)
+                requests[i] += shard->requests[i].load(std::memory_order_relaxed);
+        }
+
+        writeHeader(out, "mini_http_requests_total", "Requests served, by route and status.", "counter");
+        for (size_t route = 0; route < routes.size(); ++route) {
+            for (size_t s = 0; s < STATUS_SLOTS; ++s) {
+                uint64_t value = requests[route * STATUS_SLOTS + s];
+                if (value == 0) continue;
+
+                out.append("mini_http_requests_total{route=\"")
+                   .append(escapeLabel(routes[route]))
+                   .append("\",status=\"")
+                   .append(statusLabel(s))
+                   .append("\"} ")
+                   .append(std::to_string(value))
+                   .append("\n");
+            }
+        }
+
+        static const struct {
+            Latency kind;
+            const char* name;
+            const char* help;
+        } latencyInfo[] = {
+            { HANDLER_LATENCY, "mini_http_handler_duration_seconds", "Time spent in the route handler." },
+            { TOTAL_LATENCY, "mini_http_request_duration_seconds", "Time from the first request byte read to the last response byte sent." },
+        };
+
+        for (const auto& info : latencyInfo) {
+            writeHeader(out, info.name, info.help, "summary");
+
+            for (size_t route = 0; route < routes.size(); ++route) {
+                LatencySnapshot snapshot = mergeLatency(route, info.kind);
+                if (snapshot.count == 0) continue;
+
+                std::string label = "route=\"" + escapeLabel(routes[route]) + "\"";
+                const std::pair<const char*, double> quantiles[] = {
+                    { "0.5", snapshot.p50 },
+                    { "0.9", snapshot.p90 },
+                    { "0.99", snapshot.p99 },
+                    { "0.999", snapshot.p999 },
+                };
+
+                for (const auto& [quantile, value] : quantiles) {
+                    out.append(info.name).append("{").append(label)
+                       .append(",quantile=\"").append(quantile).append("\"} ")
+                       .append(formatValue(value)).append("\n");
+                }
+
+                out.append(info.name).append("_sum{").append(label).append("} ")
+                   .append(formatValue(snapshot.sum)).append("\n");
+                out.append(info.name).append("_count{").append(label).append("} ")
+                   .append(std::to_string(snapshot.count)).append("\n");
+            }
+        }
+
+        return out;
+    }
+}
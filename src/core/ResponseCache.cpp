@@ -0,0 +1,70 @@
+#include "core/ResponseCache.h"
+
+namespace mini_http {
+    ResponseCache::ResponseCache(size_t maxBytes, size_t shardCount)
+        : shardLimit(maxBytes / (shardCount ? shardCount : 1))
+    {
+        if (shardCount == 0) shardCount = 1;
+
+        shards.reserve(shardCount);
+        for (size_t i = 0; i < shardCount; ++i)
+            shards.push_back(std::make_unique<Shard>());
+    }
+
+    void ResponseCache::setLimit(size_t maxBytes) {
+        shardLimit.store(maxBytes / shards.size());
+    }
+
+    ResponseCache::Shard& ResponseCache::shardFor(const std::string& key) {
+        return *shards[std::hash<std::string>{}(key) % shards.size()];
+    }
+
+    ResponseCache::Entry ResponseCache::get(const std::string& key) {
+        Shard& shard = shardFor(key);
+        std::lock_guard<std::mutex> lock(shard.mtx);
+
+        auto it = shard.index.find(key);
+        if (it == shard.index.end())
+            return nullptr;
+
+        if (it->second->expires <= Clock::now()) {
+            evict(shard, it->second);
+            return nullptr;
+        }
+
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        return it->second->entry;
+    }
+
+    void ResponseCache::put(const std::string& key, Entry entry, std::chrono::milliseconds ttl) {
+        Shard& shard = shardFor(key);
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        store(shard, key, std::move(entry), ttl);
+    }
+
+    void ResponseCache::store(Shard& shard, const std::string& key,
+                            Entry entry, std::chrono::milliseconds ttl)
+    {
+        size_t size = key.size() + entry->bytes().size();
+        size_t limit = shardLimit.load();
+
+        if (size > limit) return;
+
+        auto existing = shard.index.find(key);
+        if (existing != shard.index.end())
+            evict(shard, existing->second);
+
+        while (shard.bytes + size > limit && !shard.lru.empty())
+            evict(shard, std::prev(shard.lru.end()));
+
+        shard.lru.push_front({key, std::move(entry), Clock::now() + ttl, size});
+        shard.index[key] = shard.lru.begin();
+        shard.bytes += size;
+    }
+
+    void ResponseCache::evict(Shard& shard, std::list<Item>::iterator it) {
+        shard.bytes -= it->size;
+        shard.index.erase(it->key);
+        shard.lru.erase(it);
+    }
+}
@@ -1,43 +1,122 @@
 #include "core/Router.h"
 #include "http/Request.h"
 #include "http/Response.h"
+#include <algorithm>
+#include <cctype>
+#include <string_view>
 
 namespace mini_http {
-    void Router::add(HttpMethod method,
+    RouteHandle& RouteHandle::cache(std::chrono::milliseconds ttl,
+                                    std::vector<std::string> vary)
+    {
+        for (auto& name : vary)
+            std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+
+        route.options.cacheTtl = ttl;
+        route.options.vary = std::move(vary);
+        router.enableCache();
+        return *this;
+    }
+
+    RouteHandle& RouteHandle::coalesce(std::vector<std::string> vary) {
+        for (auto& name : vary)
+            std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+
+        route.options.coalesce = true;
+        if (!vary.empty())
+            route.options.vary = std::move(vary);
+        router.enableCoalescing();
+        return *this;
+    }
+
+    RouteHandle& RouteHandle::offload() {
+        route.options.offload = true;
+        return *this;
+    }
+
+    RouteHandle& RouteHandle::priority(Priority priority) {
+        route.options.priority = priority;
+        return *this;
+    }
+
+    RouteHandle& RouteHandle::deadline(std::chrono::milliseconds budget) {
+        route.options.deadline = budget;
+        return *this;
+    }
+
+    RouteHandle Router::add(HttpMethod method,
                     const std::string& path,
-                    Handler handler)
+                    Handler handler,
+                    RouteOptions options)
     {
-        routes[method].push_back(
+        auto& list = routes[method];
+        list.push_back(
             buildRoute(path, std::move(handler))
         );
+
+        Route& route = list.back();
+        route.id = nextRouteId_++;
+        route.options = std::move(options);
+        if (route.options.cacheTtl.count() > 0)
+            enableCache();
+        if (route.options.coalesce)
+            enableCoalescing();
+
+        return RouteHandle(*this, route);
     }
 
-    void Router::get(const std::string& path, Handler handler) {
-        add(HttpMethod::GET, path, std::move(handler));
+    #ifndef _WIN32
+        ReverseProxy& Router::proxy(const std::string& prefix, std::vector<Upstream> upstreams,
+                                    ProxyOptions options)
+        {
+            std::string base = prefix;
+            if (!base.empty() && base.back() == '/')
+                base.pop_back();
+
+            auto reverseProxy = std::make_shared<ReverseProxy>(std::move(upstreams), std::move(options));
+            Handler handler = [reverseProxy](Request& req, Response& res) {
+                reverseProxy->forward(req, res);
+            };
+
+            for (HttpMethod method : { HttpMethod::GET, HttpMethod::POST, HttpMethod::PUT,
+                                       HttpMethod::DELETE_, HttpMethod::PATCH,
+                                       HttpMethod::OPTIONS, HttpMethod::HEAD }) {
+                if (!base.empty())
+                    add(method, base, handler);
+                add(method, base + "/*", handler);
+            }
+
+            proxies_.push_back(reverseProxy);
+            return *reverseProxy;
+        }
+    #endif
+
+    RouteHandle Router::get(const std::string& path, Handler handler) {
+        return add(HttpMethod::GET, path, std::move(handler));
     }
 
-    void Router::post(const std::string& path, Handler handler) {
-        add(HttpMethod::POST, path, std::move(handler));
+    RouteHandle Router::post(const std::string& path, Handler handler) {
+        return add(HttpMethod::POST, path, std::move(handler));
     }
 
-    void Router::put(const std::string& path, Handler handler) {
-        add(HttpMethod::PUT, path, std::move(handler));
+    RouteHandle Router::put(const std::string& path, Handler handler) {
+        return add(HttpMethod::PUT, path, std::move(handler));
     }
 
-    void Router::del(const std::string& path, Handler handler) {
-        add(HttpMethod::DELETE_, path, std::move(handler));
+    RouteHandle Router::del(const std::string& path, Handler handler) {
+        return add(HttpMethod::DELETE_, path, std::move(handler));
     }
 
-    void Router::patch(const std::string& path, Handler handler) {
-        add(HttpMethod::PATCH, path, std::move(handler));
+    RouteHandle Router::patch(const std::string& path, Handler handler) {
+        return add(HttpMethod::PATCH, path, std::move(handler));
     }
 
-    void Router::options(const std::string& path, Handler handler) {
-        add(HttpMethod::OPTIONS, path, std::move(handler));
+    RouteHandle Router::options(const std::string& path, Handler handler) {
+        return add(HttpMethod::OPTIONS, path, std::move(handler));
     }
 
-    void Router::head(const std::string& path, Handler handler) {
-        add(HttpMethod::HEAD, path, std::move(handler));
+    RouteHandle Router::head(const std::string& path, Handler handler) {
+        return add(HttpMethod::HEAD, path, std::move(handler));
     }
 
     bool Router::dispatch(Request& req, Response& res)
@@ -52,13 +131,36 @@ namespace mini_http {
             if (std::regex_match(req.path, match, route.pattern)) {
 
                 req.params.clear();
+                req.route = &route;
 
                 for (size_t i = 0; i < route.paramNames.size(); ++i) {
                     req.params[route.paramNames[i]] =
                         match[i + 1].str();
                 }
 
-                route.handler(req, res);
+                if (route.options.deadline.count() > 0) {
+                    auto deadline = req.received + route.options.deadline;
+                    if (req.deadline == std::chrono::steady_clock::time_point() || deadline < req.deadline)
+                        req.deadline = deadline;
+                }
+
+                if (route.options.offload && executor_) {
+                    dispatchOffloaded(route, req, res);
+                    return true;
+                }
+
+                if (req.expired()) {
+                    dropExpired(res);
+                    return true;
+                }
+
+                auto start = std::chrono::steady_clock::now();
+
+                invoke(route, req, res);
+
+                if (metrics_)
+                    metrics_->recordLatency(route.id, Metrics::HANDLER_LATENCY,
+                                            std::chrono::steady_clock::now() - start);
                 return true;
             }
         }
@@ -66,16 +168,301 @@ namespace mini_http {
         return false;
     }
 
+    namespace {
+        std::string responseKey(const Route& route, const Request& req) {
+            std::string key = req.path;
+            if (!req.query.empty()) {
+                key += '?';
+                key += req.query;
+            }
+
+            for (const auto& name : route.options.vary) {
+                auto it = req.headers.find(name);
+                key += '\n';
+                key += name;
+                key += ':';
+                if (it != req.headers.end())
+                    key += it->second;
+            }
+            return key;
+        }
+
+        bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+            return a.size() == b.size()
+                && std::equal(a.begin(), a.end(), b.begin(), [](unsigned char x, unsigned char y) {
+                    return std::tolower(x) == std::tolower(y);
+                });
+        }
+
+        // Calls fn with each trimmed element of a comma-separated list,
+        // without any "=value" part, until it returns true.
+        template<typename F>
+        bool anyListElement(std::string_view list, F fn) {
+            size_t pos = 0;
+            while (pos < list.size()) {
+                size_t end = list.find(',', pos);
+                if (end == std::string_view::npos) end = list.size();
+
+                std::string_view element = list.substr(pos, end - pos);
+                element = element.substr(0, element.find('='));
+                while (!element.empty() && std::isspace(static_cast<unsigned char>(element.front())))
+                    element.remove_prefix(1);
+                while (!element.empty() && std::isspace(static_cast<unsigned char>(element.back())))
+                    element.remove_suffix(1);
+
+                if (!element.empty() && fn(element)) return true;
+                pos = end + 1;
+            }
+            return false;
+        }
+
+        // Whether the response may go to other requests with the same key:
+        // not if it sets a cookie, is marked private or no-store, or varies
+        // on a request header the key leaves out.
+        bool shareable(const Route& route, const Response& res) {
+            if (!res.shareable()) return false;
+
+            for (const auto& [name, value] : res.headers()) {
+                if (equalsIgnoreCase(name, "set-cookie"))
+                    return false;
+
+                if (equalsIgnoreCase(name, "cache-control")
+                    && anyListElement(value, [](std::string_view directive) {
+                        return equalsIgnoreCase(directive, "private")
+                            || equalsIgnoreCase(directive, "no-store");
+                    }))
+                    return false;
+
+                if (equalsIgnoreCase(name, "vary")
+                    && anyListElement(value, [&route](std::string_view header) {
+                        return std::none_of(route.options.vary.begin(), route.options.vary.end(),
+                                            [header](const std::string& keyed) {
+                                                return equalsIgnoreCase(header, keyed);
+                                            });
+                    }))
+                    return false;
+            }
+            return true;
+        }
+    }
+
+    void Router::invoke(Route& route, Request& req, Response& res) {
+        if (req.method != HttpMethod::GET)
+            route.handler(req, res);
+        else if (route.options.cacheTtl.count() > 0 && cache_)
+            dispatchCached(route, req, res);
+        else if (route.options.coalesce && flights_)
+            dispatchCoalesced(route, req, res, responseKey(route, req));
+        else
+            route.handler(req, res);
+    }
+
+    // The response stays detached until the handler has run on the
+    // executor; the I/O worker returns to its other connections meanwhile.
+    // The task is queued only once the middleware has unwound, so the two
+    // never use req and res at the same time.
+    void Router::dispatchOffloaded(Route& route, Request& req, Response& res) {
+        res.detach();
+        res.whenReturned([this, &route, &req, &res]() { enqueueOffloaded(route, req, res); });
+    }
+
+    void Router::enqueueOffloaded(Route& route, Request& req, Response& res) {
+        try {
+            executor_->enqueue([this, &route, &req, &res]() {
+                if (req.expired()) {
+                    try {
+                        dropExpired(res);
+                    } catch (...) {
+                    }
+                    res.complete();
+                    return;
+                }
+
+                auto start = std::chrono::steady_clock::now();
+
+                try {
+                    invoke(route, req, res);
+                } catch (...) {
+                    if (metrics_) metrics_->increment(Metrics::HANDLER_ERRORS);
+                    try {
+                        if (!res.isSent()) {
+                            res.keepAlive(false);
+                            res.internalServerError();
+                        }
+                    } catch (...) {
+                    }
+                }
+
+                if (metrics_)
+                    metrics_->recordLatency(route.id, Metrics::HANDLER_LATENCY,
+                                            std::chrono::steady_clock::now() - start);
+                res.complete();
+            }, route.options.priority);
+        }
+        catch (...) {
+            // Shutting down: the executor no longer takes tasks.
+            res.defer().resolve([](Response& r) { r.serviceUnavailable(); });
+            res.complete();
+        }
+    }
+
+    // Runs the handler for a detached request as a task of its own, so the
+    // thread that finished a coalesced run does not run it for every
+    // waiting request in turn.
+    void Router::redispatch(Route& route, Request& req, Response& res) {
+        auto run = [this, &route, &req, &res]() {
+            try {
+                route.handler(req, res);
+            } catch (...) {
+                if (metrics_) metrics_->increment(Metrics::HANDLER_ERRORS);
+                try {
+                    if (!res.isSent()) {
+                        res.keepAlive(false);
+                        res.internalServerError();
+                    }
+                } catch (...) {
+                }
+            }
+            res.complete();
+        };
+
+        try {
+            if (route.options.offload && executor_)
+                executor_->enqueue(std::move(run), route.options.priority);
+            else if (submit_)
+                submit_(res.connection(), std::move(run));
+            else
+                run();
+        } catch (...) {
+            // Shutting down: the worker queues no longer take tasks.
+            res.defer().resolve([](Response& r) { r.serviceUnavailable(); });
+            res.complete();
+        }
+    }
+
+    void Router::dropExpired(Response& res) {
+        if (metrics_) metrics_->increment(Metrics::DEADLINE_DROPS);
+        res.serviceUnavailable("Deadline exceeded");
+    }
+
+    bool Router::offloads() const {
+        for (const auto& [method, routeList] : routes)
+            for (const auto& route : routeList)
+                if (route.options.offload) return true;
+        return false;
+    }
+
+    void Router::cacheLimit(size_t maxBytes) {
+        cacheLimit_ = maxBytes;
+        if (cache_)
+            cache_->setLimit(maxBytes);
+    }
+
+    void Router::enableCache() {
+        if (!cache_)
+            cache_ = std::make_shared<ResponseCache>(cacheLimit_);
+        enableCoalescing();
+    }
+
+    void Router::enableCoalescing() {
+        if (!flights_)
+            flights_ = std::make_shared<SingleFlight<PreparedResponse>>();
+    }
+
+    void Router::dispatchCached(Route& route, Request& req, Response& res) {
+        std::string key = responseKey(route, req);
+
+        if (auto entry = cache_->get(key))
+            res.sendPrepared(*entry);
+        else
+            dispatchCoalesced(route, req, res, key);
+    }
+
+    // The first request for key runs the handler on this thread and shares
+    // the bytes it sends. Requests arriving meanwhile detach and are
+    // answered from the event loop once it is done.
+    void Router::dispatchCoalesced(Route& route, Request& req, Response& res,
+                                const std::string& key)
+    {
+        res.detach();
+
+        auto follow = [this, &route, &req, &res](const SingleFlight<PreparedResponse>::Result& shared,
+                                                std::exception_ptr error) {
+            if (!shared && !error) {
+                // Not shareable (sent after the handler returned, or took
+                // the connection over): run it again for this request, once
+                // its own middleware is done with it.
+                res.whenReturned([this, &route, &req, &res]() { redispatch(route, req, res); });
+                return;
+            }
+
+            if (metrics_) metrics_->increment(Metrics::COALESCED);
+
+            // A failed run answers 500 here too.
+            res.defer().resolve([shared](Response& r) {
+                if (shared) r.sendPrepared(*shared);
+            });
+            res.complete();
+        };
+
+        if (flights_->join(key, std::move(follow)))
+            return;
+
+        // Leading: the hold taken above is released once the handler has
+        // run, so a handler that detaches itself keeps the response open.
+        if (cache_ && route.options.cacheTtl.count() > 0) {
+            // A request that missed the cache just before the last run finished.
+            if (auto entry = cache_->get(key)) {
+                flights_->finish(key, entry);
+                res.sendPrepared(*entry);
+                res.complete();
+                return;
+            }
+        }
+
+        std::string bytes;
+        res.capture(&bytes);
+        try {
+            route.handler(req, res);
+        } catch (...) {
+            res.capture(nullptr);
+            res.complete();
+            flights_->finish(key, nullptr, std::current_exception());
+            throw;
+        }
+        res.capture(nullptr);
+
+        SingleFlight<PreparedResponse>::Result shared;
+        if (res.isSent() && !res.upgraded() && !bytes.empty() && shareable(route, res))
+            shared = std::make_shared<const PreparedResponse>(res.status(), std::move(bytes));
+
+        if (shared && res.status() == HttpStatus::OK && route.options.cacheTtl.count() > 0 && cache_)
+            cache_->put(key, shared, route.options.cacheTtl);
+
+        res.complete();
+        flights_->finish(key, std::move(shared));
+    }
+
     std::vector<Router::MountableRoute> Router::getMountableRoutes() const {
         std::vector<MountableRoute> result;
         for (const auto& [method, routeList] : routes) {
             for (const auto& route : routeList) {
-                result.push_back({method, route.path, route.handler});
+                result.push_back({method, route.path, route.handler, route.options});
             }
         }
         return result;
     }
 
+    std::vector<std::string> Router::routeLabels() const {
+        std::vector<std::string> labels(nextRouteId_);
+        for (const auto& [method, routeList] : routes) {
+            for (const auto& route : routeList) {
+                labels[route.id] = std::string(methodName(method)) + " " + route.path;
+            }
+        }
+        return labels;
+    }
+
     Route Router::buildRoute(const std::string& path,
                             Handler handler)
     {
@@ -0,0 +1,519 @@
+#include "http/Hpack.h"
+
+#include <algorithm>
+#include <array>
+
+namespace mini_http {
+    struct StaticEntry {
+        std::string_view name;
+        std::string_view value;
+    };
+
+    // RFC 7541 Appendix A; entry i is index i + 1.
+    static constexpr StaticEntry STATIC_TABLE[] = {
+        { ":authority", "" },
+        { ":method", "GET" },
+        { ":method", "POST" },
+        { ":path", "/" },
+        { ":path", "/index.html" },
+        { ":scheme", "http" },
+        { ":scheme", "https" },
+        { ":status", "200" },
+        { ":status", "204" },
+        { ":status", "206" },
+        { ":status", "304" },
+        { ":status", "400" },
+        { ":status", "404" },
+        { ":status", "500" },
+        { "accept-charset", "" },
+        { "accept-encoding", "gzip, deflate" },
+        { "accept-language", "" },
+        { "accept-ranges", "" },
+        { "accept", "" },
+        { "access-control-allow-origin", "" },
+        { "age", "" },
+        { "allow", "" },
+        { "authorization", "" },
+        { "cache-control", "" },
+        { "content-disposition", "" },
+        { "content-encoding", "" },
+        { "content-language", "" },
+        { "content-length", "" },
+        { "content-location", "" },
+        { "content-range", "" },
+        { "content-type", "" },
+        { "cookie", "" },
+        { "date", "" },
+        { "etag", "" },
+        { "expect", "" },
+        { "expires", "" },
+        { "from", "" },
+        { "host", "" },
+        { "if-match", "" },
+        { "if-modified-since", "" },
+        { "if-none-match", "" },
+        { "if-range", "" },
+        { "if-unmodified-since", "" },
+        { "last-modified", "" },
+        { "link", "" },
+        { "location", "" },
+        { "max-forwards", "" },
+        { "proxy-authenticate", "" },
+        { "proxy-authorization", "" },
+        { "range", "" },
+        { "referer", "" },
+        { "refresh", "" },
+        { "retry-after", "" },
+        { "server", "" },
+        { "set-cookie", "" },
+        { "strict-transport-security", "" },
+        { "transfer-encoding", "" },
+        { "user-agent", "" },
+        { "vary", "" },
+        { "via", "" },
+        { "www-authenticate", "" }
+    };
+
+    static constexpr size_t STATIC_COUNT = sizeof(STATIC_TABLE) / sizeof(STATIC_TABLE[0]);
+
+    struct HuffmanCode {
+        uint32_t code;
+        uint8_t bits;
+    };
+
+    // RFC 7541 Appendix B, indexed by symbol; 256 is EOS.
+    static constexpr HuffmanCode HUFFMAN_CODES[257] = {
+        { 0x1ff8, 13 }, { 0x7fffd8, 23 }, { 0xfffffe2, 28 }, { 0xfffffe3, 28 },
+        { 0xfffffe4, 28 }, { 0xfffffe5, 28 }, { 0xfffffe6, 28 }, { 0xfffffe7, 28 },
+        { 0xfffffe8, 28 }, { 0xffffea, 24 }, { 0x3ffffffc, 30 }, { 0xfffffe9, 28 },
+        { 0xfffffea, 28 }, { 0x3ffffffd, 30 }, { 0xfffffeb, 28 }, { 0xfffffec, 28 },
+        { 0xfffffed, 28 }, { 0xfffffee, 28 }, { 0xfffffef, 28 }, { 0xffffff0, 28 },
+        { 0xffffff1, 28 }, { 0xffffff2, 28 }, { 0x3ffffffe, 30 }, { 0xffffff3, 28 },
+        { 0xffffff4, 28 }, { 0xffffff5, 28 }, { 0xffffff6, 28 }, { 0xffffff7, 28 },
+        { 0xffffff8, 28 }, { 0xffffff9, 28 }, { 0xffffffa, 28 }, { 0xffffffb, 28 },
+        { 0x14, 6 }, { 0x3f8, 10 }, { 0x3f9, 10 }, { 0xffa, 12 },
+        { 0x1ff9, 13 }, { 0x15, 6 }, { 0xf8, 8 }, { 0x7fa, 11 },
+        { 0x3fa, 10 }, { 0x3fb, 10 }, { 0xf9, 8 }, { 0x7fb, 11 },
+        { 0xfa, 8 }, { 0x16, 6 }, { 0x17, 6 }, { 0x18, 6 },
+        { 0x0, 5 }, { 0x1, 5 }, { 0x2, 5 }, { 0x19, 6 },
+        { 0x1a, 6 }, { 0x1b, 6 }, { 0x1c, 6 }, { 0x1d, 6 },
+        { 0x1e, 6 }, { 0x1f, 6 }, { 0x5c, 7 }, { 0xfb, 8 },
+        { 0x7ffc, 15 }, { 0x20, 6 }, { 0xffb, 12 }, { 0x3fc, 10 },
+        { 0x1ffa, 13 }, { 0x21, 6 }, { 0x5d, 7 }, { 0x5e, 7 },
+        { 0x5f, 7 }, { 0x60, 7 }, { 0x61, 7 }, { 0x62, 7 },
+        { 0x63, 7 }, { 0x64, 7 }, { 0x65, 7 }, { 0x66, 7 },
+        { 0x67, 7 }, { 0x68, 7 }, { 0x69, 7 }, { 0x6a, 7 },
+        { 0x6b, 7 }, { 0x6c, 7 }, { 0x6d, 7 }, { 0x6e, 7 },
+        { 0x6f, 7 }, { 0x70, 7 }, { 0x71, 7 }, { 0x72, 7 },
+        { 0xfc, 8 }, { 0x73, 7 }, { 0xfd, 8 }, { 0x1ffb, 13 },
+        { 0x7fff0, 19 }, { 0x1ffc, 13 }, { 0x3ffc, 14 }, { 0x22, 6 },
+        { 0x7ffd, 15 }, { 0x3, 5 }, { 0x23, 6 }, { 0x4, 5 },
+        { 0x24, 6 }, { 0x5, 5 }, { 0x25, 6 }, { 0x26, 6 },
+        { 0x27, 6 }, { 0x6, 5 }, { 0x74, 7 }, { 0x75, 7 },
+        { 0x28, 6 }, { 0x29, 6 }, { 0x2a, 6 }, { 0x7, 5 },
+        { 0x2b, 6 }, { 0x76, 7 }, { 0x2c, 6 }, { 0x8, 5 },
+        { 0x9, 5 }, { 0x2d, 6 }, { 0x77, 7 }, { 0x78, 7 },
+        { 0x79, 7 }, { 0x7a, 7 }, { 0x7b, 7 }, { 0x7ffe, 15 },
+        { 0x7fc, 11 }, { 0x3ffd, 14 }, { 0x1ffd, 13 }, { 0xffffffc, 28 },
+        { 0xfffe6, 20 }, { 0x3fffd2, 22 }, { 0xfffe7, 20 }, { 0xfffe8, 20 },
+        { 0x3fffd3, 22 }, { 0x3fffd4, 22 }, { 0x3fffd5, 22 }, { 0x7fffd9, 23 },
+        { 0x3fffd6, 22 }, { 0x7fffda, 23 }, { 0x7fffdb, 23 }, { 0x7fffdc, 23 },
+        { 0x7fffdd, 23 }, { 0x7fffde, 23 }, { 0xffffeb, 24 }, { 0x7fffdf, 23 },
+        { 0xffffec, 24 }, { 0xffffed, 24 }, { 0x3fffd7, 22 }, { 0x7fffe0, 23 },
+        { 0xffffee, 24 }, { 0x7fffe1, 23 }, { 0x7fffe2, 23 }, { 0x7fffe3, 23 },
+        { 0x7fffe4, 23 }, { 0x1fffdc, 21 }, { 0x3fffd8, 22 }, { 0x7fffe5, 23 },
+        { 0x3fffd9, 22 }, { 0x7fffe6, 23 }, { 0x7fffe7, 23 }, { 0xffffef, 24 },
+        { 0x3fffda, 22 }, { 0x1fffdd, 21 }, { 0xfffe9, 20 }, { 0x3fffdb, 22 },
+        { 0x3fffdc, 22 }, { 0x7fffe8, 23 }, { 0x7fffe9, 23 }, { 0x1fffde, 21 },
+        { 0x7fffea, 23 }, { 0x3fffdd, 22 }, { 0x3fffde, 22 }, { 0xfffff0, 24 },
+        { 0x1fffdf, 21 }, { 0x3fffdf, 22 }, { 0x7fffeb, 23 }, { 0x7fffec, 23 },
+        { 0x1fffe0, 21 }, { 0x1fffe1, 21 }, { 0x3fffe0, 22 }, { 0x1fffe2, 21 },
+        { 0x7fffed, 23 }, { 0x3fffe1, 22 }, { 0x7fffee, 23 }, { 0x7fffef, 23 },
+        { 0xfffea, 20 }, { 0x3fffe2, 22 }, { 0x3fffe3, 22 }, { 0x3fffe4, 22 },
+        { 0x7ffff0, 23 }, { 0x3fffe5, 22 }, { 0x3fffe6, 22 }, { 0x7ffff1, 23 },
+        { 0x3ffffe0, 26 }, { 0x3ffffe1, 26 }, { 0xfffeb, 20 }, { 0x7fff1, 19 },
+        { 0x3fffe7, 22 }, { 0x7ffff2, 23 }, { 0x3fffe8, 22 }, { 0x1ffffec, 25 },
+        { 0x3ffffe2, 26 }, { 0x3ffffe3, 26 }, { 0x3ffffe4, 26 }, { 0x7ffffde, 27 },
+        { 0x7ffffdf, 27 }, { 0x3ffffe5, 26 }, { 0xfffff1, 24 }, { 0x1ffffed, 25 },
+        { 0x7fff2, 19 }, { 0x1fffe3, 21 }, { 0x3ffffe6, 26 }, { 0x7ffffe0, 27 },
+        { 0x7ffffe1, 27 }, { 0x3ffffe7, 26 }, { 0x7ffffe2, 27 }, { 0xfffff2, 24 },
+        { 0x1fffe4, 21 }, { 0x1fffe5, 21 }, { 0x3ffffe8, 26 }, { 0x3ffffe9, 26 },
+        { 0xffffffd, 28 }, { 0x7ffffe3, 27 }, { 0x7ffffe4, 27 }, { 0x7ffffe5, 27 },
+        { 0xfffec, 20 }, { 0xfffff3, 24 }, { 0xfffed, 20 }, { 0x1fffe6, 21 },
+        { 0x3fffe9, 22 }, { 0x1fffe7, 21 }, { 0x1fffe8, 21 }, { 0x7ffff3, 23 },
+        { 0x3fffea, 22 }, { 0x3fffeb, 22 }, { 0x1ffffee, 25 }, { 0x1ffffef, 25 },
+        { 0xfffff4, 24 }, { 0xfffff5, 24 }, { 0x3ffffea, 26 }, { 0x7ffff4, 23 },
+        { 0x3ffffeb, 26 }, { 0x7ffffe6, 27 }, { 0x3ffffec, 26 }, { 0x3ffffed, 26 },
+        { 0x7ffffe7, 27 }, { 0x7ffffe8, 27 }, { 0x7ffffe9, 27 }, { 0x7ffffea, 27 },
+        { 0x7ffffeb, 27 }, { 0xffffffe, 28 }, { 0x7ffffec, 27 }, { 0x7ffffed, 27 },
+        { 0x7ffffee, 27 }, { 0x7ffffef, 27 }, { 0x7fffff0, 27 }, { 0x3ffffee, 26 },
+        { 0x3fffffff, 30 }
+    };
+
+    // Decoding consumes four bits per step. States are the internal nodes
+    // of the code tree; each (state, nibble) pair records where the walk
+    // ends and the symbol it completed on the way, if any. Codes are at
+    // least five bits long, so a nibble completes at most one.
+    class HuffmanDecoder {
+    public:
+        struct Step {
+            uint8_t next;
+            uint8_t symbol;
+            bool emits;
+            bool fails;
+        };
+
+        HuffmanDecoder() {
+            children.push_back({ -1, -1 });
+
+            for (int symbol = 0; symbol < 257; ++symbol) {
+                const HuffmanCode& c = HUFFMAN_CODES[symbol];
+                int node = 0;
+
+                for (int bit = c.bits - 1; bit >= 0; --bit) {
+                    int branch = (c.code >> bit) & 1;
+
+                    if (bit == 0) {
+                        children[node][branch] = -(symbol + 1);
+                    } else {
+                        if (children[node][branch] < 0) {
+                            children[node][branch] = static_cast<int>(children.size());
+                            children.push_back({ -1, -1 });
+                        }
+                        node = children[node][branch];
+                    }
+                }
+            }
+
+            // All-ones prefixes of up to seven bits are the only valid padding.
+            accepting.assign(children.size(), false);
+            accepting[0] = true;
+            for (int node = 0, depth = 0; depth < 7; ++depth) {
+                node = children[node][1];
+                if (node <= 0) break;
+                accepting[node] = true;
+            }
+
+            for (size_t state = 0; state < children.size(); ++state) {
+                for (int nibble = 0; nibble < 16; ++nibble) {
+                    Step step { 0, 0, false, false };
+                    int node = static_cast<int>(state);
+
+                    for (int bit = 3; bit >= 0; --bit) {
+                        int child = children[node][(nibble >> bit) & 1];
+
+                        if (child < 0) {
+                            int symbol = -child - 1;
+                            if (symbol == 256) {
+                                step.fails = true;
+                                break;
+                            }
+                            step.symbol = static_cast<uint8_t>(symbol);
+                            step.emits = true;
+                            node = 0;
+                        } else {
+                            node = child;
+                        }
+                    }
+
+                    step.next = static_cast<uint8_t>(node);
+                    steps[state * 16 + nibble] = step;
+                }
+            }
+        }
+
+        void decode(std::string& out, std::string_view encoded) const {
+            size_t state = 0;
+
+            for (unsigned char byte : encoded) {
+                for (int half : { byte >> 4, byte & 0x0F }) {
+                    const Step& step = steps[state * 16 + half];
+                    if (step.fails)
+                        throw HpackError("Huffman string contains EOS");
+                    if (step.emits)
+                        out.push_back(static_cast<char>(step.symbol));
+                    state = step.next;
+                }
+            }
+
+            if (!accepting[state])
+                throw HpackError("Invalid Huffman padding");
+        }
+
+    private:
+        std::vector<std::array<int, 2>> children;
+        std::vector<bool> accepting;
+        std::array<Step, 256 * 16> steps {};
+    };
+
+    static const HuffmanDecoder& huffmanDecoder() {
+        static const HuffmanDecoder decoder;
+        return decoder;
+    }
+
+    size_t huffmanEncodedSize(std::string_view value) {
+        size_t bits = 0;
+        for (unsigned char c : value)
+            bits += HUFFMAN_CODES[c].bits;
+        return (bits + 7) / 8;
+    }
+
+    void huffmanEncode(std::string& out, std::string_view value) {
+        uint64_t pending = 0;
+        int count = 0;
+
+        for (unsigned char c : value) {
+            const HuffmanCode& code = HUFFMAN_CODES[c];
+            pending = (pending << code.bits) | code.code;
+            count += code.bits;
+
+            while (count >= 8) {
+                count -= 8;
+                out.push_back(static_cast<char>(pending >> count));
+            }
+        }
+
+        // Padded with the most significant bits of EOS, all ones.
+        if (count > 0)
+            out.push_back(static_cast<char>((pending << (8 - count)) | (0xFF >> count)));
+    }
+
+    void huffmanDecode(std::string& out, std::string_view encoded) {
+        huffmanDecoder().decode(out, encoded);
+    }
+
+    void hpackEncodeInteger(std::string& out, uint64_t value, int prefixBits, uint8_t firstByte) {
+        uint64_t max = (uint64_t(1) << prefixBits) - 1;
+
+        if (value < max) {
+            out.push_back(static_cast<char>(firstByte | value));
+            return;
+        }
+
+        out.push_back(static_cast<char>(firstByte | max));
+        value -= max;
+        while (value >= 128) {
+            out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<char>(value));
+    }
+
+    void hpackEncodeString(std::string& out, std::string_view value) {
+        size_t huffman = huffmanEncodedSize(value);
+
+        if (huffman < value.size()) {
+            hpackEncodeInteger(out, huffman, 7, 0x80);
+            huffmanEncode(out, value);
+        } else {
+            hpackEncodeInteger(out, value.size(), 7, 0);
+            out.append(value);
+        }
+    }
+
+    static uint64_t decodeInteger(const uint8_t*& p, const uint8_t* end, int prefixBits) {
+        uint64_t max = (uint64_t(1) << prefixBits) - 1;
+        uint64_t value = *p++ & max;
+        if (value < max) return value;
+
+        for (int shift = 0; p < end; shift += 7) {
+            if (shift > 28)
+                throw HpackError("Integer too large");
+
+            uint8_t byte = *p++;
+            value += uint64_t(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) return value;
+        }
+        throw HpackError("Truncated integer");
+    }
+
+    static std::string decodeString(const uint8_t*& p, const uint8_t* end) {
+        if (p == end)
+            throw HpackError("Truncated string");
+
+        bool huffman = *p & 0x80;
+        uint64_t length = decodeInteger(p, end, 7);
+        if (length > static_cast<uint64_t>(end - p))
+            throw HpackError("Truncated string");
+
+        std::string_view raw(reinterpret_cast<const char*>(p), static_cast<size_t>(length));
+        p += length;
+
+        std::string out;
+        if (huffman) {
+            out.reserve(raw.size() * 8 / 5);
+            huffmanDecode(out, raw);
+        } else {
+            out.assign(raw);
+        }
+        return out;
+    }
+
+    void HpackTable::add(std::string name, std::string value) {
+        size_t size = entrySize(name, value);
+
+        // An entry larger than the table empties it and is not added.
+        if (size > maxSize_) {
+            evict(0);
+            return;
+        }
+
+        evict(maxSize_ - size);
+        entries.push_front({ std::move(name), std::move(value) });
+        size_ += size;
+    }
+
+    void HpackTable::resize(size_t maxSize) {
+        maxSize_ = maxSize;
+        evict(maxSize);
+    }
+
+    void HpackTable::evict(size_t target) {
+        while (size_ > target && !entries.empty()) {
+            size_ -= entrySize(entries.back().name, entries.back().value);
+            entries.pop_back();
+        }
+    }
+
+    HpackDecoder::HpackDecoder(size_t maxTableSize)
+        : table(maxTableSize),
+        maxTableSize(maxTableSize)
+    {
+    }
+
+    const HeaderField& HpackDecoder::field(size_t index) const {
+        if (index <= STATIC_COUNT || index - STATIC_COUNT > table.count())
+            throw HpackError("Invalid header index");
+        return table.at(index - STATIC_COUNT);
+    }
+
+    std::string_view HpackDecoder::name(size_t index) const {
+        if (index == 0)
+            throw HpackError("Invalid header index");
+        if (index <= STATIC_COUNT)
+            return STATIC_TABLE[index - 1].name;
+        return field(index).name;
+    }
+
+    void HpackDecoder::decode(std::string_view block, HeaderList& out, size_t maxListSize) {
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(block.data());
+        const uint8_t* end = p + block.size();
+        size_t listSize = 0;
+        bool fieldSeen = false;
+
+        auto emit = [&](std::string name, std::string value) {
+            listSize += HpackTable::entrySize(name, value);
+            if (listSize > maxListSize)
+                throw HpackError("Header list too large");
+            out.push_back({ std::move(name), std::move(value) });
+            fieldSeen = true;
+        };
+
+        while (p < end) {
+            uint8_t byte = *p;
+
+            if (byte & 0x80) {
+                // Indexed field.
+                uint64_t index = decodeInteger(p, end, 7);
+                if (index == 0)
+                    throw HpackError("Invalid header index");
+
+                if (index <= STATIC_COUNT) {
+                    const StaticEntry& entry = STATIC_TABLE[index - 1];
+                    emit(std::string(entry.name), std::string(entry.value));
+                } else {
+                    const HeaderField& entry = field(static_cast<size_t>(index));
+                    emit(entry.name, entry.value);
+                }
+            } else if ((byte & 0xE0) == 0x20) {
+                // Dynamic table size update, only ahead of the first field.
+                uint64_t size = decodeInteger(p, end, 5);
+                if (fieldSeen || size > maxTableSize)
+                    throw HpackError("Invalid table size update");
+                table.resize(static_cast<size_t>(size));
+            } else {
+                // Literal: with incremental indexing (01), without (0000) or
+                // never indexed (0001).
+                bool indexing = (byte & 0xC0) == 0x40;
+                uint64_t index = decodeInteger(p, end, indexing ? 6 : 4);
+
+                std::string fieldName = index == 0 ? decodeString(p, end)
+                                                   : std::string(name(static_cast<size_t>(index)));
+                std::string value = decodeString(p, end);
+
+                if (indexing)
+                    table.add(fieldName, value);
+                emit(std::move(fieldName), std::move(value));
+            }
+        }
+    }
+
+    HpackEncoder::HpackEncoder(size_t maxTableSize)
+        : table(maxTableSize),
+        limit(maxTableSize),
+        pendingUpdate(maxTableSize)
+    {
+    }
+
+    void HpackEncoder::tableSize(size_t maxSize) {
+        size_t size = std::min(maxSize, limit);
+        if (size == table.maxSize() && !updatePending) return;
+
+        // Shrinking evicts at once; the peer learns of it with the update.
+        pendingUpdate = updatePending ? std::min(pendingUpdate, size) : size;
+        table.resize(size);
+        updatePending = true;
+    }
+
+    void HpackEncoder::encode(const HeaderList& fields, std::string& out) {
+        if (updatePending) {
+            if (pendingUpdate < table.maxSize())
+                hpackEncodeInteger(out, pendingUpdate, 5, 0x20);
+            hpackEncodeInteger(out, table.maxSize(), 5, 0x20);
+            updatePending = false;
+        }
+
+        for (const HeaderField& field : fields)
+            encodeField(field, out);
+    }
+
+    void HpackEncoder::encodeField(const HeaderField& field, std::string& out) {
+        size_t nameIndex = 0;
+
+        for (size_t i = 0; i < STATIC_COUNT; ++i) {
+            if (STATIC_TABLE[i].name != field.name) continue;
+            if (STATIC_TABLE[i].value == field.value) {
+                hpackEncodeInteger(out, i + 1, 7, 0x80);
+                return;
+            }
+            if (nameIndex == 0) nameIndex = i + 1;
+        }
+
+        for (size_t i = 1; i <= table.count(); ++i) {
+            const HeaderField& entry = table.at(i);
+            if (entry.name != field.name) continue;
+            if (entry.value == field.value) {
+                hpackEncodeInteger(out, STATIC_COUNT + i, 7, 0x80);
+                return;
+            }
+            if (nameIndex == 0) nameIndex = STATIC_COUNT + i;
+        }
+
+        // Values that change with every response would only churn the table.
+        bool sensitive = field.name == "set-cookie" || field.name == "authorization";
+        bool indexing = !sensitive && field.name != "content-length"
+                        && HpackTable::entrySize(field.name, field.value) <= table.maxSize();
+
+        if (indexing)
+            hpackEncodeInteger(out, nameIndex, 6, 0x40);
+        else
+            hpackEncodeInteger(out, nameIndex, 4, sensitive ? 0x10 : 0x00);
+
+        if (nameIndex == 0)
+            hpackEncodeString(out, field.name);
+        hpackEncodeString(out, field.value);
+
+        if (indexing)
+            table.add(field.name, field.value);
+    }
+}
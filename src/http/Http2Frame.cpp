@@ -0,0 +1,46 @@
+#include "http/Http2Frame.h"
+
+namespace mini_http {
+    size_t parseHttp2Frame(const char* data, size_t len, uint32_t maxFrameSize,
+                        Http2Frame& frame)
+    {
+        if (len < HTTP2_FRAME_HEADER_SIZE) return 0;
+
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+        uint32_t length = (uint32_t(bytes[0]) << 16) | (uint32_t(bytes[1]) << 8) | bytes[2];
+
+        if (length > maxFrameSize)
+            throw Http2Error(Http2ErrorCode::FRAME_SIZE, "Frame too large");
+        if (len < HTTP2_FRAME_HEADER_SIZE + length) return 0;
+
+        frame.type = bytes[3];
+        frame.flags = bytes[4];
+        frame.streamId = readUint32(data + 5) & 0x7FFFFFFF;
+        frame.payload = std::string_view(data + HTTP2_FRAME_HEADER_SIZE, length);
+        return HTTP2_FRAME_HEADER_SIZE + length;
+    }
+
+    void removeHttp2Padding(Http2Frame& frame) {
+        if (!frame.has(Http2Flag::PADDED)) return;
+
+        if (frame.payload.empty())
+            throw Http2Error(Http2ErrorCode::FRAME_SIZE, "Missing pad length");
+
+        size_t padding = static_cast<uint8_t>(frame.payload[0]);
+        if (padding >= frame.payload.size())
+            throw Http2Error(Http2ErrorCode::PROTOCOL, "Padding exceeds payload");
+
+        frame.payload = frame.payload.substr(1, frame.payload.size() - 1 - padding);
+    }
+
+    void appendHttp2FrameHeader(std::string& out, size_t length, Http2FrameType type,
+                            uint8_t flags, uint32_t streamId)
+    {
+        out.push_back(static_cast<char>(length >> 16));
+        out.push_back(static_cast<char>(length >> 8));
+        out.push_back(static_cast<char>(length));
+        out.push_back(static_cast<char>(type));
+        out.push_back(static_cast<char>(flags));
+        appendUint32(out, streamId & 0x7FFFFFFF);
+    }
+}
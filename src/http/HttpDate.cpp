@@ -0,0 +1,58 @@
+#include "http/HttpDate.h"
+#include <ctime>
+
+namespace mini_http {
+    static void formatDate(std::time_t now, std::string& out) {
+        static const char* days[] = {
+            "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"
+        };
+        static const char* months[] = {
+            "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+            "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
+        };
+
+        std::tm tm{};
+        #ifdef _WIN32
+            gmtime_s(&tm, &now);
+        #else
+            gmtime_r(&now, &tm);
+        #endif
+
+        auto two = [&out](int v) {
+            out.push_back(static_cast<char>('0' + v / 10));
+            out.push_back(static_cast<char>('0' + v % 10));
+        };
+
+        int year = tm.tm_year + 1900;
+
+        out.clear();
+        out.append(days[tm.tm_wday]);
+        out.append(", ");
+        two(tm.tm_mday);
+        out.push_back(' ');
+        out.append(months[tm.tm_mon]);
+        out.push_back(' ');
+        two(year / 100);
+        two(year % 100);
+        out.push_back(' ');
+        two(tm.tm_hour);
+        out.push_back(':');
+        two(tm.tm_min);
+        out.push_back(':');
+        two(tm.tm_sec);
+        out.append(" GMT");
+    }
+
+    const std::string& httpDate() {
+        thread_local std::time_t cachedSecond = -1;
+        thread_local std::string cached;
+
+        std::time_t now = std::time(nullptr);
+        if (now != cachedSecond) {
+            formatDate(now, cached);
+            cachedSecond = now;
+        }
+
+        return cached;
+    }
+}
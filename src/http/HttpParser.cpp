@@ -3,6 +3,10 @@
 #include <sstream>
 #include <algorithm>
 #include <stdexcept>
+#include <cerrno>
+#include <cctype>
+#include <string_view>
+#include <utility>
 
 namespace mini_http {
     static HttpMethod parseMethod(const std::string& methodStr) {
@@ -14,32 +18,89 @@ namespace mini_http {
         if (methodStr == "OPTIONS") return HttpMethod::OPTIONS;
         if (methodStr == "HEAD") return HttpMethod::HEAD;
 
-        throw std::runtime_error("Unsupported HTTP method");
+        throw ParseError(ParseError::Kind::MALFORMED, "Unsupported HTTP method");
+    }
+
+    static ParseError readError() {
+        #ifdef _WIN32
+            bool timedOut = WSAGetLastError() == WSAETIMEDOUT;
+        #else
+            bool timedOut = errno == EAGAIN || errno == EWOULDBLOCK;
+        #endif
+
+        if (timedOut)
+            return ParseError(ParseError::Kind::TIMEOUT, "Socket read timed out");
+
+        return ParseError(ParseError::Kind::CLOSED, "Socket read error");
+    }
+
+    static constexpr size_t MAX_HEADER_SIZE = 8192;
+
+    // Header lines up to the end of stream, as lowercase name and value.
+    template<typename Add>
+    static void readHeaders(std::istringstream& stream, Add add) {
+        std::string line;
+
+        while (std::getline(stream, line)) {
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+
+            if (line.empty())
+                continue;
+
+            size_t colon = line.find(":");
+            if (colon == std::string::npos)
+                continue;
+
+            std::string key = line.substr(0, colon);
+            std::string value = line.substr(colon + 1);
+
+            if (!value.empty() && value[0] == ' ')
+                value.erase(0, 1);
+
+            std::transform(key.begin(), key.end(), key.begin(), [](unsigned char c) {
+                return static_cast<char>(std::tolower(c));
+            });
+
+            add(std::move(key), std::move(value));
+        }
     }
 
     Request parseRequest(Connection& conn) {
         std::string& raw = conn.readBuffer;
         char buffer[4096];
 
+        auto received = std::chrono::steady_clock::now();
+        auto readyAt = std::exchange(conn.readyAt, {});
+
         while (raw.find("\r\n\r\n") == std::string::npos) {
             ssize_t bytes = conn.read(buffer, sizeof(buffer));
 
             if (bytes == 0) {
                 if (raw.empty())
-                    throw std::runtime_error("Connection closed");
-                break;
+                    throw ParseError(ParseError::Kind::CLOSED, "Connection closed");
+                throw ParseError(ParseError::Kind::CLOSED, "Connection closed mid-request");
             }
 
             if (bytes < 0)
-                throw std::runtime_error("Socket read error");
+                throw readError();
+
+            if (raw.empty())
+                received = readyAt != decltype(readyAt)() ? readyAt : std::chrono::steady_clock::now();
 
             raw.append(buffer, bytes);
 
-            if (raw.size() > 8192)
-                throw std::runtime_error("Header too large");
+            if (raw.size() > MAX_HEADER_SIZE && raw.find("\r\n\r\n") == std::string::npos)
+                throw ParseError(ParseError::Kind::MALFORMED, "Header too large");
         }
 
         size_t headerEnd = raw.find("\r\n\r\n");
+
+        // Decided on the header's position, not on how the reads happened to
+        // be split, so a request is accepted or rejected the same way however
+        // it arrives.
+        if (headerEnd + 4 > MAX_HEADER_SIZE)
+            throw ParseError(ParseError::Kind::MALFORMED, "Header too large");
         std::string headerPart = raw.substr(0, headerEnd);
 
         std::istringstream stream(headerPart);
@@ -48,9 +109,21 @@ namespace mini_http {
         stream >> methodStr >> path >> version;
 
         if (methodStr.empty() || path.empty() || version.empty())
-            throw std::runtime_error("Malformed request line");
+            throw ParseError(ParseError::Kind::MALFORMED, "Malformed request line");
 
         Request req;
+        req.received = received;
+
+        // Start of the HTTP/2 prior-knowledge preface. The rest of it is left
+        // in the buffer for the HTTP/2 session to check.
+        if (std::string_view(raw).substr(0, headerEnd) == "PRI * HTTP/2.0") {
+            req.method = HttpMethod::GET;
+            req.path = path;
+            req.version = version;
+            raw.erase(0, headerEnd + 4);
+            return req;
+        }
+
         req.method = parseMethod(methodStr);
         req.version = version;
 
@@ -62,44 +135,38 @@ namespace mini_http {
             req.path = path;
         }
 
+        if (req.path.empty())
+            throw ParseError(ParseError::Kind::MALFORMED, "Malformed request target");
+
         std::string line;
         std::getline(stream, line);
 
-        while (std::getline(stream, line)) {
-            if (!line.empty() && line.back() == '\r')
-                line.pop_back();
-
-            if (line.empty())
-                continue;
-
-            size_t colon = line.find(":");
-            if (colon == std::string::npos)
-                continue;
-
-            std::string key = line.substr(0, colon);
-            std::string value = line.substr(colon + 1);
-
-            if (!value.empty() && value[0] == ' ')
-                value.erase(0, 1);
-
-            std::transform(key.begin(), key.end(), key.begin(), ::tolower);
-
-            req.headers[key] = value;
-        }
+        readHeaders(stream, [&req](std::string key, std::string value) {
+            req.headers[std::move(key)] = std::move(value);
+        });
 
         size_t contentLength = 0;
         auto it = req.headers.find("content-length");
         if (it != req.headers.end()) {
-            contentLength = std::stoul(it->second);
+            try {
+                contentLength = std::stoul(it->second);
+            } catch (const std::logic_error&) {
+                throw ParseError(ParseError::Kind::MALFORMED, "Invalid Content-Length");
+            }
         }
 
+        if (contentLength > raw.max_size() - headerEnd - 4)
+            throw ParseError(ParseError::Kind::MALFORMED, "Invalid Content-Length");
+
         size_t totalRequestSize = headerEnd + 4 + contentLength;
 
         while (raw.size() < totalRequestSize) {
             ssize_t bytes = conn.read(buffer, sizeof(buffer));
 
-            if (bytes <= 0)
-                throw std::runtime_error("Body truncated");
+            if (bytes < 0)
+                throw readError();
+            if (bytes == 0)
+                throw ParseError(ParseError::Kind::CLOSED, "Body truncated");
 
             raw.append(buffer, bytes);
         }
@@ -112,4 +179,127 @@ namespace mini_http {
 
         return req;
     }
-}
\ No newline at end of file
+
+    const std::string* ResponseHead::header(std::string_view name) const {
+        for (const auto& [key, value] : headers) {
+            if (key == name) return &value;
+        }
+        return nullptr;
+    }
+
+    // Upstream heads are larger than request heads when servers set many
+    // cookies, so they get more room.
+    static constexpr size_t MAX_RESPONSE_HEAD_SIZE = 64 * 1024;
+
+    size_t parseResponseHead(std::string_view data, ResponseHead& out) {
+        size_t headerEnd = data.find("\r\n\r\n");
+        if (headerEnd == std::string_view::npos) {
+            if (data.size() > MAX_RESPONSE_HEAD_SIZE)
+                throw ParseError(ParseError::Kind::MALFORMED, "Response head too large");
+            return 0;
+        }
+        if (headerEnd + 4 > MAX_RESPONSE_HEAD_SIZE)
+            throw ParseError(ParseError::Kind::MALFORMED, "Response head too large");
+
+        std::istringstream stream(std::string(data.substr(0, headerEnd)));
+
+        std::string statusLine;
+        std::getline(stream, statusLine);
+        if (!statusLine.empty() && statusLine.back() == '\r')
+            statusLine.pop_back();
+
+        // HTTP/1.1 200 OK; the reason phrase may be empty or contain spaces.
+        size_t firstSpace = statusLine.find(' ');
+        if (firstSpace == std::string::npos || statusLine.compare(0, 5, "HTTP/") != 0
+            || statusLine.size() < firstSpace + 4)
+            throw ParseError(ParseError::Kind::MALFORMED, "Malformed status line");
+
+        int status = 0;
+        for (size_t i = firstSpace + 1; i < firstSpace + 4; ++i) {
+            if (!std::isdigit(static_cast<unsigned char>(statusLine[i])))
+                throw ParseError(ParseError::Kind::MALFORMED, "Malformed status line");
+            status = status * 10 + (statusLine[i] - '0');
+        }
+        if (status < 100 || (statusLine.size() > firstSpace + 4 && statusLine[firstSpace + 4] != ' '))
+            throw ParseError(ParseError::Kind::MALFORMED, "Malformed status line");
+
+        out.status = status;
+        out.version = statusLine.substr(0, firstSpace);
+        out.reason = statusLine.size() > firstSpace + 5 ? statusLine.substr(firstSpace + 5) : "";
+        out.headers.clear();
+
+        readHeaders(stream, [&out](std::string key, std::string value) {
+            out.headers.emplace_back(std::move(key), std::move(value));
+        });
+
+        return headerEnd + 4;
+    }
+
+    static constexpr size_t MAX_CHUNK_LINE = 4096;
+
+    void ChunkedDecoder::reset() {
+        state = State::SIZE;
+        remaining = 0;
+        line.clear();
+    }
+
+    size_t ChunkedDecoder::decode(std::string_view data, std::string& out) {
+        size_t pos = 0;
+
+        while (pos < data.size() && state != State::DONE) {
+            if (state == State::DATA) {
+                size_t take = static_cast<size_t>(std::min<uint64_t>(remaining, data.size() - pos));
+                out.append(data.data() + pos, take);
+                pos += take;
+                remaining -= take;
+                if (remaining == 0)
+                    state = State::DATA_END;
+                continue;
+            }
+
+            // The other states consume whole lines, which may span calls.
+            size_t end = data.find('\n', pos);
+            size_t stop = end == std::string_view::npos ? data.size() : end;
+            line.append(data.data() + pos, stop - pos);
+            if (line.size() > MAX_CHUNK_LINE)
+                throw ParseError(ParseError::Kind::MALFORMED, "Chunk line too long");
+            if (end == std::string_view::npos)
+                return data.size();
+            pos = end + 1;
+
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+
+            if (state == State::SIZE) {
+                uint64_t size = 0;
+                size_t digits = 0;
+                for (char c : line) {
+                    int value;
+                    if (c >= '0' && c <= '9') value = c - '0';
+                    else if (c >= 'a' && c <= 'f') value = c - 'a' + 10;
+                    else if (c >= 'A' && c <= 'F') value = c - 'A' + 10;
+                    else break;
+
+                    if (++digits > 15)
+                        throw ParseError(ParseError::Kind::MALFORMED, "Chunk too large");
+                    size = size * 16 + static_cast<uint64_t>(value);
+                }
+                if (digits == 0)
+                    throw ParseError(ParseError::Kind::MALFORMED, "Malformed chunk size");
+
+                remaining = size;
+                state = size == 0 ? State::TRAILER : State::DATA;
+            } else if (state == State::DATA_END) {
+                if (!line.empty())
+                    throw ParseError(ParseError::Kind::MALFORMED, "Malformed chunk");
+                state = State::SIZE;
+            } else if (line.empty()) {
+                state = State::DONE;
+            }
+
+            line.clear();
+        }
+
+        return pos;
+    }
+}
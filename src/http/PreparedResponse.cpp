@@ -0,0 +1,129 @@
+#include "http/PreparedResponse.h"
+#include "http/HttpDate.h"
+#include "net/Connection.h"
+#include <algorithm>
+#include <cctype>
+#include <string_view>
+
+namespace mini_http {
+    PreparedResponse::PreparedResponse(HttpStatus status,
+                                    const Response::Headers& headers,
+                                    const std::string& body)
+        : status_(status),
+        dateOffset_(std::string::npos),
+        headersOffset_(0),
+        hasConnection_(false),
+        closes_(false)
+    {
+        Response::Headers withDefaults = headers;
+        if (withDefaults.find("Content-Type") == withDefaults.end())
+            withDefaults["Content-Type"] = "text/plain";
+
+        Response::serialize(status, withDefaults, body, bytes_);
+
+        locateHeaders(headers.find("Date") == headers.end());
+    }
+
+    PreparedResponse::PreparedResponse(HttpStatus status, std::string serialized)
+        : status_(status),
+        bytes_(std::move(serialized)),
+        dateOffset_(std::string::npos),
+        headersOffset_(0),
+        hasConnection_(false),
+        closes_(false)
+    {
+        locateHeaders(true);
+    }
+
+    static bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+        return a.size() == b.size()
+            && std::equal(a.begin(), a.end(), b.begin(), [](unsigned char x, unsigned char y) {
+                return std::tolower(x) == std::tolower(y);
+            });
+    }
+
+    void PreparedResponse::locateHeaders(bool findDate) {
+        size_t headerEnd = bytes_.find("\r\n\r\n");
+        size_t lineEnd = bytes_.find("\r\n");
+        if (headerEnd == std::string::npos || lineEnd == std::string::npos)
+            return;
+
+        headersOffset_ = lineEnd + 2;
+
+        std::string_view headers(bytes_.data(), headerEnd + 2);
+        for (size_t pos = headersOffset_; pos < headers.size(); ) {
+            size_t end = headers.find("\r\n", pos);
+            std::string_view line = headers.substr(pos, end - pos);
+
+            size_t colon = line.find(':');
+            if (colon != std::string_view::npos) {
+                std::string_view name = line.substr(0, colon);
+                std::string_view value = line.substr(colon + 1);
+                if (!value.empty() && value.front() == ' ')
+                    value.remove_prefix(1);
+
+                if (equalsIgnoreCase(name, "Connection")) {
+                    hasConnection_ = true;
+                    closes_ = equalsIgnoreCase(value, "close");
+                } else if (findDate && name == "Date" && value.size() == HTTP_DATE_LENGTH) {
+                    dateOffset_ = static_cast<size_t>(value.data() - bytes_.data());
+                }
+            }
+
+            pos = end + 2;
+        }
+    }
+
+    Response::Headers PreparedResponse::headers() const {
+        Response::Headers headers;
+        size_t headerEnd = bytes_.find("\r\n\r\n");
+        if (headerEnd == std::string::npos) return headers;
+
+        std::string_view block(bytes_.data(), headerEnd + 2);
+        for (size_t pos = headersOffset_; pos < block.size(); ) {
+            size_t end = block.find("\r\n", pos);
+            std::string_view line = block.substr(pos, end - pos);
+            pos = end + 2;
+
+            size_t colon = line.find(':');
+            if (colon == std::string_view::npos) continue;
+
+            std::string_view value = line.substr(colon + 1);
+            if (!value.empty() && value.front() == ' ')
+                value.remove_prefix(1);
+
+            if (dateOffset_ != std::string::npos
+                && value.data() == bytes_.data() + dateOffset_)
+                continue;
+
+            headers.emplace(std::string(line.substr(0, colon)), std::string(value));
+        }
+        return headers;
+    }
+
+    std::string_view PreparedResponse::body() const {
+        size_t headerEnd = bytes_.find("\r\n\r\n");
+        if (headerEnd == std::string::npos) return {};
+        return std::string_view(bytes_).substr(headerEnd + 4);
+    }
+
+    void PreparedResponse::queueTo(Connection& conn, bool keepAlive) const {
+        std::string_view bytes(bytes_);
+        size_t pos = 0;
+
+        if (!hasConnection_) {
+            conn.queue(bytes.substr(0, headersOffset_));
+            conn.queue(keepAlive ? std::string_view("Connection: keep-alive\r\n")
+                                 : std::string_view("Connection: close\r\n"));
+            pos = headersOffset_;
+        }
+
+        if (dateOffset_ != std::string::npos) {
+            conn.queue(bytes.substr(pos, dateOffset_ - pos));
+            conn.queue(httpDate().data(), HTTP_DATE_LENGTH);
+            pos = dateOffset_ + HTTP_DATE_LENGTH;
+        }
+
+        conn.queue(bytes.substr(pos));
+    }
+}
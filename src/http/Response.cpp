@@ -0,0 +1,473 @@
+#include "http/Response.h"
+#include "http/HttpDate.h"
+#include "http/PreparedResponse.h"
+#include "net/Connection.h"
+#include "net/EventLoop.h"
+#include <cerrno>
+#include <charconv>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#ifdef _WIN32
+    #define CLOSE_SOCKET closesocket
+#else
+    #include <unistd.h>
+    #define CLOSE_SOCKET close
+#endif
+
+namespace mini_http {
+    static std::string_view statusLine(HttpStatus status) {
+        switch (status) {
+            case HttpStatus::SWITCHING_PROTOCOLS: return "HTTP/1.1 101 Switching Protocols\r\n";
+            case HttpStatus::OK: return "HTTP/1.1 200 OK\r\n";
+            case HttpStatus::CREATED: return "HTTP/1.1 201 Created\r\n";
+            case HttpStatus::NO_CONTENT: return "HTTP/1.1 204 No Content\r\n";
+            case HttpStatus::MOVED_PERMANENTLY: return "HTTP/1.1 301 Moved Permanently\r\n";
+            case HttpStatus::FOUND: return "HTTP/1.1 302 Found\r\n";
+            case HttpStatus::SEE_OTHER: return "HTTP/1.1 303 See Other\r\n";
+            case HttpStatus::TEMPORARY_REDIRECT: return "HTTP/1.1 307 Temporary Redirect\r\n";
+            case HttpStatus::PERMANENT_REDIRECT: return "HTTP/1.1 308 Permanent Redirect\r\n";
+            case HttpStatus::BAD_REQUEST: return "HTTP/1.1 400 Bad Request\r\n";
+            case HttpStatus::UNAUTHORIZED: return "HTTP/1.1 401 Unauthorized\r\n";
+            case HttpStatus::FORBIDDEN: return "HTTP/1.1 403 Forbidden\r\n";
+            case HttpStatus::NOT_FOUND: return "HTTP/1.1 404 Not Found\r\n";
+            case HttpStatus::METHOD_NOT_ALLOWED: return "HTTP/1.1 405 Method Not Allowed\r\n";
+            case HttpStatus::INTERNAL_SERVER_ERROR: return "HTTP/1.1 500 Internal Server Error\r\n";
+            case HttpStatus::BAD_GATEWAY: return "HTTP/1.1 502 Bad Gateway\r\n";
+            case HttpStatus::SERVICE_UNAVAILABLE: return "HTTP/1.1 503 Service Unavailable\r\n";
+            case HttpStatus::GATEWAY_TIMEOUT: return "HTTP/1.1 504 Gateway Timeout\r\n";
+            default: break;
+        }
+
+        // Other valid codes, e.g. relayed from an upstream, go out with an
+        // empty reason phrase.
+        static const std::vector<std::string> generic = [] {
+            std::vector<std::string> lines;
+            for (int code = 100; code < 600; ++code)
+                lines.push_back("HTTP/1.1 " + std::to_string(code) + " \r\n");
+            return lines;
+        }();
+
+        int code = static_cast<int>(status);
+        if (code < 100 || code >= 600)
+            return "HTTP/1.1 500 Internal Server Error\r\n";
+        return generic[static_cast<size_t>(code - 100)];
+    }
+
+    Response::Response(Connection& conn, Sink* sink)
+        : conn_(conn),
+        sink_(sink),
+        status_(HttpStatus::OK),
+        sent_(false),
+        keepAlive_(false),
+        shareable_(true),
+        capture_(nullptr),
+        state_(State::SYNC),
+        holds_(0),
+        returned_(false)
+    {
+    }
+
+    void Response::setStatus(HttpStatus status) {
+        status_ = status;
+    }
+
+    void Response::setHeader(const std::string& key,
+                            const std::string& value)
+    {
+        headers_[key] = value;
+    }
+
+    void Response::send(const std::string& body) {
+        if (sent_) return;
+
+        if (headers_.find("Content-Type") == headers_.end())
+            headers_["Content-Type"] = "text/plain";
+
+        if (sink_) {
+            if (capture_)
+                serialize(status_, headers_, body, *capture_);
+            sink_->respond(status_, headers_, body);
+            sent_ = true;
+            return;
+        }
+
+        std::string_view connection;
+        auto it = headers_.find("Connection");
+        if (it == headers_.end())
+            connection = keepAlive_ ? "keep-alive" : "close";
+        else if (tokenListContains(it->second, "close"))
+            keepAlive_ = false;
+
+        std::string_view line = statusLine(status_);
+        std::string& head = conn_.writeBuffer;
+        head.clear();
+        appendHeaders(headers_, body.size(), head, connection);
+
+        // Cached copies are replayed to other connections, so they are kept
+        // without the Connection header negotiated for this one.
+        if (capture_) {
+            capture_->assign(line);
+            capture_->append(head, connection.empty() ? 0 : connection.size() + 14);
+            capture_->append(body);
+        }
+
+        conn_.queue(line);
+        conn_.queue(head);
+        conn_.queue(body);
+        flush();
+        sent_ = true;
+    }
+
+    void Response::json(const nlohmann::json& data) {
+        setHeader("Content-Type", "application/json");
+        send(data.dump());
+    }
+
+    void Response::redirect(const std::string& location,
+                            HttpStatus status)
+    {
+        if (sent_) return;
+
+        setStatus(status);
+        setHeader("Location", location);
+
+        setHeader("Content-Type", "text/html");
+        send("");
+    }
+
+    void Response::ok(const nlohmann::json& data) {
+        setStatus(HttpStatus::OK);
+        json(data);
+    }
+
+    void Response::created(const nlohmann::json& data) {
+        setStatus(HttpStatus::CREATED);
+        json(data);
+    }
+
+    void Response::noContent() {
+        setStatus(HttpStatus::NO_CONTENT);
+        send("");
+    }
+
+    void Response::movedPermanently(const std::string& location) {
+        redirect(location, HttpStatus::MOVED_PERMANENTLY);
+    }
+
+    void Response::found(const std::string& location) {
+        redirect(location, HttpStatus::FOUND);
+    }
+
+    void Response::seeOther(const std::string& location) {
+        redirect(location, HttpStatus::SEE_OTHER);
+    }
+
+    void Response::temporaryRedirect(const std::string& location) {
+        redirect(location, HttpStatus::TEMPORARY_REDIRECT);
+    }
+
+    void Response::permanentRedirect(const std::string& location) {
+        redirect(location, HttpStatus::PERMANENT_REDIRECT);
+    }
+
+    void Response::badRequest(const std::string& message) {
+        sendError(HttpStatus::BAD_REQUEST, message);
+    }
+
+    void Response::unauthorized(const std::string& message) {
+        sendError(HttpStatus::UNAUTHORIZED, message);
+    }
+
+    void Response::forbidden(const std::string& message) {
+        sendError(HttpStatus::FORBIDDEN, message);
+    }
+
+    void Response::notFound(const std::string& message) {
+        sendError(HttpStatus::NOT_FOUND, message);
+    }
+
+    void Response::methodNotAllowed(const std::string& allow, const std::string& message) {
+        setHeader("Allow", allow);
+        sendError(HttpStatus::METHOD_NOT_ALLOWED, message);
+    }
+
+    void Response::internalServerError(const std::string& message) {
+        sendError(HttpStatus::INTERNAL_SERVER_ERROR, message);
+    }
+
+    void Response::badGateway(const std::string& message) {
+        sendError(HttpStatus::BAD_GATEWAY, message);
+    }
+
+    void Response::serviceUnavailable(const std::string& message) {
+        sendError(HttpStatus::SERVICE_UNAVAILABLE, message);
+    }
+
+    void Response::gatewayTimeout(const std::string& message) {
+        sendError(HttpStatus::GATEWAY_TIMEOUT, message);
+    }
+
+    void Response::switchProtocols(const Headers& headers,
+                                   std::function<void(Connection&)> takeover)
+    {
+        if (sent_) return;
+
+        status_ = HttpStatus::SWITCHING_PROTOCOLS;
+        for (const auto& [key, value] : headers)
+            headers_[key] = value;
+
+        sendOpenEnded(std::move(takeover));
+    }
+
+    void Response::stream(std::function<void(Connection&)> takeover) {
+        if (sent_) return;
+
+        headers_["Connection"] = "close";
+        sendOpenEnded(std::move(takeover));
+    }
+
+    // Status line and headers only: the body, if any, is written by the
+    // connection's new owner.
+    void Response::sendOpenEnded(std::function<void(Connection&)> takeover) {
+        keepAlive_ = false;
+
+        if (sink_) {
+            sink_->refuseTakeover();
+            sent_ = true;
+            return;
+        }
+
+        std::string& head = conn_.writeBuffer;
+        head.assign(statusLine(status_));
+        for (const auto& [key, value] : headers_) {
+            head.append(key);
+            head.append(": ");
+            head.append(value);
+            head.append("\r\n");
+        }
+        head.append("\r\n");
+
+        conn_.queue(head);
+        flush();
+        sent_ = true;
+        takeover_ = std::move(takeover);
+    }
+
+    void Response::detach() {
+        if (holds_.fetch_add(1) > 0) return;
+
+        State expected = State::SYNC;
+        state_.compare_exchange_strong(expected, State::DETACHED);
+    }
+
+    // Races with handOff(): a response completed before the handler
+    // returned is finished by the worker, otherwise by the hook.
+    void Response::complete() {
+        if (holds_.fetch_sub(1) != 1) return;
+
+        State expected = State::DETACHED;
+        if (state_.compare_exchange_strong(expected, State::COMPLETED))
+            return;
+
+        if (expected == State::HANDED_OFF
+            && state_.compare_exchange_strong(expected, State::COMPLETED))
+            onComplete_();
+    }
+
+    struct Response::Deferred::State {
+        Response* res;
+        std::atomic<bool> resolved { false };
+
+        ~State() {
+            if (!resolved.load())
+                resolve(res, [](Response&) {});
+        }
+
+        static void resolve(Response* res, std::function<void(Response&)> fn) {
+            auto run = [res, fn = std::move(fn)]() {
+                try {
+                    fn(*res);
+                } catch (...) {
+                }
+
+                try {
+                    if (!res->isSent()) {
+                        res->keepAlive(false);
+                        res->internalServerError();
+                    }
+                } catch (...) {
+                }
+
+                res->complete();
+            };
+
+            res->whenReturned([res, run = std::move(run)]() {
+                #ifndef _WIN32
+                    if (EventLoop* loop = res->conn_.loop) {
+                        loop->post(run);
+                        return;
+                    }
+                #endif
+                run();
+            });
+        }
+    };
+
+    Response::Deferred Response::defer() {
+        detach();
+
+        Deferred deferred;
+        deferred.state = std::make_shared<Deferred::State>();
+        deferred.state->res = this;
+        return deferred;
+    }
+
+    void Response::Deferred::resolve(std::function<void(Response&)> fn) const {
+        if (!state || state->resolved.exchange(true)) return;
+        State::resolve(state->res, std::move(fn));
+    }
+
+    void Response::Deferred::send(std::string body) const {
+        resolve([body = std::move(body)](Response& res) { res.send(body); });
+    }
+
+    void Response::Deferred::json(nlohmann::json data) const {
+        resolve([data = std::move(data)](Response& res) { res.json(data); });
+    }
+
+    void Response::whenReturned(std::function<void()> fn) {
+        {
+            std::lock_guard<std::mutex> lock(returnMutex_);
+            if (!returned_) {
+                onReturn_.push_back(std::move(fn));
+                return;
+            }
+        }
+        fn();
+    }
+
+    // Whatever was held back keeps the response detached, so it can only
+    // complete after the state has moved to HANDED_OFF.
+    bool Response::handOff(std::function<void()> onComplete) {
+        onComplete_ = std::move(onComplete);
+
+        State expected = State::DETACHED;
+        bool handedOff = state_.compare_exchange_strong(expected, State::HANDED_OFF);
+
+        std::vector<std::function<void()>> pending;
+        {
+            std::lock_guard<std::mutex> lock(returnMutex_);
+            returned_ = true;
+            pending.swap(onReturn_);
+        }
+        for (auto& fn : pending)
+            fn();
+
+        return handedOff;
+    }
+
+    void Response::markSent(HttpStatus status) {
+        status_ = status;
+        sent_ = true;
+    }
+
+    uint64_t Response::bytesOut() const {
+        return sink_ ? sink_->bytesOut() : conn_.bytesOut;
+    }
+
+    bool Response::isSent() const {
+        return sent_;
+    }
+
+    void Response::sendError(HttpStatus status, const std::string& message) {
+        setStatus(status);
+        json({{"error", message}});
+    }
+    
+    void Response::sendPrepared(const PreparedResponse& prepared) {
+        if (sent_) return;
+
+        status_ = prepared.status();
+        if (prepared.closesConnection())
+            keepAlive_ = false;
+
+        if (capture_)
+            capture_->assign(prepared.bytes());
+
+        if (sink_) {
+            sink_->respond(status_, prepared.headers(), prepared.body());
+            sent_ = true;
+            return;
+        }
+
+        prepared.queueTo(conn_, keepAlive_);
+        flush();
+        sent_ = true;
+    }
+
+    void Response::serialize(HttpStatus status,
+                             const Headers& headers,
+                             const std::string& body,
+                             std::string& out,
+                             std::string_view connection)
+    {
+        out.clear();
+        out.append(statusLine(status));
+        appendHeaders(headers, body.size(), out, connection);
+        out.append(body);
+    }
+
+    void Response::appendHeaders(const Headers& headers,
+                                 size_t contentLength,
+                                 std::string& out,
+                                 std::string_view connection)
+    {
+        if (!connection.empty()) {
+            out.append("Connection: ");
+            out.append(connection);
+            out.append("\r\n");
+        }
+
+        if (headers.find("Date") == headers.end()) {
+            out.append("Date: ");
+            out.append(httpDate());
+            out.append("\r\n");
+        }
+
+        for (const auto& [key, value] : headers) {
+            out.append(key);
+            out.append(": ");
+            out.append(value);
+            out.append("\r\n");
+        }
+
+        char length[24];
+        auto [end, ec] = std::to_chars(length, length + sizeof(length), contentLength);
+        (void)ec;
+
+        out.append("Content-Length: ");
+        out.append(length, end);
+        out.append("\r\n\r\n");
+    }
+
+    void Response::flush()
+    {
+        #ifndef _WIN32
+            // On the event loop (a deferred or coroutine response) a slow
+            // client must not hold up the others: send what the socket
+            // takes and keep the rest, which resume() writes once the
+            // response completes.
+            if (conn_.loop && conn_.loop->inLoopThread()) {
+                if (!conn_.flushSome())
+                    throw std::runtime_error("Socket send failed");
+                conn_.retainQueued();
+                return;
+            }
+        #endif
+
+        if (!conn_.flush())
+            throw std::runtime_error("Socket send failed");
+    }
+}
\ No newline at end of file
@@ -0,0 +1,250 @@
+#include "http/WebSocketFrame.h"
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+    #include <immintrin.h>
+#elif defined(__ARM_NEON)
+    #include <arm_neon.h>
+#endif
+
+namespace mini_http {
+    static constexpr size_t MAX_CONTROL_PAYLOAD = 125;
+
+    size_t parseWebSocketFrame(char* data, size_t len, size_t maxPayload,
+                            WebSocketFrame& frame)
+    {
+        if (len < 2) return 0;
+
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+        uint8_t opcode = bytes[0] & 0x0F;
+
+        if (bytes[0] & 0x70)
+            throw WebSocketError(WebSocketClose::PROTOCOL_ERROR, "Reserved bits set");
+        if (!(bytes[1] & 0x80))
+            throw WebSocketError(WebSocketClose::PROTOCOL_ERROR, "Unmasked client frame");
+
+        bool control = opcode & 0x08;
+        if ((opcode > 0x2 && opcode < 0x8) || opcode > 0xA)
+            throw WebSocketError(WebSocketClose::PROTOCOL_ERROR, "Unknown opcode");
+
+        size_t header = 2;
+        uint64_t length = bytes[1] & 0x7F;
+
+        if (length == 126) {
+            if (len < 4) return 0;
+            length = (uint64_t(bytes[2]) << 8) | bytes[3];
+            header = 4;
+        } else if (length == 127) {
+            if (len < 10) return 0;
+            length = 0;
+            for (int i = 2; i < 10; ++i)
+                length = (length << 8) | bytes[i];
+            header = 10;
+        }
+
+        if (control && (length > MAX_CONTROL_PAYLOAD || !(bytes[0] & 0x80)))
+            throw WebSocketError(WebSocketClose::PROTOCOL_ERROR, "Invalid control frame");
+        if (length > maxPayload)
+            throw WebSocketError(WebSocketClose::TOO_BIG, "Frame too large");
+
+        if (len < header + 4 + length) return 0;
+
+        uint8_t key[4];
+        std::memcpy(key, data + header, 4);
+        char* payload = data + header + 4;
+        unmaskWebSocket(payload, static_cast<size_t>(length), key);
+
+        frame.fin = bytes[0] & 0x80;
+        frame.opcode = static_cast<WebSocketOpcode>(opcode);
+        frame.payload = std::string_view(payload, static_cast<size_t>(length));
+        return header + 4 + static_cast<size_t>(length);
+    }
+
+    void unmaskWebSocket(char* data, size_t len, const uint8_t key[4]) {
+        size_t i = 0;
+
+        // Every step is a multiple of 4 bytes, so the key stays aligned to i.
+        #if defined(__AVX2__)
+            int32_t word;
+            std::memcpy(&word, key, 4);
+            __m256i mask32 = _mm256_set1_epi32(word);
+            for (; i + 32 <= len; i += 32) {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(data + i), _mm256_xor_si256(v, mask32));
+            }
+        #endif
+        #if defined(__SSE2__)
+            int32_t word16;
+            std::memcpy(&word16, key, 4);
+            __m128i mask16 = _mm_set1_epi32(word16);
+            for (; i + 16 <= len; i += 16) {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), _mm_xor_si128(v, mask16));
+            }
+        #elif defined(__ARM_NEON)
+            uint32_t word16;
+            std::memcpy(&word16, key, 4);
+            uint8x16_t mask16 = vreinterpretq_u8_u32(vdupq_n_u32(word16));
+            for (; i + 16 <= len; i += 16) {
+                uint8_t* p = reinterpret_cast<uint8_t*>(data + i);
+                vst1q_u8(p, veorq_u8(vld1q_u8(p), mask16));
+            }
+        #endif
+
+        uint64_t mask8;
+        std::memcpy(&mask8, key, 4);
+        std::memcpy(reinterpret_cast<char*>(&mask8) + 4, key, 4);
+        for (; i + 8 <= len; i += 8) {
+            uint64_t v;
+            std::memcpy(&v, data + i, 8);
+            v ^= mask8;
+            std::memcpy(data + i, &v, 8);
+        }
+
+        for (; i < len; ++i)
+            data[i] = static_cast<char>(data[i] ^ key[i & 3]);
+    }
+
+    bool validUtf8(std::string_view data) {
+        const auto* p = reinterpret_cast<const unsigned char*>(data.data());
+        size_t len = data.size();
+        size_t i = 0;
+
+        while (i < len) {
+            if (i + 8 <= len) {
+                uint64_t word;
+                std::memcpy(&word, p + i, 8);
+                if ((word & 0x8080808080808080ULL) == 0) {
+                    i += 8;
+                    continue;
+                }
+            }
+
+            unsigned char c = p[i];
+            if (c < 0x80) {
+                ++i;
+                continue;
+            }
+
+            // Lead byte: sequence length and the range of the second byte,
+            // which rules out overlong forms, surrogates and > U+10FFFF.
+            size_t n;
+            unsigned char lo = 0x80, hi = 0xBF;
+            if (c >= 0xC2 && c <= 0xDF) n = 2;
+            else if (c == 0xE0) { n = 3; lo = 0xA0; }
+            else if (c == 0xED) { n = 3; hi = 0x9F; }
+            else if (c >= 0xE1 && c <= 0xEF) n = 3;
+            else if (c == 0xF0) { n = 4; lo = 0x90; }
+            else if (c == 0xF4) { n = 4; hi = 0x8F; }
+            else if (c >= 0xF1 && c <= 0xF3) n = 4;
+            else return false;
+
+            if (len - i < n) return false;
+            if (p[i + 1] < lo || p[i + 1] > hi) return false;
+            for (size_t k = 2; k < n; ++k)
+                if ((p[i + k] & 0xC0) != 0x80) return false;
+            i += n;
+        }
+
+        return true;
+    }
+
+    bool validCloseCode(uint16_t code) {
+        if (code >= 3000 && code <= 4999) return true;
+        if (code < 1000 || code > 1014) return false;
+        return code != 1004 && code != WebSocketClose::NO_STATUS && code != WebSocketClose::ABNORMAL;
+    }
+
+    void appendWebSocketHeader(std::string& out, WebSocketOpcode opcode,
+                            size_t payloadLength, bool fin)
+    {
+        out.push_back(static_cast<char>((fin ? 0x80 : 0) | static_cast<uint8_t>(opcode)));
+
+        if (payloadLength < 126) {
+            out.push_back(static_cast<char>(payloadLength));
+        } else if (payloadLength <= 0xFFFF) {
+            out.push_back(static_cast<char>(126));
+            out.push_back(static_cast<char>(payloadLength >> 8));
+            out.push_back(static_cast<char>(payloadLength & 0xFF));
+        } else {
+            out.push_back(static_cast<char>(127));
+            for (int shift = 56; shift >= 0; shift -= 8)
+                out.push_back(static_cast<char>((static_cast<uint64_t>(payloadLength) >> shift) & 0xFF));
+        }
+    }
+
+    // SHA-1 as specified in RFC 3174; only used for the handshake.
+    static void sha1(const std::string& message, uint8_t digest[20]) {
+        uint32_t h[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+
+        std::string data = message;
+        uint64_t bits = static_cast<uint64_t>(message.size()) * 8;
+        data.push_back(static_cast<char>(0x80));
+        while (data.size() % 64 != 56)
+            data.push_back('\0');
+        for (int shift = 56; shift >= 0; shift -= 8)
+            data.push_back(static_cast<char>((bits >> shift) & 0xFF));
+
+        auto rotl = [](uint32_t x, int n) { return (x << n) | (x >> (32 - n)); };
+
+        for (size_t chunk = 0; chunk < data.size(); chunk += 64) {
+            uint32_t w[80];
+            for (int i = 0; i < 16; ++i) {
+                const uint8_t* p = reinterpret_cast<const uint8_t*>(data.data() + chunk + i * 4);
+                w[i] = (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+            }
+            for (int i = 16; i < 80; ++i)
+                w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+            uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+
+            for (int i = 0; i < 80; ++i) {
+                uint32_t f, k;
+                if (i < 20)      { f = (b & c) | (~b & d);          k = 0x5A827999; }
+                else if (i < 40) { f = b ^ c ^ d;                   k = 0x6ED9EBA1; }
+                else if (i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8F1BBCDC; }
+                else             { f = b ^ c ^ d;                   k = 0xCA62C1D6; }
+
+                uint32_t temp = rotl(a, 5) + f + e + k + w[i];
+                e = d;
+                d = c;
+                c = rotl(b, 30);
+                b = a;
+                a = temp;
+            }
+
+            h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+        }
+
+        for (int i = 0; i < 5; ++i) {
+            digest[i * 4]     = static_cast<uint8_t>(h[i] >> 24);
+            digest[i * 4 + 1] = static_cast<uint8_t>(h[i] >> 16);
+            digest[i * 4 + 2] = static_cast<uint8_t>(h[i] >> 8);
+            digest[i * 4 + 3] = static_cast<uint8_t>(h[i]);
+        }
+    }
+
+    static std::string base64(const uint8_t* data, size_t len) {
+        static const char alphabet[] =
+            "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+        std::string out;
+        for (size_t i = 0; i < len; i += 3) {
+            uint32_t n = uint32_t(data[i]) << 16;
+            if (i + 1 < len) n |= uint32_t(data[i + 1]) << 8;
+            if (i + 2 < len) n |= data[i + 2];
+
+            out.push_back(alphabet[(n >> 18) & 63]);
+            out.push_back(alphabet[(n >> 12) & 63]);
+            out.push_back(i + 1 < len ? alphabet[(n >> 6) & 63] : '=');
+            out.push_back(i + 2 < len ? alphabet[n & 63] : '=');
+        }
+        return out;
+    }
+
+    std::string webSocketAccept(std::string_view key) {
+        uint8_t digest[20];
+        sha1(std::string(key) + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11", digest);
+        return base64(digest, sizeof(digest));
+    }
+}
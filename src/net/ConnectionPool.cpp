@@ -0,0 +1,57 @@
+#include "net/ConnectionPool.h"
+
+namespace mini_http {
+    ConnectionPool::ConnectionPool(size_t capacity,
+                                   size_t bufferSize,
+                                   size_t maxRetained)
+        : capacity(capacity),
+        bufferSize(bufferSize),
+        maxRetained(maxRetained)
+    {
+        freeList.reserve(capacity);
+    }
+
+    void ConnectionPool::prewarm() {
+        std::lock_guard<std::mutex> lock(mtx);
+
+        while (freeList.size() < capacity) {
+            auto conn = std::make_unique<Connection>();
+            conn->recycle(bufferSize, maxRetained);
+
+            conn->readBuffer.resize(bufferSize);
+            conn->readBuffer.clear();
+            conn->writeBuffer.resize(bufferSize);
+            conn->writeBuffer.clear();
+
+            freeList.push_back(std::move(conn));
+        }
+    }
+
+    Connection* ConnectionPool::acquire(socket_t fd) {
+        std::unique_ptr<Connection> conn;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (!freeList.empty()) {
+                conn = std::move(freeList.back());
+                freeList.pop_back();
+            }
+        }
+
+        if (!conn) {
+            conn = std::make_unique<Connection>();
+            conn->recycle(bufferSize, maxRetained);
+        }
+
+        conn->reset(fd);
+        return conn.release();
+    }
+
+    void ConnectionPool::release(Connection* conn) {
+        std::unique_ptr<Connection> owned(conn);
+        owned->recycle(bufferSize, maxRetained);
+
+        std::lock_guard<std::mutex> lock(mtx);
+        if (freeList.size() < capacity)
+            freeList.push_back(std::move(owned));
+    }
+}
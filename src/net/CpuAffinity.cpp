@@ -0,0 +1,83 @@
+#include "net/CpuAffinity.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#ifdef __linux__
+    #include <pthread.h>
+    #include <sched.h>
+#endif
+
+namespace mini_http {
+    // Parses a kernel cpulist such as "0-3,8,10-11".
+    static CpuSet parseCpuList(const std::string& list) {
+        CpuSet cpus;
+        size_t pos = 0;
+
+        while (pos < list.size()) {
+            size_t end = list.find(',', pos);
+            if (end == std::string::npos) end = list.size();
+
+            std::string range = list.substr(pos, end - pos);
+            size_t dash = range.find('-');
+
+            if (!range.empty() && range[0] >= '0' && range[0] <= '9') {
+                int first = std::atoi(range.c_str());
+                int last = dash == std::string::npos ? first : std::atoi(range.c_str() + dash + 1);
+                for (int cpu = first; cpu <= last; ++cpu)
+                    cpus.push_back(cpu);
+            }
+
+            pos = end + 1;
+        }
+
+        return cpus;
+    }
+
+    std::vector<CpuSet> numaNodes() {
+        std::vector<CpuSet> nodes;
+
+        #ifdef __linux__
+            for (int node = 0; ; ++node) {
+                std::ifstream in("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+                if (!in) break;
+
+                std::string list;
+                std::getline(in, list);
+
+                CpuSet cpus = parseCpuList(list);
+                if (!cpus.empty())
+                    nodes.push_back(std::move(cpus));
+            }
+        #endif
+
+        if (nodes.empty()) {
+            CpuSet all;
+            unsigned count = std::thread::hardware_concurrency();
+            for (unsigned cpu = 0; cpu < (count ? count : 1); ++cpu)
+                all.push_back(static_cast<int>(cpu));
+            nodes.push_back(std::move(all));
+        }
+
+        return nodes;
+    }
+
+    bool pinCurrentThread(const CpuSet& cpus) {
+        #ifdef __linux__
+            if (cpus.empty()) return false;
+
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            for (int cpu : cpus)
+                if (cpu >= 0 && cpu < CPU_SETSIZE)
+                    CPU_SET(cpu, &set);
+
+            return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+        #else
+            (void)cpus;
+            return false;
+        #endif
+    }
+}
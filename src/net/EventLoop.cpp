@@ -0,0 +1,244 @@
+#ifndef _WIN32
+
+#include "net/EventLoop.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+#ifdef __linux__
+    #include <sys/epoll.h>
+    #include <sys/eventfd.h>
+#else
+    #include <fcntl.h>
+    #include <poll.h>
+#endif
+
+namespace mini_http {
+    EventLoop::EventLoop() : owner(std::this_thread::get_id()) {
+        #ifdef __linux__
+            epollFd = epoll_create1(EPOLL_CLOEXEC);
+            wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (epollFd < 0 || wakeFd < 0)
+                throw std::runtime_error("Failed to create event loop");
+
+            epoll_event ev {};
+            ev.events = EPOLLIN;
+            ev.data.fd = wakeFd;
+            epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev);
+        #else
+            if (pipe(wakePipe) != 0)
+                throw std::runtime_error("Failed to create event loop");
+            for (int fd : wakePipe) {
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+                fcntl(fd, F_SETFD, FD_CLOEXEC);
+            }
+        #endif
+    }
+
+    EventLoop::~EventLoop() {
+        for (Posted* node = posted.exchange(nullptr); node; ) {
+            Posted* next = node->next;
+            delete node;
+            node = next;
+        }
+
+        #ifdef __linux__
+            ::close(epollFd);
+            ::close(wakeFd);
+        #else
+            ::close(wakePipe[0]);
+            ::close(wakePipe[1]);
+        #endif
+    }
+
+    void EventLoop::run() {
+        owner = std::this_thread::get_id();
+        running = true;
+
+        #ifdef __linux__
+            epoll_event events[64];
+        #else
+            std::vector<pollfd> fds;
+        #endif
+
+        while (true) {
+            runPosted();
+            if (!running) break;
+
+            #ifdef __linux__
+                int ready = epoll_wait(epollFd, events, 64, nextTimeout());
+                if (ready < 0 && errno != EINTR)
+                    throw std::runtime_error(std::string("epoll_wait failed: ") + strerror(errno));
+
+                for (int i = 0; i < ready; ++i) {
+                    if (events[i].data.fd == wakeFd) {
+                        uint64_t count;
+                        while (::read(wakeFd, &count, sizeof(count)) > 0) {}
+                        continue;
+                    }
+
+                    int interest = 0;
+                    if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) interest |= READABLE;
+                    if (events[i].events & (EPOLLOUT | EPOLLHUP | EPOLLERR)) interest |= WRITABLE;
+                    dispatch(events[i].data.fd, interest);
+                }
+            #else
+                fds.clear();
+                fds.push_back({ wakePipe[0], POLLIN, 0 });
+                for (const auto& [fd, watch] : watches) {
+                    short events = 0;
+                    if (watch.interest & READABLE) events |= POLLIN;
+                    if (watch.interest & WRITABLE) events |= POLLOUT;
+                    fds.push_back({ fd, events, 0 });
+                }
+
+                int ready = ::poll(fds.data(), fds.size(), nextTimeout());
+                if (ready < 0 && errno != EINTR)
+                    throw std::runtime_error(std::string("poll failed: ") + strerror(errno));
+
+                if (ready > 0) {
+                    if (fds[0].revents) {
+                        char buffer[64];
+                        while (::read(wakePipe[0], buffer, sizeof(buffer)) > 0) {}
+                    }
+
+                    for (size_t i = 1; i < fds.size(); ++i) {
+                        int interest = 0;
+                        if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) interest |= READABLE;
+                        if (fds[i].revents & (POLLOUT | POLLHUP | POLLERR)) interest |= WRITABLE;
+                        if (interest) dispatch(fds[i].fd, interest);
+                    }
+                }
+            #endif
+
+            runTimers();
+        }
+    }
+
+    void EventLoop::stop() {
+        post([this]() { running = false; });
+    }
+
+    void EventLoop::post(Callback fn) {
+        Posted* node = new Posted { std::move(fn), nullptr };
+        Posted* head = posted.load(std::memory_order_relaxed);
+
+        do {
+            node->next = head;
+        } while (!posted.compare_exchange_weak(head, node,
+                    std::memory_order_release, std::memory_order_relaxed));
+
+        // A non-empty stack has already woken the loop, which has yet to
+        // take it.
+        if (!head)
+            wake();
+    }
+
+    void EventLoop::watch(socket_t fd, int interest, Callback fn, bool persistent) {
+        bool known = watches.count(fd) != 0;
+        watches[fd] = Watch { interest, persistent, std::move(fn) };
+
+        #ifdef __linux__
+            epoll_event ev {};
+            ev.events = (interest & READABLE ? EPOLLIN : 0u) | (interest & WRITABLE ? EPOLLOUT : 0u);
+            ev.data.fd = fd;
+            if (epoll_ctl(epollFd, known ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &ev) != 0 && known)
+                epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+        #else
+            (void)known;
+        #endif
+    }
+
+    void EventLoop::unwatch(socket_t fd) {
+        if (watches.erase(fd) == 0) return;
+
+        #ifdef __linux__
+            epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+        #endif
+    }
+
+    EventLoop::TimerId EventLoop::after(std::chrono::milliseconds delay, Callback fn) {
+        TimerId id = nextTimer++;
+        timers.emplace(id, std::move(fn));
+        timerQueue.push({ std::chrono::steady_clock::now() + delay, id });
+        return id;
+    }
+
+    void EventLoop::cancel(TimerId timer) {
+        timers.erase(timer);
+    }
+
+    int EventLoop::nextTimeout() {
+        while (!timerQueue.empty() && timers.count(timerQueue.top().id) == 0)
+            timerQueue.pop();
+
+        if (timerQueue.empty()) return -1;
+
+        auto wait = std::chrono::ceil<std::chrono::milliseconds>(
+            timerQueue.top().deadline - std::chrono::steady_clock::now());
+        return static_cast<int>(std::max<int64_t>(wait.count(), 0));
+    }
+
+    void EventLoop::runTimers() {
+        auto now = std::chrono::steady_clock::now();
+
+        while (!timerQueue.empty() && timerQueue.top().deadline <= now) {
+            TimerId id = timerQueue.top().id;
+            timerQueue.pop();
+
+            auto it = timers.find(id);
+            if (it == timers.end()) continue;
+
+            Callback fn = std::move(it->second);
+            timers.erase(it);
+            fn();
+        }
+    }
+
+    void EventLoop::runPosted() {
+        Posted* node = posted.exchange(nullptr, std::memory_order_acquire);
+
+        Posted* ordered = nullptr;
+        while (node) {
+            Posted* next = node->next;
+            node->next = ordered;
+            ordered = node;
+            node = next;
+        }
+
+        while (ordered) {
+            std::unique_ptr<Posted> current(ordered);
+            ordered = ordered->next;
+            current->fn();
+        }
+    }
+
+    void EventLoop::dispatch(socket_t fd, int ready) {
+        auto it = watches.find(fd);
+        if (it == watches.end() || !(it->second.interest & ready)) return;
+
+        if (it->second.persistent) {
+            Callback fn = it->second.fn;
+            fn();
+            return;
+        }
+
+        Callback fn = std::move(it->second.fn);
+        unwatch(fd);
+        fn();
+    }
+
+    void EventLoop::wake() {
+        #ifdef __linux__
+            uint64_t one = 1;
+            (void)::write(wakeFd, &one, sizeof(one));
+        #else
+            char byte = 1;
+            (void)::write(wakePipe[1], &byte, 1);
+        #endif
+    }
+}
+#endif
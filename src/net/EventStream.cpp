@@ -0,0 +1,318 @@
+#ifndef _WIN32
+
+#include "net/EventStream.h"
+#include "http/Request.h"
+#include "http/Response.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+
+namespace mini_http {
+    static const Connection::Buffer HEARTBEAT = std::make_shared<const std::string>(":\n\n");
+
+    EventStreamHub::EventStreamHub(EventStreamHandlers handlers)
+        : handlers(std::move(handlers))
+    {
+    }
+
+    void EventStreamHub::accept(Request& req, Response& res,
+                                std::function<void(Connection*)> release)
+    {
+        auto lastId = req.headers.find("last-event-id");
+
+        res.setHeader("Content-Type", "text/event-stream");
+        res.setHeader("Cache-Control", "no-cache");
+        res.setHeader("X-Accel-Buffering", "no");
+
+        res.stream([this, params = req.params,
+                    lastEventId = lastId == req.headers.end() ? std::string() : lastId->second,
+                    release = std::move(release)](Connection& conn) mutable {
+            if (!conn.loop) {
+                release(&conn);
+                return;
+            }
+
+            auto stream = std::make_shared<EventStream>(*this, conn, std::move(params),
+                                                        std::move(lastEventId), std::move(release));
+            conn.loop->post([stream]() { stream->start(); });
+        });
+    }
+
+    Connection::Buffer EventStreamHub::encode(std::string_view data,
+                                            std::string_view event,
+                                            std::string_view id)
+    {
+        // A line break would start another field, or another event, in
+        // every subscriber's stream; clients ignore ids containing NUL.
+        static constexpr std::string_view BREAKS("\r\n\0", 3);
+        if (id.find_first_of(BREAKS) != std::string_view::npos)
+            throw std::invalid_argument("SSE event id contains CR, LF or NUL");
+        if (event.find_first_of(BREAKS) != std::string_view::npos)
+            throw std::invalid_argument("SSE event name contains CR, LF or NUL");
+
+        auto bytes = std::make_shared<std::string>();
+        bytes->reserve(data.size() + event.size() + id.size() + 24);
+
+        if (!id.empty()) {
+            bytes->append("id: ");
+            bytes->append(id);
+            bytes->push_back('\n');
+        }
+        if (!event.empty()) {
+            bytes->append("event: ");
+            bytes->append(event);
+            bytes->push_back('\n');
+        }
+
+        // CRLF, LF and a lone CR all end a line of data.
+        size_t pos = 0;
+        do {
+            size_t end = data.find_first_of("\r\n", pos);
+            if (end == std::string_view::npos) end = data.size();
+
+            bytes->append("data: ");
+            bytes->append(data.substr(pos, end - pos));
+            bytes->push_back('\n');
+
+            if (end + 1 < data.size() && data[end] == '\r' && data[end + 1] == '\n')
+                ++end;
+            pos = end + 1;
+        } while (pos <= data.size());
+
+        bytes->push_back('\n');
+        return bytes;
+    }
+
+    void EventStreamHub::publish(const std::string& topic, std::string_view data,
+                                std::string_view event, std::string_view id)
+    {
+        EventLoop* target = loop.load();
+        if (!target || count.load() == 0) return;
+
+        auto fanOut = [this, topic, bytes = encode(data, event, id)]() {
+            auto it = topics.find(topic);
+            if (it == topics.end()) return;
+
+            for (EventStream* stream : it->second)
+                stream->enqueue(bytes);
+            scheduleFlush();
+        };
+
+        if (target->inLoopThread())
+            fanOut();
+        else
+            target->post(std::move(fanOut));
+    }
+
+    void EventStreamHub::scheduleFlush() {
+        if (flushScheduled) return;
+        flushScheduled = true;
+        loop.load()->post([this]() { flushAll(); });
+    }
+
+    void EventStreamHub::flushAll() {
+        flushScheduled = false;
+        for (auto& stream : streams)
+            if (!stream->closed && stream->conn.hasQueued())
+                stream->flush();
+    }
+
+    // One timer for the whole hub: streams that sent nothing since the
+    // previous tick get the shared heartbeat comment.
+    void EventStreamHub::heartbeat() {
+        if (streams.empty()) {
+            heartbeatArmed = false;
+            return;
+        }
+
+        for (auto& stream : streams) {
+            if (!stream->active && !stream->closed)
+                stream->enqueue(HEARTBEAT);
+            stream->active = false;
+        }
+        flushAll();
+
+        loop.load()->after(handlers.heartbeat, [this]() { heartbeat(); });
+    }
+
+    void EventStreamHub::add(const std::shared_ptr<EventStream>& stream) {
+        loop.store(&stream->loop);
+        stream->index = streams.size();
+        streams.push_back(stream);
+        count.fetch_add(1);
+
+        if (!heartbeatArmed && handlers.heartbeat.count() > 0) {
+            heartbeatArmed = true;
+            stream->loop.after(handlers.heartbeat, [this]() { heartbeat(); });
+        }
+    }
+
+    void EventStreamHub::remove(EventStream& stream) {
+        for (const std::string& topic : stream.topics)
+            unsubscribe(stream, topic);
+        stream.topics.clear();
+
+        size_t index = stream.index;
+        if (index >= streams.size() || streams[index].get() != &stream) return;
+
+        std::swap(streams[index], streams.back());
+        streams[index]->index = index;
+        streams.pop_back();
+        count.fetch_sub(1);
+    }
+
+    void EventStreamHub::subscribe(EventStream& stream, const std::string& topic) {
+        if (std::find(stream.topics.begin(), stream.topics.end(), topic) != stream.topics.end())
+            return;
+
+        stream.topics.push_back(topic);
+        topics[topic].push_back(&stream);
+    }
+
+    void EventStreamHub::unsubscribe(EventStream& stream, const std::string& topic) {
+        auto it = topics.find(topic);
+        if (it == topics.end()) return;
+
+        auto& subscribers = it->second;
+        auto found = std::find(subscribers.begin(), subscribers.end(), &stream);
+        if (found != subscribers.end()) {
+            *found = subscribers.back();
+            subscribers.pop_back();
+        }
+        if (subscribers.empty())
+            topics.erase(it);
+    }
+
+    EventStream::EventStream(EventStreamHub& hub, Connection& conn, Params params,
+                            std::string lastEventId, std::function<void(Connection*)> release)
+        : hub(hub),
+        conn(conn),
+        loop(*conn.loop),
+        params_(std::move(params)),
+        lastEventId_(std::move(lastEventId)),
+        release(std::move(release))
+    {
+    }
+
+    void EventStream::start() {
+        hub.add(shared_from_this());
+        watch(false);
+
+        try {
+            if (hub.handlers.open)
+                hub.handlers.open(*this);
+        } catch (...) {
+            terminate();
+        }
+    }
+
+    void EventStream::inLoop(std::function<void()> fn) {
+        if (loop.inLoopThread())
+            fn();
+        else
+            loop.post(std::move(fn));
+    }
+
+    void EventStream::subscribe(const std::string& topic) {
+        inLoop([self = shared_from_this(), topic]() {
+            if (!self->closed)
+                self->hub.subscribe(*self, topic);
+        });
+    }
+
+    void EventStream::unsubscribe(const std::string& topic) {
+        inLoop([self = shared_from_this(), topic]() {
+            auto& topics = self->topics;
+            auto it = std::find(topics.begin(), topics.end(), topic);
+            if (it == topics.end()) return;
+
+            topics.erase(it);
+            self->hub.unsubscribe(*self, topic);
+        });
+    }
+
+    void EventStream::send(std::string_view data, std::string_view event, std::string_view id) {
+        inLoop([self = shared_from_this(), bytes = EventStreamHub::encode(data, event, id)]() {
+            if (self->closed) return;
+            self->enqueue(bytes);
+            self->flush();
+        });
+    }
+
+    void EventStream::close() {
+        inLoop([self = shared_from_this()]() { self->terminate(); });
+    }
+
+    // Clients never send on an event stream; readable means closed or reset.
+    void EventStream::onReady() {
+        if (conn.hasQueued()) {
+            flush();
+            if (closed) return;
+        }
+
+        char buffer[512];
+        while (true) {
+            ssize_t n = ::recv(conn.raw(), buffer, sizeof(buffer), 0);
+            if (n > 0) continue;
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+
+            terminate();
+            return;
+        }
+    }
+
+    void EventStream::enqueue(Connection::Buffer event) {
+        if (closed) return;
+
+        conn.queue(std::move(event));
+        active = true;
+
+        if (conn.queuedBytes() > hub.handlers.maxBufferedBytes)
+            terminate();
+    }
+
+    void EventStream::flush() {
+        if (closed) return;
+
+        if (!conn.flushSome()) {
+            terminate();
+            return;
+        }
+
+        if (watchingWritable != conn.hasQueued())
+            watch(conn.hasQueued());
+    }
+
+    void EventStream::watch(bool writable) {
+        int interest = EventLoop::READABLE;
+        if (writable) interest |= EventLoop::WRITABLE;
+
+        watchingWritable = writable;
+        loop.watch(conn.raw(), interest, [self = shared_from_this()]() { self->onReady(); }, true);
+    }
+
+    // As for WebSocket: unregistering and releasing wait for a later loop
+    // pass, so fan-out loops over the hub stay valid.
+    void EventStream::terminate() {
+        if (closed) return;
+        closed = true;
+        loop.unwatch(conn.raw());
+
+        loop.post([self = shared_from_this()]() {
+            self->hub.remove(*self);
+            self->conn.discardQueue();
+
+            try {
+                if (self->hub.handlers.close)
+                    self->hub.handlers.close(*self);
+            } catch (...) {
+            }
+
+            self->release(&self->conn);
+        });
+    }
+}
+
+#endif
@@ -0,0 +1,860 @@
+#ifndef _WIN32
+
+#include "net/Http2Session.h"
+#include "http/HttpDate.h"
+#include "http/Request.h"
+#include "http/Response.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <optional>
+
+namespace mini_http {
+    static constexpr int READS_PER_WAKEUP = 16;
+
+    // Response bytes buffered in user space before waiting for the socket.
+    static constexpr size_t HIGH_WATER = 256 * 1024;
+
+    static constexpr uint32_t MAX_FRAME_SIZE_LIMIT = 0xFFFFFF;
+
+    // Headers that only mean something to an HTTP/1 connection.
+    static bool connectionSpecific(const std::string& name) {
+        return name == "connection" || name == "keep-alive" || name == "proxy-connection"
+            || name == "transfer-encoding" || name == "upgrade";
+    }
+
+    static std::string decodeBase64Url(std::string_view text) {
+        std::string out;
+        uint32_t bits = 0;
+        int count = 0;
+
+        for (char c : text) {
+            int value;
+            if (c >= 'A' && c <= 'Z') value = c - 'A';
+            else if (c >= 'a' && c <= 'z') value = c - 'a' + 26;
+            else if (c >= '0' && c <= '9') value = c - '0' + 52;
+            else if (c == '-' || c == '+') value = 62;
+            else if (c == '_' || c == '/') value = 63;
+            else if (c == '=') break;
+            else throw Http2Error(Http2ErrorCode::PROTOCOL, "Invalid HTTP2-Settings");
+
+            bits = (bits << 6) | static_cast<uint32_t>(value);
+            count += 6;
+            if (count >= 8) {
+                count -= 8;
+                out.push_back(static_cast<char>((bits >> count) & 0xFF));
+            }
+        }
+        return out;
+    }
+
+    struct Http2Session::Stream : Response::Sink {
+        uint32_t id = 0;
+        Request req;
+        std::optional<Response> res;
+
+        // Written by whichever thread sends the response; read on the loop
+        // once the handler's done callback has arrived there.
+        HeaderList headers;
+        std::string body;
+        bool refused = false;
+
+        // Loop thread only.
+        bool receiving = true;
+        bool running = false;
+        bool sending = false;
+        bool queued = false;
+        bool reset = false;
+        int64_t sendWindow = 0;
+        int64_t receiveWindow = 0;
+        size_t sent = 0;
+
+        void respond(HttpStatus status, const Response::Headers& fields,
+                    std::string_view content) override
+        {
+            headers.clear();
+            headers.push_back({ ":status", std::to_string(static_cast<int>(status)) });
+
+            bool hasDate = false;
+            for (const auto& [key, value] : fields) {
+                std::string name = key;
+                std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) {
+                    return static_cast<char>(std::tolower(c));
+                });
+
+                if (connectionSpecific(name) || name == "content-length") continue;
+                if (name == "date") hasDate = true;
+                headers.push_back({ std::move(name), value });
+            }
+
+            if (!hasDate)
+                headers.push_back({ "date", httpDate() });
+            headers.push_back({ "content-length", std::to_string(content.size()) });
+
+            if (req.method != HttpMethod::HEAD)
+                body.assign(content);
+        }
+
+        void refuseTakeover() override { refused = true; }
+
+        // Fields counted as "name: value\r\n", plus the body. The HPACK
+        // size is only known once the loop frames the response.
+        uint64_t bytesOut() const override {
+            uint64_t size = body.size();
+            for (const auto& field : headers)
+                size += field.name.size() + field.value.size() + 4;
+            return size;
+        }
+    };
+
+    Http2Session::Http2Session(Connection& conn, const Http2Options& options,
+                            std::chrono::milliseconds idleTimeout, Executor execute,
+                            Handler handler, std::function<void(Connection*)> release)
+        : conn(conn),
+        loop(*conn.loop),
+        options(options),
+        idleTimeout(idleTimeout),
+        execute(std::move(execute)),
+        handler(std::move(handler)),
+        release(std::move(release)),
+        decoder(options.headerTableSize),
+        prefaceLeft(HTTP2_PREFACE.size())
+    {
+        auto& o = this->options;
+        o.initialWindowSize = std::min(o.initialWindowSize, HTTP2_MAX_WINDOW);
+        o.maxFrameSize = std::clamp(o.maxFrameSize, HTTP2_DEFAULT_FRAME_SIZE, MAX_FRAME_SIZE_LIMIT);
+        o.connectionWindowSize = std::clamp(o.connectionWindowSize, HTTP2_DEFAULT_WINDOW, HTTP2_MAX_WINDOW);
+        receiveWindow = o.connectionWindowSize;
+    }
+
+    void Http2Session::start() {
+        // "PRI * HTTP/2.0\r\n\r\n" went through the HTTP/1 parser.
+        prefaceLeft = 6;
+        loop.post([self = shared_from_this()]() { self->begin(); });
+    }
+
+    void Http2Session::start(Request upgraded, const std::string& settings) {
+        loop.post([self = shared_from_this(), req = std::move(upgraded), settings]() mutable {
+            std::string payload;
+            try {
+                payload = decodeBase64Url(settings);
+                if (payload.size() % 6 != 0)
+                    throw Http2Error(Http2ErrorCode::PROTOCOL, "Invalid HTTP2-Settings");
+                self->applySettings(payload);
+            } catch (const Http2Error& e) {
+                self->sendSettings();
+                self->goAway(e.code(), e.what());
+                return;
+            }
+
+            auto stream = std::make_shared<Stream>();
+            stream->id = 1;
+            stream->req = std::move(req);
+            stream->sendWindow = self->peerWindowSize;
+            self->streams.emplace(1, stream);
+            self->lastStreamId = 1;
+
+            self->run(stream);
+            self->begin();
+        });
+    }
+
+    void Http2Session::begin() {
+        sendSettings();
+        watch(false);
+
+        if (streams.empty())
+            armIdleTimer();
+
+        if (!conn.readBuffer.empty())
+            process();
+        else
+            flush();
+    }
+
+    void Http2Session::sendSettings() {
+        std::string payload;
+        auto setting = [&payload](uint16_t id, uint32_t value) {
+            payload.push_back(static_cast<char>(id >> 8));
+            payload.push_back(static_cast<char>(id & 0xFF));
+            appendUint32(payload, value);
+        };
+
+        setting(Http2Setting::ENABLE_PUSH, 0);
+        setting(Http2Setting::MAX_CONCURRENT_STREAMS, options.maxConcurrentStreams);
+        setting(Http2Setting::INITIAL_WINDOW_SIZE, options.initialWindowSize);
+        setting(Http2Setting::MAX_FRAME_SIZE, options.maxFrameSize);
+        setting(Http2Setting::HEADER_TABLE_SIZE, options.headerTableSize);
+        setting(Http2Setting::MAX_HEADER_LIST_SIZE, options.maxHeaderListSize);
+
+        appendHttp2FrameHeader(pending, payload.size(), Http2FrameType::SETTINGS, 0, 0);
+        pending.append(payload);
+
+        if (options.connectionWindowSize > HTTP2_DEFAULT_WINDOW)
+            sendWindowUpdate(0, options.connectionWindowSize - HTTP2_DEFAULT_WINDOW);
+    }
+
+    void Http2Session::sendWindowUpdate(uint32_t streamId, uint32_t increment) {
+        appendHttp2FrameHeader(pending, 4, Http2FrameType::WINDOW_UPDATE, 0, streamId);
+        appendUint32(pending, increment);
+    }
+
+    void Http2Session::onReady() {
+        if (conn.hasQueued()) {
+            flush();
+            if (closed) return;
+        }
+        readAvailable();
+    }
+
+    // Bounded per wakeup like WebSocket reads, so one busy connection
+    // cannot starve the rest of the loop.
+    void Http2Session::readAvailable() {
+        char buffer[16384];
+
+        for (int i = 0; i < READS_PER_WAKEUP; ++i) {
+            ssize_t n = ::recv(conn.raw(), buffer, sizeof(buffer), 0);
+
+            if (n > 0) {
+                conn.bytesIn += static_cast<uint64_t>(n);
+                conn.readBuffer.append(buffer, static_cast<size_t>(n));
+                if (static_cast<size_t>(n) < sizeof(buffer)) break;
+                continue;
+            }
+
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+
+            terminate();
+            return;
+        }
+
+        process();
+    }
+
+    void Http2Session::process() {
+        std::string& buffer = conn.readBuffer;
+        size_t offset = 0;
+
+        try {
+            if (prefaceLeft > 0) {
+                size_t n = std::min(prefaceLeft, buffer.size());
+                std::string_view expected = HTTP2_PREFACE.substr(HTTP2_PREFACE.size() - prefaceLeft, n);
+                if (std::string_view(buffer).substr(0, n) != expected)
+                    throw Http2Error(Http2ErrorCode::PROTOCOL, "Invalid connection preface");
+
+                prefaceLeft -= n;
+                offset = n;
+            }
+
+            while (!closed && prefaceLeft == 0) {
+                Http2Frame frame;
+                size_t used = parseHttp2Frame(buffer.data() + offset, buffer.size() - offset,
+                                            options.maxFrameSize, frame);
+                if (used == 0) break;
+
+                offset += used;
+                try {
+                    handle(frame);
+                } catch (const Http2Error& e) {
+                    if (e.streamId() == 0) throw;
+                    resetStream(e.streamId(), e.code());
+                }
+            }
+        } catch (const Http2Error& e) {
+            goAway(e.code(), e.what());
+        } catch (const HpackError& e) {
+            goAway(Http2ErrorCode::COMPRESSION, e.what());
+        } catch (const std::exception& e) {
+            goAway(Http2ErrorCode::INTERNAL, e.what());
+        }
+
+        if (closed) return;
+        if (offset > 0)
+            buffer.erase(0, offset);
+        flush();
+    }
+
+    void Http2Session::handle(const Http2Frame& frame) {
+        if (continuing && !frame.is(Http2FrameType::CONTINUATION))
+            throw Http2Error(Http2ErrorCode::PROTOCOL, "Expected CONTINUATION");
+
+        switch (static_cast<Http2FrameType>(frame.type)) {
+            case Http2FrameType::DATA:
+                onData(frame);
+                break;
+
+            case Http2FrameType::HEADERS:
+                onHeaders(frame);
+                break;
+
+            case Http2FrameType::CONTINUATION:
+                if (!continuing || frame.streamId != headerStream)
+                    throw Http2Error(Http2ErrorCode::PROTOCOL, "Unexpected CONTINUATION");
+
+                headerBlock.append(frame.payload);
+                if (headerBlock.size() > options.maxHeaderListSize)
+                    throw Http2Error(Http2ErrorCode::ENHANCE_YOUR_CALM, "Header block too large");
+
+                if (frame.has(Http2Flag::END_HEADERS)) {
+                    continuing = false;
+                    onHeaderBlock();
+                }
+                break;
+
+            case Http2FrameType::PRIORITY:
+                if (frame.streamId == 0)
+                    throw Http2Error(Http2ErrorCode::PROTOCOL, "PRIORITY on stream 0");
+                if (frame.payload.size() != 5)
+                    throw Http2Error(Http2ErrorCode::FRAME_SIZE, "Invalid PRIORITY", frame.streamId);
+                break;
+
+            case Http2FrameType::RST_STREAM:
+                onResetStream(frame);
+                break;
+
+            case Http2FrameType::SETTINGS:
+                onSettings(frame);
+                break;
+
+            case Http2FrameType::PUSH_PROMISE:
+                throw Http2Error(Http2ErrorCode::PROTOCOL, "Clients cannot push");
+
+            case Http2FrameType::PING:
+                if (frame.streamId != 0)
+                    throw Http2Error(Http2ErrorCode::PROTOCOL, "PING on a stream");
+                if (frame.payload.size() != 8)
+                    throw Http2Error(Http2ErrorCode::FRAME_SIZE, "Invalid PING");
+
+                if (!frame.has(Http2Flag::ACK)) {
+                    appendHttp2FrameHeader(pending, 8, Http2FrameType::PING, Http2Flag::ACK, 0);
+                    pending.append(frame.payload);
+                }
+                break;
+
+            case Http2FrameType::GOAWAY:
+                if (frame.streamId != 0)
+                    throw Http2Error(Http2ErrorCode::PROTOCOL, "GOAWAY on a stream");
+
+                // No new streams will come; finish the open ones, then close.
+                goingAway = true;
+                if (streams.empty())
+                    goAway(Http2ErrorCode::NONE, {});
+                break;
+
+            case Http2FrameType::WINDOW_UPDATE:
+                onWindowUpdate(frame);
+                break;
+
+            default:
+                // Unknown frame types are ignored.
+                break;
+        }
+    }
+
+    void Http2Session::onHeaders(Http2Frame frame) {
+        if (frame.streamId == 0 || frame.streamId % 2 == 0)
+            throw Http2Error(Http2ErrorCode::PROTOCOL, "Invalid stream id");
+
+        removeHttp2Padding(frame);
+
+        // Stream priorities are advisory and ignored.
+        if (frame.has(Http2Flag::PRIORITY)) {
+            if (frame.payload.size() < 5)
+                throw Http2Error(Http2ErrorCode::FRAME_SIZE, "Invalid HEADERS");
+            frame.payload.remove_prefix(5);
+        }
+
+        if (frame.payload.size() > options.maxHeaderListSize)
+            throw Http2Error(Http2ErrorCode::ENHANCE_YOUR_CALM, "Header block too large");
+
+        headerBlock.assign(frame.payload);
+        headerStream = frame.streamId;
+        headerEndStream = frame.has(Http2Flag::END_STREAM);
+
+        if (frame.has(Http2Flag::END_HEADERS))
+            onHeaderBlock();
+        else
+            continuing = true;
+    }
+
+    // Every block is decoded, even for streams about to be refused, to keep
+    // the HPACK table in step with the client's.
+    void Http2Session::onHeaderBlock() {
+        HeaderList fields;
+        decoder.decode(headerBlock, fields, options.maxHeaderListSize);
+
+        uint32_t id = headerStream;
+        auto it = streams.find(id);
+
+        // Trailers end the request body; their fields are dropped.
+        if (it != streams.end()) {
+            if (!it->second->receiving)
+                throw Http2Error(Http2ErrorCode::STREAM_CLOSED, "HEADERS on a half-closed stream", id);
+            if (!headerEndStream)
+                throw Http2Error(Http2ErrorCode::PROTOCOL, "Trailers without END_STREAM", id);
+
+            run(it->second);
+            return;
+        }
+
+        if (id <= lastStreamId)
+            throw Http2Error(Http2ErrorCode::STREAM_CLOSED, "HEADERS on a closed stream");
+        lastStreamId = id;
+
+        if (goingAway) return;
+        if (streams.size() >= options.maxConcurrentStreams)
+            throw Http2Error(Http2ErrorCode::REFUSED_STREAM, "Too many concurrent streams", id);
+
+        StreamPtr stream = open(id, fields);
+        if (headerEndStream)
+            run(stream);
+    }
+
+    Http2Session::StreamPtr Http2Session::open(uint32_t id, HeaderList& fields) {
+        auto stream = std::make_shared<Stream>();
+        stream->id = id;
+
+        Request& req = stream->req;
+        req.version = "HTTP/2.0";
+        req.received = std::chrono::steady_clock::now();
+
+        auto malformed = [id](const char* message) {
+            return Http2Error(Http2ErrorCode::PROTOCOL, message, id);
+        };
+
+        std::string method, path, scheme, authority;
+        bool regular = false;
+
+        for (HeaderField& field : fields) {
+            if (!field.name.empty() && field.name[0] == ':') {
+                if (regular) throw malformed("Pseudo-header after a regular header");
+
+                if (field.name == ":method") method = std::move(field.value);
+                else if (field.name == ":path") path = std::move(field.value);
+                else if (field.name == ":scheme") scheme = std::move(field.value);
+                else if (field.name == ":authority") authority = std::move(field.value);
+                else throw malformed("Unknown pseudo-header");
+                continue;
+            }
+
+            regular = true;
+            if (std::any_of(field.name.begin(), field.name.end(),
+                            [](unsigned char c) { return std::isupper(c); }))
+                throw malformed("Uppercase header name");
+            if (connectionSpecific(field.name) || (field.name == "te" && field.value != "trailers"))
+                throw malformed("Connection-specific header");
+
+            auto [it, inserted] = req.headers.try_emplace(field.name, field.value);
+            if (!inserted)
+                it->second.append(field.name == "cookie" ? "; " : ", ").append(field.value);
+        }
+
+        if (method.empty() || path.empty() || scheme.empty())
+            throw malformed("Missing pseudo-header");
+        if (!authority.empty())
+            req.headers.try_emplace("host", std::move(authority));
+
+        bool known = false;
+        for (HttpMethod m : { HttpMethod::GET, HttpMethod::POST, HttpMethod::PUT, HttpMethod::DELETE_,
+                            HttpMethod::PATCH, HttpMethod::OPTIONS, HttpMethod::HEAD }) {
+            if (method == methodName(m)) {
+                req.method = m;
+                known = true;
+                break;
+            }
+        }
+        if (!known) throw malformed("Unsupported HTTP method");
+
+        size_t qmark = path.find('?');
+        if (qmark != std::string::npos) {
+            req.query = path.substr(qmark + 1);
+            path.resize(qmark);
+        }
+        req.path = std::move(path);
+
+        stream->sendWindow = peerWindowSize;
+        stream->receiveWindow = std::max(options.initialWindowSize, HTTP2_DEFAULT_WINDOW);
+        streams.emplace(id, stream);
+
+        if (idleTimer) {
+            loop.cancel(idleTimer);
+            idleTimer = 0;
+        }
+        return stream;
+    }
+
+    void Http2Session::onData(Http2Frame frame) {
+        if (frame.streamId == 0)
+            throw Http2Error(Http2ErrorCode::PROTOCOL, "DATA on stream 0");
+
+        // Padding counts against flow control too.
+        int64_t length = static_cast<int64_t>(frame.payload.size());
+        receiveWindow -= length;
+        if (receiveWindow < 0)
+            throw Http2Error(Http2ErrorCode::FLOW_CONTROL, "Connection window exceeded");
+
+        // The body is buffered whole, so windows are given back as soon as
+        // half of them is used; maxBodySize is what bounds memory.
+        int64_t connectionWindow = options.connectionWindowSize;
+        if (receiveWindow <= connectionWindow / 2) {
+            sendWindowUpdate(0, static_cast<uint32_t>(connectionWindow - receiveWindow));
+            receiveWindow = connectionWindow;
+        }
+
+        removeHttp2Padding(frame);
+
+        auto it = streams.find(frame.streamId);
+        if (it == streams.end() || !it->second->receiving) {
+            if (frame.streamId > lastStreamId)
+                throw Http2Error(Http2ErrorCode::PROTOCOL, "DATA on an idle stream");
+            throw Http2Error(Http2ErrorCode::STREAM_CLOSED, "DATA on a closed stream", frame.streamId);
+        }
+
+        Stream& stream = *it->second;
+        stream.receiveWindow -= length;
+        if (stream.receiveWindow < 0)
+            throw Http2Error(Http2ErrorCode::FLOW_CONTROL, "Stream window exceeded", stream.id);
+        if (stream.req.body.size() + frame.payload.size() > options.maxBodySize)
+            throw Http2Error(Http2ErrorCode::CANCEL, "Request body too large", stream.id);
+
+        stream.req.body.append(frame.payload);
+
+        if (frame.has(Http2Flag::END_STREAM)) {
+            run(it->second);
+            return;
+        }
+
+        int64_t streamWindow = std::max(options.initialWindowSize, HTTP2_DEFAULT_WINDOW);
+        if (stream.receiveWindow <= streamWindow / 2) {
+            sendWindowUpdate(stream.id, static_cast<uint32_t>(streamWindow - stream.receiveWindow));
+            stream.receiveWindow = streamWindow;
+        }
+    }
+
+    void Http2Session::onSettings(const Http2Frame& frame) {
+        if (frame.streamId != 0)
+            throw Http2Error(Http2ErrorCode::PROTOCOL, "SETTINGS on a stream");
+
+        if (frame.has(Http2Flag::ACK)) {
+            if (!frame.payload.empty())
+                throw Http2Error(Http2ErrorCode::FRAME_SIZE, "SETTINGS ACK with payload");
+            return;
+        }
+
+        if (frame.payload.size() % 6 != 0)
+            throw Http2Error(Http2ErrorCode::FRAME_SIZE, "Invalid SETTINGS");
+
+        applySettings(frame.payload);
+        appendHttp2FrameHeader(pending, 0, Http2FrameType::SETTINGS, Http2Flag::ACK, 0);
+    }
+
+    void Http2Session::applySettings(std::string_view payload) {
+        for (size_t pos = 0; pos + 6 <= payload.size(); pos += 6) {
+            uint16_t id = static_cast<uint16_t>((static_cast<uint8_t>(payload[pos]) << 8)
+                                                | static_cast<uint8_t>(payload[pos + 1]));
+            uint32_t value = readUint32(payload.data() + pos + 2);
+
+            switch (id) {
+                case Http2Setting::HEADER_TABLE_SIZE:
+                    encoder.tableSize(value);
+                    break;
+
+                case Http2Setting::ENABLE_PUSH:
+                    if (value > 1)
+                        throw Http2Error(Http2ErrorCode::PROTOCOL, "Invalid ENABLE_PUSH");
+                    break;
+
+                case Http2Setting::INITIAL_WINDOW_SIZE: {
+                    if (value > HTTP2_MAX_WINDOW)
+                        throw Http2Error(Http2ErrorCode::FLOW_CONTROL, "Invalid INITIAL_WINDOW_SIZE");
+
+                    // Applies to every open stream, possibly below zero.
+                    int64_t delta = int64_t(value) - int64_t(peerWindowSize);
+                    peerWindowSize = value;
+                    for (auto& [streamId, stream] : streams) {
+                        stream->sendWindow += delta;
+                        if (stream->sendWindow > HTTP2_MAX_WINDOW)
+                            throw Http2Error(Http2ErrorCode::FLOW_CONTROL, "Window overflow");
+                        requeue(stream);
+                    }
+                    break;
+                }
+
+                case Http2Setting::MAX_FRAME_SIZE:
+                    if (value < HTTP2_DEFAULT_FRAME_SIZE || value > MAX_FRAME_SIZE_LIMIT)
+                        throw Http2Error(Http2ErrorCode::PROTOCOL, "Invalid MAX_FRAME_SIZE");
+                    peerFrameSize = value;
+                    break;
+
+                default:
+                    break;
+            }
+        }
+    }
+
+    void Http2Session::onWindowUpdate(const Http2Frame& frame) {
+        if (frame.payload.size() != 4)
+            throw Http2Error(Http2ErrorCode::FRAME_SIZE, "Invalid WINDOW_UPDATE");
+
+        uint32_t increment = readUint32(frame.payload.data()) & 0x7FFFFFFF;
+
+        if (frame.streamId == 0) {
+            if (increment == 0)
+                throw Http2Error(Http2ErrorCode::PROTOCOL, "Zero window increment");
+            sendWindow += increment;
+            if (sendWindow > HTTP2_MAX_WINDOW)
+                throw Http2Error(Http2ErrorCode::FLOW_CONTROL, "Window overflow");
+            return;
+        }
+
+        if (increment == 0)
+            throw Http2Error(Http2ErrorCode::PROTOCOL, "Zero window increment", frame.streamId);
+
+        auto it = streams.find(frame.streamId);
+        if (it == streams.end()) {
+            if (frame.streamId > lastStreamId)
+                throw Http2Error(Http2ErrorCode::PROTOCOL, "WINDOW_UPDATE on an idle stream");
+            return;
+        }
+
+        it->second->sendWindow += increment;
+        if (it->second->sendWindow > HTTP2_MAX_WINDOW)
+            throw Http2Error(Http2ErrorCode::FLOW_CONTROL, "Window overflow", frame.streamId);
+        requeue(it->second);
+    }
+
+    void Http2Session::onResetStream(const Http2Frame& frame) {
+        if (frame.streamId == 0)
+            throw Http2Error(Http2ErrorCode::PROTOCOL, "RST_STREAM on stream 0");
+        if (frame.payload.size() != 4)
+            throw Http2Error(Http2ErrorCode::FRAME_SIZE, "Invalid RST_STREAM");
+        if (frame.streamId > lastStreamId)
+            throw Http2Error(Http2ErrorCode::PROTOCOL, "RST_STREAM on an idle stream");
+
+        auto it = streams.find(frame.streamId);
+        if (it == streams.end()) return;
+
+        // A running handler still finishes; its response is then dropped.
+        it->second->reset = true;
+        if (!it->second->running)
+            close(it->second);
+    }
+
+    void Http2Session::requeue(const StreamPtr& stream) {
+        if (stream->sending && !stream->queued && stream->sendWindow > 0) {
+            stream->queued = true;
+            sending.push_back(stream);
+        }
+    }
+
+    void Http2Session::run(const StreamPtr& stream) {
+        stream->receiving = false;
+        stream->running = true;
+
+        try {
+            execute([self = shared_from_this(), stream]() {
+                Response& res = stream->res.emplace(self->conn, stream.get());
+                uint32_t id = stream->id;
+
+                self->handler(stream->req, res, [self, id]() {
+                    self->loop.post([self, id]() { self->complete(id); });
+                });
+            });
+        } catch (const std::exception&) {
+            stream->running = false;
+            resetStream(stream->id, Http2ErrorCode::REFUSED_STREAM);
+        }
+    }
+
+    // The stream's response is complete: HEADERS now, DATA as the flow
+    // control windows allow.
+    void Http2Session::complete(uint32_t id) {
+        auto it = streams.find(id);
+        if (it == streams.end()) return;
+
+        StreamPtr stream = it->second;
+        stream->running = false;
+
+        if (closed || stream->reset) {
+            close(stream);
+            return;
+        }
+
+        if (stream->refused) {
+            resetStream(id, Http2ErrorCode::HTTP_1_1_REQUIRED);
+            flush();
+            return;
+        }
+
+        std::string block;
+        encoder.encode(stream->headers, block);
+        bool endStream = stream->body.empty();
+
+        size_t pos = 0;
+        do {
+            size_t n = std::min<size_t>(block.size() - pos, peerFrameSize);
+            bool last = pos + n == block.size();
+
+            uint8_t flags = last ? Http2Flag::END_HEADERS : 0;
+            if (pos == 0 && endStream) flags |= Http2Flag::END_STREAM;
+
+            appendHttp2FrameHeader(pending, n, pos == 0 ? Http2FrameType::HEADERS
+                                                      : Http2FrameType::CONTINUATION, flags, id);
+            pending.append(block, pos, n);
+            pos += n;
+        } while (pos < block.size());
+
+        if (endStream) {
+            close(stream);
+        } else {
+            stream->sending = true;
+            requeue(stream);
+        }
+        flush();
+    }
+
+    // One frame per stream per turn, so concurrent responses interleave.
+    void Http2Session::writeData() {
+        while (!closed && !sending.empty() && sendWindow > 0
+                && pending.size() + conn.queuedBytes() < HIGH_WATER) {
+            StreamPtr stream = std::move(sending.front());
+            sending.pop_front();
+            stream->queued = false;
+
+            // Blocked streams come back through requeue() on WINDOW_UPDATE.
+            if (stream->reset || stream->sendWindow <= 0) continue;
+
+            size_t left = stream->body.size() - stream->sent;
+            size_t n = std::min({ left, static_cast<size_t>(stream->sendWindow),
+                                static_cast<size_t>(sendWindow), static_cast<size_t>(peerFrameSize) });
+            bool last = n == left;
+
+            appendHttp2FrameHeader(pending, n, Http2FrameType::DATA,
+                                last ? Http2Flag::END_STREAM : 0, stream->id);
+            pending.append(stream->body, stream->sent, n);
+
+            stream->sent += n;
+            stream->sendWindow -= static_cast<int64_t>(n);
+            sendWindow -= static_cast<int64_t>(n);
+
+            if (last)
+                close(stream);
+            else
+                requeue(stream);
+        }
+    }
+
+    void Http2Session::close(const StreamPtr& stream) {
+        stream->reset = true;
+        streams.erase(stream->id);
+
+        if (streams.empty() && !closed) {
+            if (goingAway)
+                goAway(Http2ErrorCode::NONE, {});
+            else
+                armIdleTimer();
+        }
+    }
+
+    void Http2Session::resetStream(uint32_t id, uint32_t code) {
+        appendHttp2FrameHeader(pending, 4, Http2FrameType::RST_STREAM, 0, id);
+        appendUint32(pending, code);
+
+        auto it = streams.find(id);
+        if (it == streams.end()) return;
+
+        it->second->reset = true;
+        if (!it->second->running)
+            close(it->second);
+    }
+
+    void Http2Session::goAway(uint32_t code, std::string_view reason) {
+        if (closed) return;
+
+        appendHttp2FrameHeader(pending, 8 + reason.size(), Http2FrameType::GOAWAY, 0, 0);
+        appendUint32(pending, lastStreamId);
+        appendUint32(pending, code);
+        pending.append(reason);
+
+        sending.clear();
+        flush();
+        terminate();
+    }
+
+    void Http2Session::armIdleTimer() {
+        if (idleTimeout.count() <= 0 || closed) return;
+        if (idleTimer) loop.cancel(idleTimer);
+
+        idleTimer = loop.after(idleTimeout, [self = shared_from_this()]() {
+            self->idleTimer = 0;
+            if (self->streams.empty())
+                self->goAway(Http2ErrorCode::NONE, "Idle timeout");
+        });
+    }
+
+    void Http2Session::flush() {
+        if (closed) return;
+
+        // Refill from the data of open streams as long as the socket drains.
+        while (true) {
+            writeData();
+
+            if (!pending.empty()) {
+                conn.queue(std::make_shared<const std::string>(std::move(pending)));
+                pending.clear();
+            }
+
+            if (!conn.flushSome()) {
+                terminate();
+                return;
+            }
+
+            if (conn.hasQueued() || sending.empty() || sendWindow <= 0) break;
+        }
+
+        if (watchingWritable != conn.hasQueued())
+            watch(conn.hasQueued());
+    }
+
+    void Http2Session::watch(bool writable) {
+        watchingWritable = writable;
+        int interest = EventLoop::READABLE;
+        if (writable) interest |= EventLoop::WRITABLE;
+
+        loop.watch(conn.raw(), interest,
+                [self = shared_from_this()]() { self->onReady(); }, true);
+    }
+
+    // As for WebSocket, the connection is released from a later loop pass.
+    // Streams whose handlers are still running stay registered until their
+    // done callbacks arrive, which then only drop them.
+    void Http2Session::terminate() {
+        if (closed) return;
+        closed = true;
+        loop.unwatch(conn.raw());
+
+        if (idleTimer) {
+            loop.cancel(idleTimer);
+            idleTimer = 0;
+        }
+
+        loop.post([self = shared_from_this()]() {
+            self->conn.discardQueue();
+            self->sending.clear();
+
+            for (auto it = self->streams.begin(); it != self->streams.end(); ) {
+                if (it->second->running)
+                    ++it;
+                else
+                    it = self->streams.erase(it);
+            }
+
+            self->conn.readBuffer.clear();
+            self->release(&self->conn);
+        });
+    }
+}
+
+#endif
@@ -0,0 +1,777 @@
+#ifndef _WIN32
+
+#include "net/HttpClient.h"
+#include "http/Request.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <deque>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/tcp.h>
+
+namespace mini_http {
+    struct HttpClient::Exchange {
+        Upstream upstream;
+        Connection::Buffer request;
+        HttpMethod method;
+        bool idempotent;
+        std::chrono::milliseconds timeout;
+        std::shared_ptr<Receiver> receiver;
+
+        // Loop thread only.
+        Pool* pool = nullptr;
+        Link* link = nullptr;
+        EventLoop::TimerId timer = 0;
+        bool responded = false;
+        bool paused = false;
+        bool retried = false;
+        bool finished = false;
+    };
+
+    // One connection to an upstream. Responses come back in the order the
+    // requests in inflight were written.
+    struct HttpClient::Link : std::enable_shared_from_this<Link> {
+        enum class Body { NONE, LENGTH, CHUNKED, UNTIL_CLOSE };
+
+        Pool& pool;
+        Connection conn;
+        std::deque<ExchangePtr> inflight;
+        EventLoop::TimerId timer = 0;
+        int interest = 0;
+
+        bool connecting = true;
+        bool reused = false;
+        bool closing = false;
+        bool closed = false;
+
+        // The response being read.
+        ResponseHead head;
+        bool inBody = false;
+        Body body = Body::NONE;
+        uint64_t remaining = 0;
+        ChunkedDecoder chunked;
+        std::string decoded;
+
+        Link(Pool& pool, socket_t fd) : pool(pool), conn(fd) {}
+    };
+
+    struct HttpClient::Pool {
+        Upstream upstream;
+        sockaddr_storage address {};
+        socklen_t addressLength = 0;
+
+        std::vector<LinkPtr> links;
+        std::vector<Link*> idle;
+        std::deque<ExchangePtr> pending;
+        size_t connecting = 0;
+    };
+
+    namespace {
+        // Receiver behind send(): gathers the response into one ClientResponse.
+        class Collector : public HttpClient::Receiver {
+        public:
+            Collector(size_t limit, std::function<void(ClientResponse&)> done)
+                : limit(limit), done(std::move(done)) {}
+
+            void head(const ResponseHead& head) override {
+                static_cast<ResponseHead&>(response) = head;
+            }
+
+            // The rest of an oversized body is read and dropped, so the
+            // connection stays usable.
+            bool data(std::string_view bytes) override {
+                if (!tooLarge && response.body.size() + bytes.size() > limit) {
+                    tooLarge = true;
+                    std::string().swap(response.body);
+                }
+                if (!tooLarge)
+                    response.body.append(bytes);
+                return true;
+            }
+
+            void end(ClientError error) override {
+                response.error = error == ClientError::NONE && tooLarge ? ClientError::TOO_LARGE : error;
+                done(response);
+            }
+
+        private:
+            size_t limit;
+            std::function<void(ClientResponse&)> done;
+            ClientResponse response;
+            bool tooLarge = false;
+        };
+    }
+
+    static bool isIdempotent(HttpMethod method) {
+        return method != HttpMethod::POST && method != HttpMethod::PATCH;
+    }
+
+    static bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+        return a.size() == b.size()
+            && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+                return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+            });
+    }
+
+    static Connection::Buffer encodeRequest(const Upstream& upstream, const ClientRequest& request) {
+        std::string out;
+        out.reserve(256 + request.target.size() + request.body.size());
+
+        out.append(methodName(request.method));
+        out.push_back(' ');
+        out.append(request.target);
+        out.append(" HTTP/1.1\r\n");
+
+        bool host = false;
+        for (const auto& [name, value] : request.headers) {
+            if (equalsIgnoreCase(name, "content-length")) continue;
+            if (equalsIgnoreCase(name, "host")) host = true;
+
+            out.append(name);
+            out.append(": ");
+            out.append(value);
+            out.append("\r\n");
+        }
+
+        if (!host) {
+            out.append("Host: ");
+            out.append(upstream.authority());
+            out.append("\r\n");
+        }
+
+        if (!request.body.empty() || request.method == HttpMethod::POST
+            || request.method == HttpMethod::PUT || request.method == HttpMethod::PATCH) {
+            char length[24];
+            auto [end, ec] = std::to_chars(length, length + sizeof(length), request.body.size());
+            (void)ec;
+
+            out.append("Content-Length: ");
+            out.append(length, end);
+            out.append("\r\n");
+        }
+
+        out.append("\r\n");
+        out.append(request.body);
+        return std::make_shared<const std::string>(std::move(out));
+    }
+
+    HttpClient::HttpClient(EventLoop& loop, HttpClientOptions options)
+        : loop(loop),
+        options(options)
+    {
+        if (this->options.maxConnections == 0) this->options.maxConnections = 1;
+        if (this->options.pipelineDepth == 0) this->options.pipelineDepth = 1;
+    }
+
+    // Connections are closed with their pools; the loop must have stopped.
+    // Receivers still waiting are dropped uncalled, which also breaks any
+    // cycle through an exchange they hold.
+    HttpClient::~HttpClient() {
+        for (auto& [authority, pool] : pools) {
+            for (const ExchangePtr& exchange : pool->pending)
+                exchange->receiver.reset();
+            for (const LinkPtr& link : pool->links) {
+                for (const ExchangePtr& exchange : link->inflight)
+                    exchange->receiver.reset();
+            }
+        }
+    }
+
+    HttpClient::ExchangePtr HttpClient::start(const Upstream& upstream, ClientRequest request,
+                                              std::shared_ptr<Receiver> receiver)
+    {
+        auto exchange = std::make_shared<Exchange>();
+        exchange->upstream = upstream;
+        exchange->request = encodeRequest(upstream, request);
+        exchange->method = request.method;
+        exchange->idempotent = isIdempotent(request.method);
+        exchange->timeout = request.timeout.count() > 0 ? request.timeout : options.requestTimeout;
+        exchange->receiver = std::move(receiver);
+
+        loop.post([this, exchange]() { submit(exchange); });
+        return exchange;
+    }
+
+    void HttpClient::send(const Upstream& upstream, ClientRequest request,
+                          std::function<void(ClientResponse&)> done)
+    {
+        start(upstream, std::move(request),
+            std::make_shared<Collector>(options.maxResponseSize, std::move(done)));
+    }
+
+    void HttpClient::submit(const ExchangePtr& exchange) {
+        if (exchange->finished) return;
+
+        Pool* pool = poolFor(exchange->upstream);
+        if (!pool) {
+            finish(exchange, ClientError::CONNECT);
+            return;
+        }
+        exchange->pool = pool;
+
+        std::weak_ptr<Exchange> weak = exchange;
+        exchange->timer = loop.after(exchange->timeout, [this, weak]() {
+            if (auto expired = weak.lock()) {
+                expired->timer = 0;
+                timeout(expired);
+            }
+        });
+
+        pool->pending.push_back(exchange);
+        pump(*pool);
+    }
+
+    // Resolved once per upstream, on the loop thread; failures are not
+    // cached, so a name that starts resolving is picked up on a later call.
+    HttpClient::Pool* HttpClient::poolFor(const Upstream& upstream) {
+        std::string key = upstream.authority();
+        auto it = pools.find(key);
+        if (it != pools.end()) return it->second.get();
+
+        addrinfo hints {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_NUMERICSERV;
+
+        addrinfo* result = nullptr;
+        std::string port = std::to_string(upstream.port);
+        if (getaddrinfo(upstream.host.c_str(), port.c_str(), &hints, &result) != 0 || !result)
+            return nullptr;
+
+        auto pool = std::make_unique<Pool>();
+        pool->upstream = upstream;
+        std::memcpy(&pool->address, result->ai_addr, result->ai_addrlen);
+        pool->addressLength = static_cast<socklen_t>(result->ai_addrlen);
+        freeaddrinfo(result);
+
+        return pools.emplace(std::move(key), std::move(pool)).first->second.get();
+    }
+
+    // Hands waiting requests to usable connections, then opens connections
+    // for the ones still waiting.
+    void HttpClient::pump(Pool& pool) {
+        while (!pool.pending.empty()) {
+            Link* link = pick(pool, *pool.pending.front());
+            if (!link) break;
+
+            ExchangePtr exchange = std::move(pool.pending.front());
+            pool.pending.pop_front();
+            dispatch(*link, std::move(exchange));
+        }
+
+        while (pool.connecting < pool.pending.size() && pool.links.size() < options.maxConnections) {
+            if (!connect(pool)) break;
+        }
+    }
+
+    // The most recently used idle connection, whose socket is most likely
+    // still open and warm; else, for idempotent requests, the least loaded
+    // connection that can take one more pipelined request.
+    HttpClient::Link* HttpClient::pick(Pool& pool, const Exchange& exchange) {
+        if (!pool.idle.empty()) {
+            Link* link = pool.idle.back();
+            pool.idle.pop_back();
+            if (link->timer) {
+                loop.cancel(link->timer);
+                link->timer = 0;
+            }
+            return link;
+        }
+
+        if (options.pipelineDepth < 2 || !exchange.idempotent)
+            return nullptr;
+
+        Link* best = nullptr;
+        for (const LinkPtr& link : pool.links) {
+            if (link->connecting || link->closing || link->inflight.size() >= options.pipelineDepth)
+                continue;
+
+            bool safe = std::all_of(link->inflight.begin(), link->inflight.end(),
+                                    [](const ExchangePtr& e) { return e->idempotent; });
+            if (safe && (!best || link->inflight.size() < best->inflight.size()))
+                best = link.get();
+        }
+        return best;
+    }
+
+    bool HttpClient::connect(Pool& pool) {
+        #ifdef SOCK_NONBLOCK
+            socket_t fd = ::socket(pool.address.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        #else
+            socket_t fd = ::socket(pool.address.ss_family, SOCK_STREAM, 0);
+            if (fd != INVALID_SOCK) {
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+                fcntl(fd, F_SETFD, FD_CLOEXEC);
+            }
+        #endif
+
+        if (fd != INVALID_SOCK) {
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+            if (::connect(fd, reinterpret_cast<const sockaddr*>(&pool.address), pool.addressLength) != 0
+                && errno != EINPROGRESS) {
+                ::close(fd);
+                fd = INVALID_SOCK;
+            }
+        }
+
+        if (fd == INVALID_SOCK) {
+            connectFailed(pool);
+            return false;
+        }
+
+        auto link = std::make_shared<Link>(pool, fd);
+        pool.links.push_back(link);
+        ++pool.connecting;
+        open.fetch_add(1, std::memory_order_relaxed);
+
+        std::weak_ptr<Link> weak = link;
+        link->timer = loop.after(options.connectTimeout, [this, weak]() {
+            auto pending = weak.lock();
+            if (!pending || !pending->connecting) return;
+
+            pending->timer = 0;
+            Pool& owner = pending->pool;
+            closeLink(pending);
+            connectFailed(owner);
+        });
+
+        updateWatch(link);
+        return true;
+    }
+
+    // Requests waiting for an upstream that no connection reaches fail;
+    // while other connections are open or opening, they wait for those.
+    void HttpClient::connectFailed(Pool& pool) {
+        if (!pool.links.empty()) return;
+
+        auto waiting = std::move(pool.pending);
+        pool.pending.clear();
+        for (const ExchangePtr& exchange : waiting)
+            finish(exchange, ClientError::CONNECT);
+    }
+
+    void HttpClient::dispatch(Link& link, ExchangePtr exchange) {
+        exchange->link = &link;
+        link.conn.queue(exchange->request);
+        link.inflight.push_back(std::move(exchange));
+        flush(link.shared_from_this());
+    }
+
+    void HttpClient::onReady(const LinkPtr& link) {
+        if (link->connecting) {
+            onConnected(link);
+            return;
+        }
+
+        if (link->conn.hasQueued()) {
+            flush(link);
+            if (link->closed) return;
+        }
+
+        readAvailable(link);
+    }
+
+    void HttpClient::onConnected(const LinkPtr& link) {
+        Pool& pool = link->pool;
+
+        int error = 0;
+        socklen_t length = sizeof(error);
+        if (getsockopt(link->conn.raw(), SOL_SOCKET, SO_ERROR, &error, &length) != 0 || error != 0) {
+            closeLink(link);
+            connectFailed(pool);
+            return;
+        }
+
+        link->connecting = false;
+        --pool.connecting;
+        if (link->timer) {
+            loop.cancel(link->timer);
+            link->timer = 0;
+        }
+
+        makeIdle(link);
+        pump(pool);
+    }
+
+    // Level-triggered, so a busy upstream gets a bounded number of reads
+    // per wakeup and the loop moves on to other sockets.
+    void HttpClient::readAvailable(const LinkPtr& link) {
+        static constexpr int MAX_READS = 8;
+        char buffer[16 * 1024];
+
+        for (int i = 0; i < MAX_READS && !link->closed; ++i) {
+            if (!link->inflight.empty() && link->inflight.front()->paused)
+                return;
+
+            ssize_t n = link->conn.read(buffer, sizeof(buffer));
+            if (n > 0) {
+                link->conn.readBuffer.append(buffer, static_cast<size_t>(n));
+                process(link);
+                continue;
+            }
+
+            if (n == 0)
+                onClosed(link);
+            else if (errno != EAGAIN && errno != EWOULDBLOCK)
+                abort(link, nullptr, ClientError::CLOSED);
+            return;
+        }
+    }
+
+    void HttpClient::process(const LinkPtr& link) {
+        std::string& buffer = link->conn.readBuffer;
+
+        while (!link->closed && !link->inflight.empty()) {
+            ExchangePtr exchange = link->inflight.front();
+            if (exchange->paused) return;
+
+            if (!link->inBody) {
+                size_t used;
+                try {
+                    used = parseResponseHead(buffer, link->head);
+                } catch (const ParseError&) {
+                    abort(link, exchange.get(), ClientError::MALFORMED);
+                    return;
+                }
+                if (used == 0) return;
+                buffer.erase(0, used);
+
+                // Interim responses (100 Continue, 103 Early Hints) precede the real one.
+                if (link->head.status < 200 && link->head.status != 101)
+                    continue;
+
+                exchange->responded = true;
+                if (!startBody(link, *exchange)) return;
+
+                if (auto receiver = exchange->receiver)
+                    receiver->head(link->head);
+                if (link->closed || exchange->finished) return;
+
+                link->inBody = true;
+                if (link->body == Link::Body::NONE) {
+                    finishResponse(link);
+                    continue;
+                }
+            }
+
+            if (buffer.empty()) return;
+
+            bool more = true;
+            if (link->body == Link::Body::CHUNKED) {
+                link->decoded.clear();
+                size_t used;
+                try {
+                    used = link->chunked.decode(buffer, link->decoded);
+                } catch (const ParseError&) {
+                    abort(link, exchange.get(), ClientError::MALFORMED);
+                    return;
+                }
+                buffer.erase(0, used);
+
+                if (!link->decoded.empty())
+                    more = deliver(*link, *exchange, link->decoded);
+                if (link->closed || exchange->finished) return;
+
+                if (link->chunked.done()) {
+                    finishResponse(link);
+                    continue;
+                }
+            } else {
+                size_t take = buffer.size();
+                if (link->body == Link::Body::LENGTH)
+                    take = static_cast<size_t>(std::min<uint64_t>(link->remaining, take));
+
+                more = deliver(*link, *exchange, std::string_view(buffer.data(), take));
+                if (link->closed || exchange->finished) return;
+
+                buffer.erase(0, take);
+                link->remaining -= take;
+
+                if (link->body == Link::Body::LENGTH && link->remaining == 0) {
+                    finishResponse(link);
+                    continue;
+                }
+            }
+
+            if (!more) return;
+        }
+
+        // Bytes no request asked for: the connection is out of step.
+        if (!link->closed && link->inflight.empty() && !buffer.empty())
+            closeLink(link);
+    }
+
+    // Works out how the body of the head just parsed ends. False (with the
+    // connection aborted) if its framing is invalid.
+    bool HttpClient::startBody(const LinkPtr& link, const Exchange& exchange) {
+        const ResponseHead& head = link->head;
+        link->remaining = 0;
+        link->chunked.reset();
+
+        if (head.status == 101) {
+            abort(link, &exchange, ClientError::MALFORMED);
+            return false;
+        }
+
+        const std::string* connection = head.header("connection");
+        bool keepAlive = head.version == "HTTP/1.1"
+            ? !(connection && tokenListContains(*connection, "close"))
+            : connection && tokenListContains(*connection, "keep-alive");
+        if (!keepAlive)
+            link->closing = true;
+
+        if (exchange.method == HttpMethod::HEAD || head.status == 204 || head.status == 304) {
+            link->body = Link::Body::NONE;
+            return true;
+        }
+
+        if (const std::string* te = head.header("transfer-encoding")) {
+            if (tokenListContains(*te, "chunked")) {
+                link->body = Link::Body::CHUNKED;
+            } else {
+                link->body = Link::Body::UNTIL_CLOSE;
+                link->closing = true;
+            }
+            return true;
+        }
+
+        if (const std::string* length = head.header("content-length")) {
+            uint64_t value = 0;
+            auto [end, ec] = std::from_chars(length->data(), length->data() + length->size(), value);
+            if (ec != std::errc() || end != length->data() + length->size()) {
+                abort(link, &exchange, ClientError::MALFORMED);
+                return false;
+            }
+
+            link->remaining = value;
+            link->body = value > 0 ? Link::Body::LENGTH : Link::Body::NONE;
+            return true;
+        }
+
+        link->body = Link::Body::UNTIL_CLOSE;
+        link->closing = true;
+        return true;
+    }
+
+    // The receiver is held for the call, as it may cancel the exchange.
+    bool HttpClient::deliver(Link& link, Exchange& exchange, std::string_view bytes) {
+        std::shared_ptr<Receiver> receiver = exchange.receiver;
+        if (!receiver || receiver->data(bytes))
+            return true;
+
+        exchange.paused = true;
+        if (!link.closed)
+            updateWatch(link.shared_from_this());
+        return false;
+    }
+
+    void HttpClient::finishResponse(const LinkPtr& link) {
+        ExchangePtr exchange = std::move(link->inflight.front());
+        link->inflight.pop_front();
+        exchange->link = nullptr;
+        link->inBody = false;
+        link->reused = true;
+
+        Pool& pool = link->pool;
+        if (link->closing) {
+            // Requests pipelined behind a response that ends the connection
+            // are sent again on another one.
+            if (link->inflight.empty())
+                closeLink(link);
+            else
+                abort(link, nullptr, ClientError::CLOSED);
+        } else if (link->inflight.empty()) {
+            makeIdle(link);
+        } else {
+            updateWatch(link);
+        }
+
+        finish(exchange, ClientError::NONE);
+        pump(pool);
+    }
+
+    void HttpClient::onClosed(const LinkPtr& link) {
+        if (link->inBody && link->body == Link::Body::UNTIL_CLOSE && !link->inflight.empty()) {
+            finishResponse(link);
+            return;
+        }
+
+        if (link->inflight.empty()) {
+            closeLink(link);
+            return;
+        }
+
+        abort(link, nullptr, ClientError::CLOSED);
+    }
+
+    void HttpClient::flush(const LinkPtr& link) {
+        if (!link->conn.flushSome()) {
+            abort(link, nullptr, ClientError::CLOSED);
+            return;
+        }
+        updateWatch(link);
+    }
+
+    // Idle connections stay readable too, so a close by the upstream is
+    // noticed before the connection is handed out again.
+    void HttpClient::updateWatch(const LinkPtr& link) {
+        if (link->closed) return;
+
+        int interest = 0;
+        if (link->connecting || link->conn.hasQueued())
+            interest |= EventLoop::WRITABLE;
+
+        bool paused = !link->inflight.empty() && link->inflight.front()->paused;
+        if (!link->connecting && !paused)
+            interest |= EventLoop::READABLE;
+
+        if (interest == link->interest) return;
+        link->interest = interest;
+
+        if (interest == 0) {
+            loop.unwatch(link->conn.raw());
+            return;
+        }
+
+        std::weak_ptr<Link> weak = link;
+        loop.watch(link->conn.raw(), interest, [this, weak]() {
+            if (auto ready = weak.lock())
+                onReady(ready);
+        }, true);
+    }
+
+    void HttpClient::makeIdle(const LinkPtr& link) {
+        Pool& pool = link->pool;
+        pool.idle.push_back(link.get());
+
+        std::weak_ptr<Link> weak = link;
+        link->timer = loop.after(options.idleTimeout, [this, weak]() {
+            auto idle = weak.lock();
+            if (!idle || !idle->inflight.empty()) return;
+
+            idle->timer = 0;
+            closeLink(idle);
+        });
+
+        updateWatch(link);
+    }
+
+    // Closes a connection mid-exchange. The culprit fails with error, as do
+    // requests that already had part of a response. The others never
+    // reached the upstream's handler as far as anyone can tell, so the
+    // idempotent ones are queued again: this is what saves requests sent on
+    // a pooled connection just as the upstream closed it. The first request
+    // gets that second chance only once.
+    void HttpClient::abort(const LinkPtr& link, const Exchange* culprit, ClientError error) {
+        Pool& pool = link->pool;
+        std::deque<ExchangePtr> inflight = std::move(link->inflight);
+        link->inflight.clear();
+        closeLink(link);
+
+        ClientError others = culprit ? ClientError::CLOSED : error;
+        std::vector<ExchangePtr> retry;
+
+        for (size_t i = 0; i < inflight.size(); ++i) {
+            const ExchangePtr& exchange = inflight[i];
+            exchange->link = nullptr;
+            exchange->paused = false;
+
+            bool first = i == 0;
+            if (exchange.get() != culprit && !exchange->responded && exchange->idempotent
+                && !(first && exchange->retried)) {
+                exchange->retried = exchange->retried || first;
+                retry.push_back(exchange);
+            } else {
+                finish(exchange, exchange.get() == culprit ? error : others);
+            }
+        }
+
+        pool.pending.insert(pool.pending.begin(), retry.begin(), retry.end());
+        pump(pool);
+    }
+
+    void HttpClient::closeLink(const LinkPtr& link) {
+        if (link->closed) return;
+        link->closed = true;
+
+        Pool& pool = link->pool;
+        if (link->interest) {
+            loop.unwatch(link->conn.raw());
+            link->interest = 0;
+        }
+        if (link->timer) {
+            loop.cancel(link->timer);
+            link->timer = 0;
+        }
+        if (link->connecting)
+            --pool.connecting;
+
+        pool.idle.erase(std::remove(pool.idle.begin(), pool.idle.end(), link.get()), pool.idle.end());
+        pool.links.erase(std::find(pool.links.begin(), pool.links.end(), link));
+
+        link->conn.close();
+        open.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void HttpClient::finish(const ExchangePtr& exchange, ClientError error) {
+        if (exchange->finished) return;
+        exchange->finished = true;
+
+        if (exchange->timer) {
+            loop.cancel(exchange->timer);
+            exchange->timer = 0;
+        }
+
+        if (auto receiver = std::move(exchange->receiver))
+            receiver->end(error);
+    }
+
+    void HttpClient::timeout(const ExchangePtr& exchange) {
+        if (exchange->finished) return;
+
+        if (exchange->link) {
+            abort(exchange->link->shared_from_this(), exchange.get(), ClientError::TIMEOUT);
+            return;
+        }
+
+        if (Pool* pool = exchange->pool) {
+            auto& pending = pool->pending;
+            pending.erase(std::remove(pending.begin(), pending.end(), exchange), pending.end());
+        }
+        finish(exchange, ClientError::TIMEOUT);
+    }
+
+    void HttpClient::resume(const ExchangePtr& exchange) {
+        if (!exchange || exchange->finished || !exchange->paused) return;
+        exchange->paused = false;
+
+        if (!exchange->link) return;
+        LinkPtr link = exchange->link->shared_from_this();
+        process(link);
+        updateWatch(link);
+    }
+
+    void HttpClient::cancel(const ExchangePtr& exchange) {
+        if (!exchange || exchange->finished) return;
+        exchange->receiver.reset();
+
+        if (exchange->link) {
+            abort(exchange->link->shared_from_this(), exchange.get(), ClientError::CANCELLED);
+            return;
+        }
+
+        if (Pool* pool = exchange->pool) {
+            auto& pending = pool->pending;
+            pending.erase(std::remove(pending.begin(), pending.end(), exchange), pending.end());
+        }
+        finish(exchange, ClientError::CANCELLED);
+    }
+}
+
+#endif
@@ -0,0 +1,506 @@
+#ifndef _WIN32
+
+#include "net/ReverseProxy.h"
+#include "http/Request.h"
+#include "http/Response.h"
+
+#include <charconv>
+#include <random>
+#include <stdexcept>
+#include <utility>
+
+#include <arpa/inet.h>
+
+namespace mini_http {
+    static const Connection::Buffer LAST_CHUNK = std::make_shared<const std::string>("0\r\n\r\n");
+
+    // Headers about one connection rather than the message, which a proxy
+    // must not pass on, plus any the Connection header names.
+    static bool hopByHop(std::string_view name, const std::string* connection) {
+        return name == "connection" || name == "keep-alive" || name == "proxy-connection"
+            || name == "te" || name == "trailer" || name == "transfer-encoding"
+            || name == "upgrade" || name == "http2-settings"
+            || (connection && tokenListContains(*connection, name));
+    }
+
+    static std::string peerAddress(const Connection& conn) {
+        sockaddr_storage address {};
+        socklen_t length = sizeof(address);
+        if (getpeername(conn.raw(), reinterpret_cast<sockaddr*>(&address), &length) != 0)
+            return {};
+
+        char text[INET6_ADDRSTRLEN] = {};
+        if (address.ss_family == AF_INET)
+            inet_ntop(AF_INET, &reinterpret_cast<sockaddr_in*>(&address)->sin_addr, text, sizeof(text));
+        else if (address.ss_family == AF_INET6)
+            inet_ntop(AF_INET6, &reinterpret_cast<sockaddr_in6*>(&address)->sin6_addr, text, sizeof(text));
+        return text;
+    }
+
+    static int64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static bool isIdempotent(HttpMethod method) {
+        return method != HttpMethod::POST && method != HttpMethod::PATCH;
+    }
+
+    // Answers that usually mean the upstream, or what it depends on, is down.
+    static bool failing(int status) {
+        return status >= 502 && status <= 504;
+    }
+
+    static size_t randomBelow(size_t n) {
+        thread_local std::minstd_rand random(std::random_device {}());
+        return std::uniform_int_distribution<size_t>(0, n - 1)(random);
+    }
+
+    // Writes an upstream response to an HTTP/1 client as it arrives, on
+    // the loop thread. Reading from the upstream pauses while the client is
+    // more than maxBufferedBytes behind.
+    class ReverseProxy::Relay : public HttpClient::Receiver, public std::enable_shared_from_this<Relay> {
+    public:
+        Relay(ReverseProxy& proxy, const Request& req, Response& res,
+              ClientRequest request, size_t retries)
+            : proxy(proxy),
+            client(*proxy.client),
+            res(res),
+            conn(res.connection()),
+            request(std::move(request)),
+            retries(retries),
+            headOnly(req.method == HttpMethod::HEAD),
+            http11(req.version == "HTTP/1.1")
+        {
+        }
+
+        // Loop thread; also sends each retry.
+        void send() {
+            backend = proxy.pick(backend);
+            proxy.acquire(backend);
+            settled = false;
+
+            ClientRequest copy = retries > 0 ? request : std::move(request);
+            exchange = client.start(proxy.upstreams_[backend], std::move(copy), shared_from_this());
+        }
+
+        void head(const ResponseHead& head) override {
+            status = static_cast<HttpStatus>(head.status);
+            failed = failing(head.status);
+
+            // Bodies of unknown length are re-chunked, so the client
+            // connection survives an upstream that closes to end them.
+            const std::string* te = head.header("transfer-encoding");
+            bool bodyless = headOnly || head.status == 204 || head.status == 304;
+            if (!bodyless && (te || !head.header("content-length"))) {
+                if (http11)
+                    chunked = true;
+                else
+                    res.keepAlive(false);
+            }
+
+            std::string text = "HTTP/1.1 " + std::to_string(head.status) + " " + head.reason + "\r\n";
+
+            const std::string* connection = head.header("connection");
+            for (const auto& [name, value] : head.headers) {
+                if (hopByHop(name, connection) || (te && name == "content-length"))
+                    continue;
+                text.append(name);
+                text.append(": ");
+                text.append(value);
+                text.append("\r\n");
+            }
+
+            if (chunked)
+                text.append("Transfer-Encoding: chunked\r\n");
+            text.append(res.keepAlive() ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n");
+
+            started = true;
+            conn.queue(std::make_shared<const std::string>(std::move(text)));
+            flush();
+        }
+
+        bool data(std::string_view bytes) override {
+            if (done) return true;
+
+            std::string buffer;
+            if (chunked) {
+                char size[20];
+                auto [end, ec] = std::to_chars(size, size + sizeof(size), bytes.size(), 16);
+                (void)ec;
+
+                buffer.reserve(bytes.size() + 24);
+                buffer.append(size, end);
+                buffer.append("\r\n");
+                buffer.append(bytes);
+                buffer.append("\r\n");
+            } else {
+                buffer.assign(bytes);
+            }
+
+            conn.queue(std::make_shared<const std::string>(std::move(buffer)));
+            flush();
+
+            if (done || conn.queuedBytes() < proxy.options.maxBufferedBytes)
+                return true;
+            paused = true;
+            return false;
+        }
+
+        void end(ClientError error) override {
+            exchange.reset();
+            settle(failed || (error != ClientError::NONE && error != ClientError::TOO_LARGE));
+            if (done) return;
+
+            if (error == ClientError::NONE) {
+                if (chunked)
+                    conn.queue(LAST_CHUNK);
+                ended = true;
+                flush();
+                return;
+            }
+
+            // Nothing has reached the client yet, so another upstream can
+            // still answer.
+            if (!started && retries > 0) {
+                --retries;
+                send();
+                return;
+            }
+
+            // A body cut short can only be signalled by closing.
+            if (started) {
+                res.keepAlive(false);
+                conn.discardQueue();
+                finish();
+                return;
+            }
+
+            done = true;
+            try {
+                if (error == ClientError::TIMEOUT)
+                    res.gatewayTimeout();
+                else
+                    res.badGateway();
+            } catch (...) {
+                res.keepAlive(false);
+            }
+            res.complete();
+        }
+
+    private:
+        ReverseProxy& proxy;
+        HttpClient& client;
+        Response& res;
+        Connection& conn;
+        ClientRequest request;
+        size_t retries;
+        bool headOnly;
+        bool http11;
+
+        HttpClient::ExchangePtr exchange;
+        size_t backend = SIZE_MAX;
+        bool settled = true;
+        bool failed = false;
+
+        HttpStatus status = HttpStatus::BAD_GATEWAY;
+        bool chunked = false;
+        bool started = false;
+        bool ended = false;
+        bool paused = false;
+        bool watching = false;
+        bool done = false;
+
+        void settle(bool failure) {
+            if (settled) return;
+            settled = true;
+            proxy.release(backend, failure);
+        }
+
+        void flush() {
+            if (done) return;
+
+            if (!conn.flushSome()) {
+                // The client is gone; so is any reason to keep reading.
+                client.cancel(std::exchange(exchange, nullptr));
+                settle(failed);
+                res.keepAlive(false);
+                conn.discardQueue();
+                finish();
+                return;
+            }
+
+            if (conn.hasQueued()) {
+                if (!watching) {
+                    watching = true;
+                    conn.loop->watch(conn.raw(), EventLoop::WRITABLE, [self = shared_from_this()]() {
+                        self->watching = false;
+                        self->flush();
+                    });
+                }
+                return;
+            }
+
+            if (ended) {
+                finish();
+            } else if (paused) {
+                paused = false;
+                client.resume(exchange);
+            }
+        }
+
+        // Past this point the request and response may be reused.
+        void finish() {
+            done = true;
+            if (watching) {
+                conn.loop->unwatch(conn.raw());
+                watching = false;
+            }
+
+            res.markSent(status);
+            res.complete();
+        }
+    };
+
+    // A request answered through send(), for HTTP/2 streams.
+    struct ReverseProxy::Attempt {
+        Response::Deferred deferred;
+        ClientRequest request;
+        size_t retries;
+        size_t backend = SIZE_MAX;
+    };
+
+    // HTTP/2 streams take the response whole. Repeated headers keep their
+    // last value.
+    static void answer(Response& res, const ClientResponse& response) {
+        if (!response.ok()) {
+            if (response.error == ClientError::TIMEOUT)
+                res.gatewayTimeout();
+            else
+                res.badGateway();
+            return;
+        }
+
+        res.setStatus(static_cast<HttpStatus>(response.status));
+
+        const std::string* connection = response.header("connection");
+        for (const auto& [name, value] : response.headers) {
+            if (hopByHop(name, connection) || name == "content-length" || name == "date")
+                continue;
+            res.setHeader(name == "content-type" ? "Content-Type" : name, value);
+        }
+
+        res.send(response.body);
+    }
+
+    ReverseProxy::ReverseProxy(std::vector<Upstream> upstreams, ProxyOptions options)
+        : upstreams_(std::move(upstreams)),
+        backends(new Backend[upstreams_.size()]),
+        options(std::move(options))
+    {
+        if (upstreams_.empty())
+            throw std::invalid_argument("ReverseProxy needs at least one upstream");
+    }
+
+    void ReverseProxy::attach(HttpClient& client) {
+        this->client = &client;
+        if (!options.healthPath.empty())
+            client.eventLoop().post([this]() { check(); });
+    }
+
+    void ReverseProxy::forward(Request& req, Response& res) {
+        if (!client) {
+            res.badGateway();
+            return;
+        }
+
+        ClientRequest request = upstreamRequest(req, res);
+        size_t retries = isIdempotent(req.method) ? options.retries : 0;
+
+        if (res.framed() || !res.connection().loop) {
+            sendBuffered(std::make_shared<Attempt>(Attempt { res.defer(), std::move(request), retries }));
+            return;
+        }
+
+        res.detach();
+        auto relay = std::make_shared<Relay>(*this, req, res, std::move(request), retries);
+
+        // Started from the loop so the relay holds its exchange before any
+        // callback can need it, and only once the middleware has returned,
+        // since the relay writes to the connection.
+        res.whenReturned([loop = &client->eventLoop(), relay]() {
+            loop->post([relay]() { relay->send(); });
+        });
+    }
+
+    size_t ReverseProxy::outstanding(size_t index) const {
+        return backends[index].outstanding.load(std::memory_order_relaxed);
+    }
+
+    bool ReverseProxy::available(size_t index) const {
+        const Backend& backend = backends[index];
+        return backend.healthy.load(std::memory_order_relaxed)
+            && backend.ejectedUntil.load(std::memory_order_relaxed) <= now();
+    }
+
+    // Prefers an upstream other than avoid, the one a retry just failed on.
+    size_t ReverseProxy::pick(size_t avoid) {
+        size_t count = upstreams_.size();
+        int64_t time = now();
+        size_t start = next.fetch_add(1, std::memory_order_relaxed);
+
+        auto load = [&](size_t i) { return backends[i].outstanding.load(std::memory_order_relaxed); };
+        auto usable = [&](size_t i) {
+            return (i != avoid || count == 1)
+                && backends[i].healthy.load(std::memory_order_relaxed)
+                && backends[i].ejectedUntil.load(std::memory_order_relaxed) <= time;
+        };
+
+        if (options.balance == Balance::ROUND_ROBIN) {
+            for (size_t k = 0; k < count; ++k) {
+                size_t i = (start + k) % count;
+                if (usable(i)) return i;
+            }
+        } else {
+            if (options.balance == Balance::TWO_CHOICES && count > 2) {
+                size_t a = randomBelow(count);
+                size_t b = randomBelow(count - 1);
+                if (b >= a) ++b;
+
+                bool first = usable(a), second = usable(b);
+                if (first && second) return load(b) < load(a) ? b : a;
+                if (first) return a;
+                if (second) return b;
+            }
+
+            // Ties go to the first from a rotating start, so idle upstreams
+            // still share the load.
+            size_t best = SIZE_MAX;
+            for (size_t k = 0; k < count; ++k) {
+                size_t i = (start + k) % count;
+                if (usable(i) && (best == SIZE_MAX || load(i) < load(best)))
+                    best = i;
+            }
+            if (best != SIZE_MAX) return best;
+        }
+
+        // Nothing is in rotation. Trying the least busy upstream anyway beats
+        // failing every request until a health check passes.
+        size_t best = SIZE_MAX;
+        for (size_t k = 0; k < count; ++k) {
+            size_t i = (start + k) % count;
+            if ((i != avoid || count == 1) && (best == SIZE_MAX || load(i) < load(best)))
+                best = i;
+        }
+        return best;
+    }
+
+    void ReverseProxy::acquire(size_t index) {
+        backends[index].outstanding.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void ReverseProxy::release(size_t index, bool failed) {
+        Backend& backend = backends[index];
+        backend.outstanding.fetch_sub(1, std::memory_order_relaxed);
+
+        if (!failed) {
+            if (backend.fails.load(std::memory_order_relaxed) != 0)
+                backend.fails.store(0, std::memory_order_relaxed);
+            return;
+        }
+
+        if (options.maxFails != 0
+            && backend.fails.fetch_add(1, std::memory_order_relaxed) + 1 >= options.maxFails) {
+            backend.fails.store(0, std::memory_order_relaxed);
+            backend.ejectedUntil.store(
+                now() + std::chrono::duration_cast<std::chrono::nanoseconds>(options.ejectTime).count(),
+                std::memory_order_relaxed);
+        }
+    }
+
+    // Loop thread. Probes go through the same pool as requests, so a
+    // passing check also leaves a warm connection behind.
+    void ReverseProxy::check() {
+        for (size_t i = 0; i < upstreams_.size(); ++i) {
+            ClientRequest probe;
+            probe.target = options.healthPath;
+            probe.timeout = options.healthTimeout;
+
+            client->send(upstreams_[i], std::move(probe), [this, i](ClientResponse& response) {
+                bool healthy = response.ok() && response.status >= 200 && response.status < 400;
+                backends[i].healthy.store(healthy, std::memory_order_relaxed);
+            });
+        }
+
+        client->eventLoop().after(options.healthInterval, [this]() { check(); });
+    }
+
+    void ReverseProxy::sendBuffered(const std::shared_ptr<Attempt>& attempt) {
+        attempt->backend = pick(attempt->backend);
+        acquire(attempt->backend);
+
+        ClientRequest request = attempt->retries > 0 ? attempt->request : std::move(attempt->request);
+        client->send(upstreams_[attempt->backend], std::move(request), [this, attempt](ClientResponse& response) {
+            bool lost = !response.ok() && response.error != ClientError::TOO_LARGE;
+            release(attempt->backend, lost || failing(response.status));
+
+            if (lost && attempt->retries > 0) {
+                --attempt->retries;
+                sendBuffered(attempt);
+                return;
+            }
+
+            auto collected = std::make_shared<ClientResponse>(std::move(response));
+            attempt->deferred.resolve([collected](Response& res) { answer(res, *collected); });
+        });
+    }
+
+    ClientRequest ReverseProxy::upstreamRequest(Request& req, Response& res) const {
+        ClientRequest request;
+        request.method = req.method;
+
+        // Router::proxy() routes end in *, which matches what follows the
+        // prefix wherever the router is mounted.
+        std::string path = req.path;
+        if (options.stripPrefix) {
+            auto rest = req.params.find("wildcard");
+            path = rest == req.params.end() ? "/" : "/" + rest->second;
+        }
+
+        request.target.clear();
+        if (path.empty() || path.front() != '/')
+            request.target.push_back('/');
+        request.target.append(path);
+        if (!req.query.empty()) {
+            request.target.push_back('?');
+            request.target.append(req.query);
+        }
+
+        auto connection = req.headers.find("connection");
+        const std::string* tokens = connection == req.headers.end() ? nullptr : &connection->second;
+
+        std::string forwardedFor;
+        for (const auto& [name, value] : req.headers) {
+            if (hopByHop(name, tokens) || name == "content-length")
+                continue;
+            if (name == "x-forwarded-for") {
+                forwardedFor = value;
+                continue;
+            }
+            request.headers.emplace_back(name, value);
+        }
+
+        std::string peer = peerAddress(res.connection());
+        if (!peer.empty())
+            forwardedFor = forwardedFor.empty() ? peer : forwardedFor + ", " + peer;
+        if (!forwardedFor.empty())
+            request.headers.emplace_back("x-forwarded-for", std::move(forwardedFor));
+        request.headers.emplace_back("x-forwarded-proto", "http");
+
+        // The server parser has already read the whole body.
+        request.body = std::move(req.body);
+        return request;
+    }
+}
+
+#endif
@@ -1,38 +1,90 @@
 #include "net/TcpServer.h"
+#include <algorithm>
 #include <iostream>
 #include <stdexcept>
 #include <cerrno>
+#include <cstring>
+
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <netinet/tcp.h>
+#endif
 
 namespace mini_http {
-    TcpServer::TcpServer(int port, size_t threads)
-        : port(port), pool(threads) {}
+    TcpServer::TcpServer(int port, size_t threads, Metrics* metrics,
+                        const ServerOptions& options)
+        : port(port), metrics(metrics), options(options)
+    {
+        createShards(threads);
+    }
+
+    void TcpServer::createShards(size_t threads) {
+        std::vector<CpuSet> nodes;
+        if (options.numaAware)
+            nodes = numaNodes();
+
+        // Keep only the requested CPUs of each node, and the nodes left with any.
+        if (!options.workerCpus.empty()) {
+            for (auto& node : nodes) {
+                node.erase(std::remove_if(node.begin(), node.end(), [&](int cpu) {
+                    return std::find(options.workerCpus.begin(), options.workerCpus.end(), cpu)
+                        == options.workerCpus.end();
+                }), node.end());
+            }
+            nodes.erase(std::remove_if(nodes.begin(), nodes.end(),
+                        [](const CpuSet& node) { return node.empty(); }), nodes.end());
+        }
+
+        if (nodes.size() <= 1) {
+            std::vector<CpuSet> affinity;
+            for (int cpu : options.workerCpus)
+                affinity.push_back({ cpu });
+
+            shards.push_back(std::make_unique<Shard>(threads, std::move(affinity)));
+            return;
+        }
+
+        size_t perNode = std::max<size_t>(1, threads / nodes.size());
+        size_t extra = threads > perNode * nodes.size() ? threads - perNode * nodes.size() : 0;
+
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            for (int cpu : nodes[i]) {
+                if (cpu < 0) continue;
+                if (cpuShards.size() <= static_cast<size_t>(cpu))
+                    cpuShards.resize(static_cast<size_t>(cpu) + 1, i);
+                cpuShards[static_cast<size_t>(cpu)] = i;
+            }
+
+            size_t count = perNode + (i < extra ? 1 : 0);
+            shards.push_back(std::make_unique<Shard>(count, std::vector<CpuSet>{ nodes[i] }));
+        }
+    }
+
+    size_t TcpServer::queueDepth() {
+        size_t depth = 0;
+        for (auto& shard : shards)
+            depth += shard->pool.pending();
+        return depth;
+    }
 
     TcpServer::~TcpServer() {
         stop();
-        if (acceptThread.joinable())
-            acceptThread.join();
     }
 
     void TcpServer::start(ConnectionHandler handler) {
         if (running.exchange(true)) return;
 
+        this->handler = std::move(handler);
+
         #ifdef _WIN32
             WSADATA wsaData;
             if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
                 throw std::runtime_error("WSAStartup failed");
-        #else
-            if (pipe(wakeupPipe) != 0)
-                throw std::runtime_error("Failed to create wakeup pipe");
         #endif
 
         serverSocket = socket(AF_INET, SOCK_STREAM, 0);
-        if (serverSocket == INVALID_SOCK) {
-            #ifndef _WIN32
-                ::close(wakeupPipe[0]);
-                ::close(wakeupPipe[1]);
-            #endif
+        if (serverSocket == INVALID_SOCK)
             throw std::runtime_error("Failed to create socket");
-        }
 
         int opt = 1;
         setsockopt(serverSocket, SOL_SOCKET, SO_REUSEADDR,
@@ -42,6 +94,12 @@ namespace mini_http {
                     reinterpret_cast<const char*>(&opt), sizeof(opt));
         #endif
 
+        #ifndef _WIN32
+            fcntl(serverSocket, F_SETFL, fcntl(serverSocket, F_GETFL) | O_NONBLOCK);
+        #endif
+
+        configureListener();
+
         sockaddr_in addr{};
         addr.sin_family = AF_INET;
         addr.sin_addr.s_addr = INADDR_ANY;
@@ -52,106 +110,385 @@ namespace mini_http {
             throw std::runtime_error("Bind failed");
         }
 
-        if (listen(serverSocket, 128) < 0) {
+        if (listen(serverSocket, options.backlog) < 0) {
             closeSocket(serverSocket);
             throw std::runtime_error("Listen failed");
         }
 
         std::cout << "Server running on port " << port << "\n";
 
-        acceptThread = std::thread(&TcpServer::acceptLoop, this, std::move(handler));
-        acceptThread.detach();
+        // Connection buffers are first touched on the shard's own workers.
+        for (auto& shard : shards) {
+            ConnectionPool* connections = &shard->connections;
+            shard->pool.enqueue([connections]() { connections->prewarm(); });
+        }
+
+        acceptThread = std::thread(&TcpServer::acceptLoop, this);
     }
 
     void TcpServer::stop() {
-        if (!running.exchange(false)) return;
+        #ifdef _WIN32
+            if (!running.exchange(false)) return;
 
-        #ifndef _WIN32
-            if (wakeupPipe[1] != INVALID_SOCK) {
-                char byte = 1;
-                (void)::write(wakeupPipe[1], &byte, 1);
+            // accept() only returns once the listener is closed under it.
+            shutdown(serverSocket, SD_BOTH);
+            closeSocket(serverSocket);
+            serverSocket = INVALID_SOCK;
+        #else
+            {
+                // Serialized with park(), so nothing is posted to the loop
+                // after its stop request.
+                std::lock_guard<std::mutex> lock(parkMutex);
+                if (!running.exchange(false)) return;
             }
+            loop.stop();
         #endif
 
-        if (serverSocket != INVALID_SOCK) {
-            #ifdef _WIN32
-                shutdown(serverSocket, SD_BOTH);
-            #else
-                shutdown(serverSocket, SHUT_RDWR);
-            #endif
-            closeSocket(serverSocket);
-            serverSocket = INVALID_SOCK;
-        }
+        if (acceptThread.joinable())
+            acceptThread.join();
 
-        pool.shutdown();
+        closeSocket(serverSocket);
+        serverSocket = INVALID_SOCK;
+
+        for (auto& shard : shards)
+            shard->pool.shutdown();
 
         #ifdef _WIN32
             WSACleanup();
         #endif
     }
 
-    void TcpServer::acceptLoop(ConnectionHandler handler) {
-        while (running.load()) {
-
-            #ifndef _WIN32
-                struct pollfd fds[2];
-                fds[0].fd = serverSocket;
-                fds[0].events = POLLIN;
-                fds[1].fd = wakeupPipe[0];
-                fds[1].events = POLLIN;
+    void TcpServer::acceptLoop() {
+        if (options.acceptCpu >= 0)
+            pinCurrentThread({ options.acceptCpu });
 
-                int ready = poll(fds, 2, -1);
-                if (ready < 0) {
-                    if (errno == EINTR) continue;
-                    std::cerr << "poll() failed: " << strerror(errno) << "\n";
-                    break;
-                }
+        #ifdef _WIN32
+            while (running.load()) {
+                acceptOne();
+                handOff();
+            }
+        #else
+            watchListener();
 
-                if (fds[1].revents & POLLIN) break;
+            loop.run();
 
-                if (!(fds[0].revents & POLLIN)) continue;
-            #endif
+            loop.unwatch(serverSocket);
+            for (const auto& [conn, timer] : idle)
+                closeConnection(conn);
+            idle.clear();
+            for (const auto& [conn, timer] : draining)
+                closeConnection(conn);
+            draining.clear();
+        #endif
+    }
 
+    #ifdef _WIN32
+        void TcpServer::acceptOne() {
             socket_t clientSocket = accept(serverSocket, nullptr, nullptr);
 
             if (clientSocket == INVALID_SOCK) {
-                if (!running.load()) break;
-                #ifndef _WIN32
-                    if (errno == EINTR) continue;
-                #endif
+                if (!running.load()) return;
                 std::cerr << "accept() failed\n";
-                continue;
+                if (metrics) metrics->increment(Metrics::ACCEPT_ERRORS);
+                return;
             }
 
-            applyReceiveTimeout(clientSocket, 2);
+            if (metrics) metrics->increment(Metrics::ACCEPTED_CONNECTIONS);
 
-            try {
-                pool.enqueue([handler, conn = std::make_shared<Connection>(clientSocket)]() {
-                try {
-                    bool keepAlive = true;
-                    while (keepAlive)
-                        keepAlive = handler(*conn);
-                }
-                catch (const std::exception& e) {
-                        std::cerr << "Handler exception: " << e.what() << "\n";
-                }
-                catch (...) {
-                    std::cerr << "Handler exception\n";
+            configureClient(clientSocket);
+
+            dispatch(acquire(clientSocket));
+        }
+    #else
+        void TcpServer::watchListener() {
+            loop.watch(serverSocket, EventLoop::READABLE, [this]() {
+                acceptBatch();
+                handOff();
+            }, true);
+        }
+
+        // Drains the listen queue until EAGAIN (or a batch limit, so parked
+        // connections are still polled under a connection storm).
+        void TcpServer::acceptBatch() {
+            uint64_t accepted = 0;
+
+            while (accepted < ACCEPT_BATCH) {
+                #ifdef SOCK_NONBLOCK
+                    socket_t clientSocket = accept4(serverSocket, nullptr, nullptr,
+                                                    SOCK_NONBLOCK | SOCK_CLOEXEC);
+                #else
+                    socket_t clientSocket = accept(serverSocket, nullptr, nullptr);
+                    if (clientSocket != INVALID_SOCK) {
+                        fcntl(clientSocket, F_SETFL, fcntl(clientSocket, F_GETFL) | O_NONBLOCK);
+                        fcntl(clientSocket, F_SETFD, FD_CLOEXEC);
+                    }
+                #endif
+
+                if (clientSocket == INVALID_SOCK) {
+                    if (errno == EINTR || errno == ECONNABORTED) continue;
+                    if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+
+                    pauseAccept(errno);
+                    break;
                 }
-                });
+
+                ++accepted;
+                configureClient(clientSocket);
+
+                Connection* conn = acquire(clientSocket);
+                conn->ioTimeout = options.readTimeout;
+                dispatch(conn);
+            }
+
+            if (metrics && accepted)
+                metrics->increment(Metrics::ACCEPTED_CONNECTIONS, accepted);
+        }
+
+        // The pending connection stays queued, so a level-triggered listener
+        // would fire again at once: out of descriptors (EMFILE, ENFILE) or
+        // memory, the accept thread would spin. Stop watching for a while
+        // instead, and report at most one failure a second.
+        void TcpServer::pauseAccept(int error) {
+            if (metrics) metrics->increment(Metrics::ACCEPT_ERRORS);
+
+            auto now = std::chrono::steady_clock::now();
+            if (now - acceptErrorLogged >= std::chrono::seconds(1)) {
+                std::cerr << "accept() failed: " << strerror(error);
+                if (acceptErrorsSkipped)
+                    std::cerr << " (" << acceptErrorsSkipped << " more not shown)";
+                std::cerr << "\n";
+                acceptErrorLogged = now;
+                acceptErrorsSkipped = 0;
+            } else {
+                ++acceptErrorsSkipped;
+            }
+
+            loop.unwatch(serverSocket);
+            loop.after(ACCEPT_BACKOFF, [this]() {
+                if (running.load())
+                    watchListener();
+            });
+        }
+    #endif
+
+    // Picks the shard on the NUMA node whose CPU handled the connection's
+    // packets, so its buffers and worker stay local to that node.
+    Connection* TcpServer::acquire(socket_t s) {
+        size_t index = 0;
+
+        if (shards.size() > 1) {
+            index = nextShard++ % shards.size();
+
+            #ifdef SO_INCOMING_CPU
+                int cpu = -1;
+                socklen_t len = sizeof(cpu);
+                if (getsockopt(s, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &len) == 0
+                    && cpu >= 0 && static_cast<size_t>(cpu) < cpuShards.size())
+                    index = cpuShards[static_cast<size_t>(cpu)];
+            #endif
+        }
+
+        Connection* conn = shards[index]->connections.acquire(s);
+        conn->shard = index;
+        #ifndef _WIN32
+            conn->loop = &loop;
+        #endif
+        return conn;
+    }
+
+    void TcpServer::dispatch(Connection* conn) {
+        Shard& shard = *shards[conn->shard];
+        conn->readyAt = std::chrono::steady_clock::now();
+        shard.handoffConnections.push_back(conn);
+        shard.handoffTasks.push_back([this, conn]() { serve(conn); });
+    }
+
+    void TcpServer::handOff() {
+        for (auto& shard : shards) {
+            if (shard->handoffConnections.empty()) continue;
+
+            try {
+                shard->pool.enqueueBatch(shard->handoffTasks);
             }
             catch (const std::exception& e) {
                 std::cerr << "Failed to enqueue task: " << e.what() << "\n";
-                closeSocket(clientSocket);
+                for (Connection* conn : shard->handoffConnections)
+                    closeConnection(conn);
+                shard->handoffTasks.clear();
+            }
+
+            shard->handoffConnections.clear();
+        }
+    }
+
+    void TcpServer::serve(Connection* conn) {
+        try {
+            HandlerResult result = HandlerResult::KEEP_ALIVE;
+            while (result == HandlerResult::KEEP_ALIVE) {
+                ++conn->requests;
+                conn->allowKeepAlive = running.load()
+                    && (options.maxRequests == 0 || conn->requests < options.maxRequests);
+
+                result = handler(*conn);
+
+                // Whoever completes a detached response calls resume().
+                if (result == HandlerResult::DETACHED)
+                    return;
+
+                // A response completed from the loop before the handler
+                // returned may have left output queued.
+                if (conn->hasQueued() && !conn->flush())
+                    result = HandlerResult::CLOSE;
+
+                finishRequest(conn);
+
+                #ifndef _WIN32
+                    if (result == HandlerResult::KEEP_ALIVE && conn->readBuffer.empty()) {
+                        pollfd pfd { conn->raw(), POLLIN, 0 };
+                        if (poll(&pfd, 1, 0) == 0) {
+                            park(conn);
+                            return;
+                        }
+                    }
+                #endif
+            }
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Handler exception: " << e.what() << "\n";
+        }
+        catch (...) {
+            std::cerr << "Handler exception\n";
+        }
+
+        closeConnection(conn);
+    }
+
+    void TcpServer::submit(Connection* conn, std::function<void()> task) {
+        shards[conn->shard]->pool.enqueue(std::move(task));
+    }
+
+    void TcpServer::resume(Connection* conn, bool keepAlive) {
+        #ifndef _WIN32
+            if (conn->hasQueued()) {
+                drain(conn, keepAlive);
+                return;
             }
+        #endif
+
+        finishRequest(conn);
+
+        if (!keepAlive) {
+            closeConnection(conn);
+            return;
         }
 
         #ifndef _WIN32
-            if (wakeupPipe[0] != INVALID_SOCK) { ::close(wakeupPipe[0]); wakeupPipe[0] = INVALID_SOCK; }
-            if (wakeupPipe[1] != INVALID_SOCK) { ::close(wakeupPipe[1]); wakeupPipe[1] = INVALID_SOCK; }
+            if (conn->readBuffer.empty()) {
+                park(conn);
+                return;
+            }
         #endif
+
+        try {
+            shards[conn->shard]->pool.enqueue([this, conn]() { serve(conn); });
+        }
+        catch (const std::exception&) {
+            closeConnection(conn);
+        }
+    }
+
+    void TcpServer::finishRequest(Connection* conn) {
+        if (options.quickAck)
+            rearmQuickAck(conn->raw());
+
+        if (metrics) {
+            metrics->increment(Metrics::BYTES_IN, conn->bytesIn);
+            metrics->increment(Metrics::BYTES_OUT, conn->bytesOut);
+            conn->bytesIn = 0;
+            conn->bytesOut = 0;
+        }
     }
 
+    void TcpServer::closeConnection(Connection* conn) {
+        if (metrics) metrics->increment(Metrics::CLOSED_CONNECTIONS);
+        shards[conn->shard]->connections.release(conn);
+    }
+
+    #ifndef _WIN32
+        void TcpServer::park(Connection* conn) {
+            std::unique_lock<std::mutex> lock(parkMutex);
+
+            if (!running.load()) {
+                lock.unlock();
+                closeConnection(conn);
+                return;
+            }
+
+            loop.post([this, conn]() { watchIdle(conn); });
+        }
+
+        // Loop thread: wait for the next request or the idle deadline.
+        void TcpServer::watchIdle(Connection* conn) {
+            idle[conn] = loop.after(options.idleTimeout, [this, conn]() {
+                loop.unwatch(conn->raw());
+                idle.erase(conn);
+                closeConnection(conn);
+            });
+
+            loop.watch(conn->raw(), EventLoop::READABLE, [this, conn]() {
+                auto it = idle.find(conn);
+                loop.cancel(it->second);
+                idle.erase(it);
+
+                dispatch(conn);
+                handOff();
+            });
+        }
+
+        // Responses sent from the loop only write what the socket takes at
+        // once; the rest goes out here, without holding the loop or a
+        // worker, before the connection moves on.
+        void TcpServer::drain(Connection* conn, bool keepAlive) {
+            std::unique_lock<std::mutex> lock(parkMutex);
+
+            if (!running.load()) {
+                lock.unlock();
+                conn->discardQueue();
+                resume(conn, false);
+                return;
+            }
+
+            loop.post([this, conn, keepAlive]() { watchDrain(conn, keepAlive); });
+        }
+
+        // Loop thread: write what the socket takes, then wait until it takes
+        // more, giving up after readTimeout without progress.
+        void TcpServer::watchDrain(Connection* conn, bool keepAlive) {
+            if (!conn->flushSome())
+                keepAlive = false;
+
+            if (!conn->hasQueued()) {
+                resume(conn, keepAlive);
+                return;
+            }
+
+            draining[conn] = loop.after(options.readTimeout, [this, conn]() {
+                loop.unwatch(conn->raw());
+                draining.erase(conn);
+                conn->discardQueue();
+                resume(conn, false);
+            });
+
+            loop.watch(conn->raw(), EventLoop::WRITABLE, [this, conn, keepAlive]() {
+                auto it = draining.find(conn);
+                loop.cancel(it->second);
+                draining.erase(it);
+
+                watchDrain(conn, keepAlive);
+            });
+        }
+    #endif
+
     void TcpServer::closeSocket(socket_t s) {
         if (s == INVALID_SOCK) return;
         #ifdef _WIN32
@@ -161,16 +498,76 @@ namespace mini_http {
         #endif
     }
 
-    void TcpServer::applyReceiveTimeout(socket_t s, int seconds) {
+    static void setOption(socket_t s, int level, int name, int value, const char* label) {
+        if (setsockopt(s, level, name, reinterpret_cast<const char*>(&value), sizeof(value)) != 0)
+            std::cerr << "Warning: failed to set " << label << "\n";
+    }
+
+    // Linux copies these from the listener to every accepted socket, so
+    // there they are set once instead of once per connection.
+    #ifdef __linux__
+        static constexpr bool INHERITS_OPTIONS = true;
+    #else
+        static constexpr bool INHERITS_OPTIONS = false;
+    #endif
+
+    void TcpServer::configureListener() {
+        if (INHERITS_OPTIONS)
+            applyConnectionOptions(serverSocket);
+
+        if (options.receiveBuffer > 0)
+            setOption(serverSocket, SOL_SOCKET, SO_RCVBUF, options.receiveBuffer, "SO_RCVBUF");
+        if (options.sendBuffer > 0)
+            setOption(serverSocket, SOL_SOCKET, SO_SNDBUF, options.sendBuffer, "SO_SNDBUF");
+
+        #ifdef TCP_DEFER_ACCEPT
+            if (options.deferAccept > 0)
+                setOption(serverSocket, IPPROTO_TCP, TCP_DEFER_ACCEPT, options.deferAccept, "TCP_DEFER_ACCEPT");
+        #endif
+        #ifdef TCP_FASTOPEN
+            if (options.fastOpen > 0)
+                setOption(serverSocket, IPPROTO_TCP, TCP_FASTOPEN, options.fastOpen, "TCP_FASTOPEN");
+        #endif
+    }
+
+    void TcpServer::configureClient(socket_t s) {
+        if (!INHERITS_OPTIONS)
+            applyConnectionOptions(s);
+        if (options.quickAck)
+            rearmQuickAck(s);
+
+        // Non-blocking sockets time out in Connection instead.
         #ifdef _WIN32
-            DWORD timeout = static_cast<DWORD>(seconds) * 1000;
-            if (setsockopt(s, SOL_SOCKET, SO_RCVTIMEO,
-                        reinterpret_cast<const char*>(&timeout), sizeof(timeout)) != 0)
-                std::cerr << "Warning: failed to set SO_RCVTIMEO\n";
+            applyReceiveTimeout(s, options.readTimeout);
+        #endif
+    }
+
+    void TcpServer::applyConnectionOptions(socket_t s) {
+        if (options.noDelay)
+            setOption(s, IPPROTO_TCP, TCP_NODELAY, 1, "TCP_NODELAY");
+
+        #ifdef SO_BUSY_POLL
+            if (options.busyPoll > 0)
+                setOption(s, SOL_SOCKET, SO_BUSY_POLL, options.busyPoll, "SO_BUSY_POLL");
+        #endif
+    }
+
+    // Linux drops out of quick-ack mode on its own, so it is re-enabled
+    // after each request rather than set once.
+    void TcpServer::rearmQuickAck(socket_t s) {
+        #ifdef TCP_QUICKACK
+            setOption(s, IPPROTO_TCP, TCP_QUICKACK, 1, "TCP_QUICKACK");
         #else
-            struct timeval tv { seconds, 0 };
-            if (setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) != 0)
-                std::cerr << "Warning: failed to set SO_RCVTIMEO\n";
+            (void)s;
         #endif
     }
-}
\ No newline at end of file
+
+    #ifdef _WIN32
+        void TcpServer::applyReceiveTimeout(socket_t s, std::chrono::milliseconds timeout) {
+            DWORD millis = static_cast<DWORD>(timeout.count());
+            if (setsockopt(s, SOL_SOCKET, SO_RCVTIMEO,
+                        reinterpret_cast<const char*>(&millis), sizeof(millis)) != 0)
+                std::cerr << "Warning: failed to set SO_RCVTIMEO\n";
+        }
+    #endif
+}
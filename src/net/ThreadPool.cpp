@@ -2,13 +2,17 @@
 #include <stdexcept>
 
 namespace mini_http {
-    ThreadPool::ThreadPool(size_t threadCount)
+    ThreadPool::ThreadPool(size_t threadCount, std::vector<CpuSet> affinity)
         : stop(false)
     {
         workers.reserve(threadCount);
 
         for (size_t i = 0; i < threadCount; ++i) {
-            workers.emplace_back([this]() {
+            CpuSet cpus = affinity.empty() ? CpuSet{} : affinity[i % affinity.size()];
+
+            workers.emplace_back([this, cpus = std::move(cpus)]() {
+                if (!cpus.empty())
+                    pinCurrentThread(cpus);
 
                 while (true) {
                     std::function<void()> task;
@@ -16,14 +20,19 @@ namespace mini_http {
                         std::unique_lock<std::mutex> lock(mtx);
 
                         cv.wait(lock, [this]() {
-                            return stop.load() || !tasks.empty();
+                            return stop.load() || queued > 0;
                         });
 
-                        if (stop.load() && tasks.empty())
+                        if (stop.load() && queued == 0)
                             return;
 
-                        task = std::move(tasks.front());
-                        tasks.pop();
+                        for (auto& queue : tasks) {
+                            if (queue.empty()) continue;
+                            task = std::move(queue.front());
+                            queue.pop();
+                            break;
+                        }
+                        --queued;
                     }
 
                     try {
@@ -37,7 +46,7 @@ namespace mini_http {
         }
     }
 
-    void ThreadPool::enqueue(std::function<void()> task) {
+    void ThreadPool::enqueue(std::function<void()> task, Priority priority) {
         {
             std::lock_guard<std::mutex> lock(mtx);
 
@@ -45,12 +54,46 @@ namespace mini_http {
                 throw std::runtime_error("ThreadPool is stopped. Cannot enqueue new tasks.");
             }
 
-            tasks.push(std::move(task));
+            queueOf(priority).push(std::move(task));
+            ++queued;
         }
 
         cv.notify_one();
     }
 
+    void ThreadPool::enqueueBatch(std::vector<std::function<void()>>& batch) {
+        if (batch.empty()) return;
+
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+
+            if (stop.load()) {
+                throw std::runtime_error("ThreadPool is stopped. Cannot enqueue new tasks.");
+            }
+
+            for (auto& task : batch)
+                queueOf(Priority::NORMAL).push(std::move(task));
+            queued += batch.size();
+        }
+
+        if (batch.size() == 1)
+            cv.notify_one();
+        else
+            cv.notify_all();
+
+        batch.clear();
+    }
+
+    size_t ThreadPool::pending() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return queued;
+    }
+
+    size_t ThreadPool::pending(Priority priority) {
+        std::lock_guard<std::mutex> lock(mtx);
+        return queueOf(priority).size();
+    }
+
     void ThreadPool::shutdown() {
         {
             std::lock_guard<std::mutex> lock(mtx);
@@ -0,0 +1,392 @@
+#ifndef _WIN32
+
+#include "net/WebSocket.h"
+#include "http/Request.h"
+#include "http/Response.h"
+
+#include <cerrno>
+
+namespace mini_http {
+    static constexpr uint16_t INTERNAL_ERROR = 1011;
+    static constexpr int READS_PER_WAKEUP = 16;
+    static constexpr std::chrono::seconds CLOSE_TIMEOUT { 1 };
+
+    WebSocketHub::WebSocketHub(WebSocketHandlers handlers)
+        : handlers(std::move(handlers))
+    {
+    }
+
+    void WebSocketHub::upgrade(Request& req, Response& res,
+                            std::function<void(Connection*)> release)
+    {
+        auto header = [&](const char* name) -> const std::string* {
+            auto it = req.headers.find(name);
+            return it == req.headers.end() ? nullptr : &it->second;
+        };
+
+        const std::string* key = header("sec-websocket-key");
+        const std::string* version = header("sec-websocket-version");
+
+        if (req.method != HttpMethod::GET || !req.hasToken("upgrade", "websocket")
+            || !req.hasToken("connection", "upgrade") || !key || key->empty()) {
+            res.badRequest("Expected a WebSocket upgrade");
+            return;
+        }
+
+        if (!version || *version != "13") {
+            res.setHeader("Sec-WebSocket-Version", "13");
+            res.badRequest("Unsupported WebSocket version");
+            return;
+        }
+
+        res.switchProtocols({
+            { "Upgrade", "websocket" },
+            { "Connection", "Upgrade" },
+            { "Sec-WebSocket-Accept", webSocketAccept(*key) }
+        }, [this, params = req.params, release = std::move(release)](Connection& conn) mutable {
+            if (!conn.loop) {
+                release(&conn);
+                return;
+            }
+
+            auto socket = std::make_shared<WebSocket>(*this, conn, std::move(params), std::move(release));
+            conn.loop->post([socket]() { socket->start(); });
+        });
+    }
+
+    WebSocket::Frame WebSocketHub::frame(WebSocketOpcode opcode, std::string_view payload) {
+        auto bytes = std::make_shared<std::string>();
+        bytes->reserve(payload.size() + 10);
+        appendWebSocketHeader(*bytes, opcode, payload.size());
+        bytes->append(payload);
+        return bytes;
+    }
+
+    void WebSocketHub::broadcast(std::string_view message, bool binary) {
+        EventLoop* target = loop.load();
+        if (!target || count.load() == 0) return;
+
+        auto fanOut = [this, bytes = frame(binary ? WebSocketOpcode::BINARY : WebSocketOpcode::TEXT, message)]() {
+            for (auto& socket : sockets)
+                if (!socket->closed && !socket->closeSent)
+                    socket->enqueue(bytes);
+
+            if (!flushScheduled && !sockets.empty()) {
+                flushScheduled = true;
+                loop.load()->post([this]() { flushAll(); });
+            }
+        };
+
+        if (target->inLoopThread())
+            fanOut();
+        else
+            target->post(std::move(fanOut));
+    }
+
+    void WebSocketHub::flushAll() {
+        flushScheduled = false;
+        for (auto& socket : sockets)
+            if (!socket->closed && socket->conn.hasQueued())
+                socket->flush();
+    }
+
+    void WebSocketHub::add(const std::shared_ptr<WebSocket>& socket) {
+        loop.store(&socket->loop);
+        socket->index = sockets.size();
+        sockets.push_back(socket);
+        count.fetch_add(1);
+    }
+
+    void WebSocketHub::remove(WebSocket& socket) {
+        size_t index = socket.index;
+        if (index >= sockets.size() || sockets[index].get() != &socket) return;
+
+        std::swap(sockets[index], sockets.back());
+        sockets[index]->index = index;
+        sockets.pop_back();
+        count.fetch_sub(1);
+    }
+
+    WebSocket::WebSocket(WebSocketHub& hub, Connection& conn, Params params,
+                        std::function<void(Connection*)> release)
+        : hub(hub),
+        conn(conn),
+        loop(*conn.loop),
+        params_(std::move(params)),
+        release(std::move(release))
+    {
+    }
+
+    void WebSocket::start() {
+        hub.add(shared_from_this());
+        watch(false);
+
+        try {
+            if (hub.handlers.open)
+                hub.handlers.open(*this);
+        } catch (const std::exception& e) {
+            fail(INTERNAL_ERROR, e.what());
+            return;
+        }
+
+        // Frames may have arrived along with the handshake.
+        if (!closed && !conn.readBuffer.empty())
+            process();
+    }
+
+    void WebSocket::send(std::string_view message, bool binary) {
+        auto bytes = WebSocketHub::frame(binary ? WebSocketOpcode::BINARY : WebSocketOpcode::TEXT, message);
+        auto write = [self = shared_from_this(), bytes]() {
+            if (self->closed || self->closeSent) return;
+            self->enqueue(bytes);
+            self->flush();
+        };
+
+        if (loop.inLoopThread())
+            write();
+        else
+            loop.post(std::move(write));
+    }
+
+    void WebSocket::close(uint16_t code, std::string_view reason) {
+        auto start = [self = shared_from_this(), code, reason = std::string(reason)]() {
+            if (self->closed || self->closeSent) return;
+            self->sendClose(code, reason);
+            self->flush();
+
+            // Give the peer a moment to answer the close before dropping it.
+            self->loop.after(CLOSE_TIMEOUT, [self, code]() { self->terminate(code); });
+        };
+
+        if (loop.inLoopThread())
+            start();
+        else
+            loop.post(std::move(start));
+    }
+
+    void WebSocket::onReady() {
+        if (conn.hasQueued()) {
+            flush();
+            if (closed) return;
+        }
+        readAvailable();
+    }
+
+    // Bounded per wakeup so one busy client cannot starve the others;
+    // level-triggered readiness brings the loop back for the rest.
+    void WebSocket::readAvailable() {
+        char buffer[16384];
+
+        for (int i = 0; i < READS_PER_WAKEUP; ++i) {
+            ssize_t n = ::recv(conn.raw(), buffer, sizeof(buffer), 0);
+
+            if (n > 0) {
+                conn.bytesIn += static_cast<uint64_t>(n);
+                conn.readBuffer.append(buffer, static_cast<size_t>(n));
+                if (static_cast<size_t>(n) < sizeof(buffer)) break;
+                continue;
+            }
+
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+
+            terminate(draining ? closeCode : WebSocketClose::ABNORMAL);
+            return;
+        }
+
+        process();
+    }
+
+    void WebSocket::process() {
+        std::string& buffer = conn.readBuffer;
+        size_t offset = 0;
+
+        // Nothing read after a close is delivered.
+        if (draining) {
+            buffer.clear();
+            return;
+        }
+
+        try {
+            while (!closed && !draining) {
+                WebSocketFrame frame;
+                size_t used = parseWebSocketFrame(buffer.data() + offset, buffer.size() - offset,
+                                                hub.handlers.maxMessageSize, frame);
+                if (used == 0) break;
+
+                offset += used;
+                handle(frame);
+            }
+        } catch (const WebSocketError& e) {
+            fail(e.code(), e.what());
+        } catch (const std::exception& e) {
+            fail(INTERNAL_ERROR, e.what());
+        }
+
+        if (!closed && offset > 0)
+            buffer.erase(0, offset);
+    }
+
+    void WebSocket::handle(const WebSocketFrame& frame) {
+        switch (frame.opcode) {
+            case WebSocketOpcode::PING:
+                enqueue(WebSocketHub::frame(WebSocketOpcode::PONG, frame.payload));
+                flush();
+                break;
+
+            case WebSocketOpcode::PONG:
+                break;
+
+            case WebSocketOpcode::CLOSE: {
+                if (frame.payload.size() == 1)
+                    throw WebSocketError(WebSocketClose::PROTOCOL_ERROR, "Invalid close payload");
+
+                uint16_t code = WebSocketClose::NO_STATUS;
+                if (frame.payload.size() >= 2) {
+                    code = static_cast<uint16_t>((static_cast<uint8_t>(frame.payload[0]) << 8)
+                                                | static_cast<uint8_t>(frame.payload[1]));
+                    if (!validCloseCode(code))
+                        throw WebSocketError(WebSocketClose::PROTOCOL_ERROR, "Invalid close code");
+                }
+                if (frame.payload.size() > 2 && !validUtf8(frame.payload.substr(2)))
+                    throw WebSocketError(WebSocketClose::INVALID_PAYLOAD, "Invalid UTF-8 in close reason");
+
+                if (!closeSent) {
+                    sendClose(code == WebSocketClose::NO_STATUS ? WebSocketClose::NORMAL : code, {});
+                    flush();
+                }
+                finish(code);
+                break;
+            }
+
+            case WebSocketOpcode::TEXT:
+            case WebSocketOpcode::BINARY:
+                if (inMessage)
+                    throw WebSocketError(WebSocketClose::PROTOCOL_ERROR, "Expected a continuation frame");
+
+                if (frame.fin) {
+                    deliver(frame.payload, frame.opcode == WebSocketOpcode::BINARY);
+                } else {
+                    message.assign(frame.payload);
+                    messageOpcode = frame.opcode;
+                    inMessage = true;
+                }
+                break;
+
+            case WebSocketOpcode::CONTINUATION:
+                if (!inMessage)
+                    throw WebSocketError(WebSocketClose::PROTOCOL_ERROR, "Unexpected continuation frame");
+                if (message.size() + frame.payload.size() > hub.handlers.maxMessageSize)
+                    throw WebSocketError(WebSocketClose::TOO_BIG, "Message too large");
+
+                message.append(frame.payload);
+                if (frame.fin) {
+                    inMessage = false;
+                    deliver(message, messageOpcode == WebSocketOpcode::BINARY);
+                    message.clear();
+                }
+                break;
+        }
+    }
+
+    // RFC 6455 8.1: a text message that is not UTF-8 fails the connection.
+    void WebSocket::deliver(std::string_view payload, bool binary) {
+        if (!binary && !validUtf8(payload))
+            throw WebSocketError(WebSocketClose::INVALID_PAYLOAD, "Invalid UTF-8 in text message");
+
+        if (hub.handlers.message)
+            hub.handlers.message(*this, payload, binary);
+    }
+
+    void WebSocket::enqueue(Frame frame) {
+        conn.queue(std::move(frame));
+
+        if (conn.queuedBytes() > hub.handlers.maxBufferedBytes)
+            terminate(WebSocketClose::POLICY_VIOLATION);
+    }
+
+    void WebSocket::flush() {
+        if (closed) return;
+
+        if (!conn.flushSome()) {
+            terminate(WebSocketClose::ABNORMAL);
+            return;
+        }
+
+        if (draining && !conn.hasQueued()) {
+            terminate(closeCode);
+            return;
+        }
+
+        if (watchingWritable != conn.hasQueued())
+            watch(conn.hasQueued());
+    }
+
+    void WebSocket::watch(bool writable) {
+        watchingWritable = writable;
+        int interest = EventLoop::READABLE;
+        if (writable) interest |= EventLoop::WRITABLE;
+
+        loop.watch(conn.raw(), interest,
+                [self = shared_from_this()]() { self->onReady(); }, true);
+    }
+
+    void WebSocket::sendClose(uint16_t code, std::string_view reason) {
+        std::string payload;
+        payload.push_back(static_cast<char>(code >> 8));
+        payload.push_back(static_cast<char>(code & 0xFF));
+        payload.append(reason.substr(0, 123));
+
+        enqueue(WebSocketHub::frame(WebSocketOpcode::CLOSE, payload));
+        closeSent = true;
+    }
+
+    void WebSocket::fail(uint16_t code, std::string_view reason) {
+        if (closed) return;
+        if (!closeSent) {
+            sendClose(code, reason);
+            flush();
+        }
+        finish(code);
+    }
+
+    // Ends the connection once the close frame is written rather than
+    // dropping what is still queued; a peer that stops reading is cut off
+    // after CLOSE_TIMEOUT.
+    void WebSocket::finish(uint16_t code) {
+        if (closed || draining) return;
+        if (!conn.hasQueued()) {
+            terminate(code);
+            return;
+        }
+
+        draining = true;
+        closeCode = code;
+        loop.after(CLOSE_TIMEOUT, [self = shared_from_this(), code]() { self->terminate(code); });
+    }
+
+    // Stops watching at once but unregisters and releases the connection
+    // from a later loop pass, so callers iterating the hub's sockets (or
+    // still reading the connection's buffer) stay valid.
+    void WebSocket::terminate(uint16_t code) {
+        if (closed) return;
+        closed = true;
+        loop.unwatch(conn.raw());
+
+        loop.post([self = shared_from_this(), code]() {
+            self->hub.remove(*self);
+            self->conn.discardQueue();
+
+            try {
+                if (self->hub.handlers.close)
+                    self->hub.handlers.close(*self, code);
+            } catch (...) {
+            }
+
+            self->conn.readBuffer.clear();
+            self->release(&self->conn);
+        });
+    }
+}
+
+#endif
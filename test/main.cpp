@@ -3,7 +3,11 @@
 #include <vector>
 #include <string>
 #include <algorithm>
+#include <atomic>
 #include <mutex>
+#include <thread>
+#include <chrono>
+#include <stdexcept>
 #include <nlohmann/json.hpp>
 
 using namespace mini_http;
@@ -144,6 +148,73 @@ void getProductVariant(Request& req, Response& res) {
     res.ok(it->toJson(variant));
 }
 
+void deferred(Request& req, Response& res) {
+    std::thread([done = res.defer()]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        done.send("deferred");
+    }).detach();
+}
+
+// A deferred response far larger than the socket buffer, sent from the
+// event loop.
+void deferredLarge(Request& req, Response& res) {
+    std::thread([done = res.defer()]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        done.send(std::string(4 * 1024 * 1024, 'x'));
+    }).detach();
+}
+
+// Resolved before the handler has even returned.
+void deferredNow(Request& req, Response& res) {
+    res.defer().send("deferred");
+}
+
+// Spans many HTTP/2 DATA frames and more than the initial flow-control
+// window; the pattern shows reordered or dropped bytes.
+void large(Request& req, Response& res) {
+    std::string body(256 * 1024, '\0');
+    for (size_t i = 0; i < body.size(); ++i)
+        body[i] = static_cast<char>('a' + i % 26);
+    res.send(body);
+}
+
+// Counts its runs, so a cached response shows as a repeated number. The
+// variants under /cached/ must never be served from the cache.
+std::atomic<int> cachedRuns{0};
+
+void cachedCounter(Request& req, Response& res) {
+    std::string run = std::to_string(++cachedRuns);
+    if (req.path == "/cached/cookie")
+        res.setHeader("Set-Cookie", "session=" + run);
+    else if (req.path == "/cached/private")
+        res.setHeader("Cache-Control", "private, max-age=60");
+    else if (req.path == "/cached/vary")
+        res.setHeader("Vary", "Accept-Language");
+    else if (req.path == "/cached/optout")
+        res.shareable(false);
+    res.send(run);
+}
+
+// Defers, then throws while the deferred send is still pending.
+void deferThenThrow(Request& req, Response& res) {
+    std::thread([done = res.defer()]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        done.send("late");
+    }).detach();
+    throw std::runtime_error("handler failed after defer()");
+}
+
+// Event fields built from client input must not break the stream framing.
+void openEvents(EventStream& stream) {
+    try {
+        stream.send("injected", "", "1\nevent: admin");
+    } catch (const std::invalid_argument&) {
+        stream.send("rejected");
+    }
+    stream.send("a\rb");
+    stream.close();
+}
+
 int main() {
     Router users;
     users.get("/", getAllUsers);
@@ -157,14 +228,56 @@ int main() {
 
     App app(4);
 
+    // Small enough that large responses queue in the server, not the kernel.
+    ServerOptions options;
+    options.sendBuffer = 64 * 1024;
+    app.serverOptions(options);
+    app.keepAlive(50);
+
     app.use([](Request& req, Response& res, Next next) {
         std::cout << "[" << req.path << "]\n";
         next();
     });
 
+    // Touches the response once the handler has returned, as header and
+    // logging middleware do.
+    app.use([](Request& req, Response& res, Next next) {
+        next();
+        if (req.path.rfind("/late/", 0) == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            res.setHeader("X-Unwound", "1");
+        }
+    });
+
     app.use("/users", users);
     app.use("/products", products);
 
+    app.getStatic("/health", HttpStatus::OK, "ok");
+    app.exposeMetrics("/metrics");
+
+    app.get("/defer", deferred);
+    app.get("/deferthrow", deferThenThrow);
+    app.get("/deferlarge", deferredLarge);
+    for (const char* path : { "/cached", "/cached/cookie", "/cached/private", "/cached/vary", "/cached/optout" })
+        app.get(path, cachedCounter).cache(std::chrono::seconds(5));
+
+    app.get("/large", large);
+    app.get("/slow", [](Request& req, Response& res) { res.send("in time"); })
+        .deadline(std::chrono::milliseconds(50));
+
+    app.get("/late/defer", deferredNow);
+    app.get("/late/offload", [](Request& req, Response& res) { res.send("offloaded"); }).offload();
+
+    WebSocketHandlers echo;
+    echo.message = [](WebSocket& ws, std::string_view message, bool binary) {
+        ws.send(message, binary);
+    };
+    app.ws("/echo", echo);
+
+    EventStreamHandlers events;
+    events.open = openEvents;
+    app.sse("/events", events);
+
     std::cout << "Server running on http://localhost:8080\n";
     app.start(8080);
 
@@ -1,3 +1,6 @@
+const net = require("net");
+const http2 = require("http2");
+
 const BASE = "http://localhost:8080";
 
 let passed = 0;
@@ -50,6 +53,93 @@ async function assertJson(res) {
   }
 }
 
+// Writes raw bytes on one connection and collects what the server sends
+// until it closes the socket or `ms` passes.
+function rawExchange(payload, ms = 1000) {
+  return new Promise((resolve, reject) => {
+    const socket = net.connect(8080, "localhost");
+    let data = Buffer.alloc(0);
+    const done = closed => {
+      clearTimeout(timer);
+      socket.destroy();
+      resolve({ text: data.toString("latin1"), closed });
+    };
+    const timer = setTimeout(() => done(false), ms);
+    socket.on("connect", () => socket.write(payload));
+    socket.on("data", chunk => { data = Buffer.concat([data, chunk]); });
+    socket.on("end", () => done(true));
+    socket.on("error", reject);
+  });
+}
+
+// A masked client frame, as browsers send them.
+function wsFrame(opcode, payload = "", fin = true) {
+  const data = Buffer.from(payload);
+  const mask = Buffer.from([0x37, 0xfa, 0x21, 0x3d]);
+  let header;
+  if (data.length < 126) {
+    header = Buffer.from([(fin ? 0x80 : 0) | opcode, 0x80 | data.length]);
+  } else if (data.length <= 0xffff) {
+    header = Buffer.from([(fin ? 0x80 : 0) | opcode, 0x80 | 126, 0, 0]);
+    header.writeUInt16BE(data.length, 2);
+  } else {
+    header = Buffer.from([(fin ? 0x80 : 0) | opcode, 0x80 | 127, 0, 0, 0, 0, 0, 0, 0, 0]);
+    header.writeBigUInt64BE(BigInt(data.length), 2);
+  }
+  const masked = Buffer.from(data.map((b, i) => b ^ mask[i & 3]));
+  return Buffer.concat([header, mask, masked]);
+}
+
+function wsClose(code, reason = "") {
+  const payload = Buffer.alloc(2);
+  payload.writeUInt16BE(code);
+  return wsFrame(0x8, Buffer.concat([payload, Buffer.from(reason)]));
+}
+
+// Upgrades a raw connection to path, sends the given frames right after
+// the handshake and returns the server's frames once it closes the socket.
+// With `stall`, nothing is read for that many ms, so the server has to
+// queue what it sends.
+function wsExchange(path, frames, { ms = 2000, stall = 0 } = {}) {
+  return new Promise((resolve, reject) => {
+    const socket = net.connect(8080, "localhost");
+    let data = Buffer.alloc(0);
+    const done = closed => {
+      clearTimeout(timer);
+      socket.destroy();
+
+      const end = data.indexOf("\r\n\r\n");
+      const head = data.subarray(0, end).toString("latin1");
+      const received = [];
+      let pos = end + 4;
+      while (end >= 0 && pos + 2 <= data.length) {
+        let length = data[pos + 1] & 0x7f, offset = pos + 2;
+        if (length === 126) { length = data.readUInt16BE(offset); offset += 2; }
+        else if (length === 127) { length = Number(data.readBigUInt64BE(offset)); offset += 8; }
+        if (offset + length > data.length) break;
+        received.push({ opcode: data[pos] & 0x0f, fin: (data[pos] & 0x80) !== 0,
+                        payload: data.subarray(offset, offset + length) });
+        pos = offset + length;
+      }
+      resolve({ head, frames: received, closed });
+    };
+    const timer = setTimeout(() => done(false), ms);
+    if (stall) {
+      socket.pause();
+      setTimeout(() => socket.resume(), stall);
+    }
+    socket.on("connect", () => socket.write(Buffer.concat([
+      Buffer.from(`GET ${path} HTTP/1.1\r\nHost: localhost\r\nUpgrade: websocket\r\n` +
+                  "Connection: Upgrade\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n" +
+                  "Sec-WebSocket-Version: 13\r\n\r\n"),
+      ...frames,
+    ])));
+    socket.on("data", chunk => { data = Buffer.concat([data, chunk]); });
+    socket.on("end", () => done(true));
+    socket.on("error", reject);
+  });
+}
+
 async function createUser() {
   const res = await fetch(`${BASE}/users`, { method: "POST" });
   assertStatus(res, 201);
@@ -332,6 +422,18 @@ async function testConnectionClose() {
   if (!Array.isArray(json)) throw new Error("Expected array after Connection: close");
 }
 
+async function testConnectionTokensIgnoreCase() {
+  const closing = await rawExchange("GET /users HTTP/1.1\r\nHost: localhost\r\nConnection: Close\r\n\r\n");
+  if (!/\r\nConnection: close\r\n/.test(closing.text))
+    throw new Error("Expected Connection: close for \"Connection: Close\"");
+  if (!closing.closed) throw new Error("Server kept the socket open after \"Connection: Close\"");
+
+  const kept = await rawExchange("GET /users HTTP/1.0\r\nConnection: Keep-Alive, TE\r\nTE: trailers\r\n\r\n", 300);
+  if (!/\r\nConnection: keep-alive\r\n/.test(kept.text))
+    throw new Error("Expected Connection: keep-alive for an HTTP/1.0 token list");
+  if (kept.closed) throw new Error("Server closed an HTTP/1.0 keep-alive connection");
+}
+
 async function testCustomRequestHeaders() {
   const res = await fetch(`${BASE}/users`, {
     headers: {
@@ -349,6 +451,206 @@ async function testLargeIdDoesNotCrash() {
     throw new Error(`Expected 400 or 404 for oversized ID, got ${res.status}`);
 }
 
+async function staticHits() {
+  const text = await fetch(`${BASE}/metrics`).then(r => r.text());
+  const line = text.split("\n").find(l => l.startsWith('mini_http_requests_total{route="GET /health",status="200"}'));
+  return line ? Number(line.split(" ").pop()) : 0;
+}
+
+async function testStaticRouteIsCounted() {
+  const before = await staticHits();
+
+  for (let i = 0; i < 3; i++) {
+    const res = await fetch(`${BASE}/health`);
+    assertStatus(res, 200);
+    if (await res.text() !== "ok") throw new Error("Expected static body \"ok\"");
+  }
+
+  const after = await staticHits();
+  if (after - before !== 3)
+    throw new Error(`Expected 3 more GET /health requests in /metrics, got ${after - before}`);
+}
+
+async function testDeferThenThrowDoesNotLeakIntoNextRequest() {
+  const failing = fetch(`${BASE}/deferthrow`).then(r => r.text()).catch(() => null);
+  await new Promise(resolve => setTimeout(resolve, 170));
+
+  const bodies = await Promise.all(Array.from({ length: 5 }, () =>
+    fetch(`${BASE}/defer`).then(r => r.text())
+  ));
+  for (const body of bodies) {
+    if (body !== "deferred")
+      throw new Error(`Expected "deferred", got "${body}" (late send from another request)`);
+  }
+
+  const late = await failing;
+  if (late !== null && late !== "late")
+    throw new Error(`Unexpected body for the throwing handler: "${late}"`);
+}
+
+async function testDeferredSendDoesNotStallLoop() {
+  const socket = net.connect(8080, "localhost");
+  let received = 0, closed = false;
+  const finished = new Promise(resolve => {
+    socket.on("data", chunk => { received += chunk.length; });
+    socket.on("end", () => { closed = true; resolve(); });
+    socket.on("close", resolve);
+  });
+  socket.on("error", () => {});
+  socket.pause();
+  socket.write("GET /deferlarge HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n");
+  await new Promise(resolve => setTimeout(resolve, 200));
+
+  const start = Date.now();
+  const body = await fetch(`${BASE}/defer`).then(r => r.text());
+  const elapsed = Date.now() - start;
+
+  socket.resume();
+  await Promise.race([finished, new Promise(resolve => setTimeout(resolve, 5000))]);
+  socket.destroy();
+
+  if (body !== "deferred") throw new Error(`Expected "deferred", got "${body}"`);
+  if (elapsed > 1000)
+    throw new Error(`Deferred response took ${elapsed} ms while another client stalled`);
+  if (!closed || received < 4 * 1024 * 1024)
+    throw new Error(`Stalled client got ${received} bytes, expected the whole 4 MiB body`);
+}
+
+// The middleware under /late sets X-Unwound after next(); a response
+// completed elsewhere must wait for it instead of racing it.
+async function testLateMiddlewareRunsBeforeSend(path, body) {
+  const responses = await Promise.all(Array.from({ length: 10 }, () => fetch(`${BASE}${path}`)));
+  for (const res of responses) {
+    assertStatus(res, 200);
+    const text = await res.text();
+    if (text !== body) throw new Error(`Expected "${body}", got "${text}"`);
+    if (res.headers.get("x-unwound") !== "1")
+      throw new Error("Response sent while the middleware was still using it");
+  }
+}
+
+async function testPrivateResponsesAreNotCached() {
+  for (const path of ["/cached/cookie", "/cached/private", "/cached/vary", "/cached/optout"]) {
+    const first = await fetch(`${BASE}${path}`).then(r => r.text());
+    const second = await fetch(`${BASE}${path}`).then(r => r.text());
+    if (first === second)
+      throw new Error(`${path} answered from the cache ("${first}" twice)`);
+  }
+}
+
+async function testCacheHitWithinTtl() {
+  const first = await fetch(`${BASE}/cached`).then(r => r.text());
+  const second = await fetch(`${BASE}/cached`).then(r => r.text());
+  if (first !== second)
+    throw new Error(`Second GET ran the handler again ("${first}" then "${second}")`);
+}
+
+// The demo closes keep-alive connections after 50 requests.
+async function testMaxRequestsClosesConnection() {
+  const request = "GET /health HTTP/1.1\r\nHost: localhost\r\n\r\n";
+  const { text, closed } = await rawExchange(request.repeat(51), 2000);
+
+  const heads = text.split("HTTP/1.1 ").slice(1);
+  if (heads.length !== 50) throw new Error(`Expected 50 responses, got ${heads.length}`);
+  if (!/\r\nConnection: close\r\n/i.test(heads[49]))
+    throw new Error("Response 50 does not say Connection: close");
+  if (heads.slice(0, 49).some(h => /\r\nConnection: close\r\n/i.test(h)))
+    throw new Error("Connection: close sent before request 50");
+  if (!closed) throw new Error("Connection left open after request 50");
+}
+
+// /slow has a 50 ms deadline, counted from the first byte of the request.
+async function testExpiredDeadlineIs503() {
+  const { text } = await new Promise((resolve, reject) => {
+    const socket = net.connect(8080, "localhost");
+    let data = "";
+    socket.on("connect", () => {
+      socket.write("GET /slow HTTP/1.1\r\n");
+      setTimeout(() => socket.write("Host: localhost\r\nConnection: close\r\n\r\n"), 150);
+    });
+    socket.on("data", chunk => { data += chunk.toString("latin1"); });
+    socket.on("end", () => resolve({ text: data }));
+    socket.on("error", reject);
+  });
+  if (!text.startsWith("HTTP/1.1 503"))
+    throw new Error(`Expected 503, got "${text.split("\r\n")[0]}"`);
+
+  const inTime = await fetch(`${BASE}/slow`);
+  assertStatus(inTime, 200);
+}
+
+async function testEventFieldsCannotInjectLines() {
+  const res = await fetch(`${BASE}/events`);
+  assertStatus(res, 200);
+  const body = await res.text();
+  const expected = "data: rejected\n\ndata: a\ndata: b\n\n";
+  if (body !== expected)
+    throw new Error(`Expected ${JSON.stringify(expected)}, got ${JSON.stringify(body)}`);
+}
+
+async function testWebSocketRejectsReservedCloseCodes() {
+  for (const code of [999, 1005, 1006, 1015, 2000]) {
+    const { frames, closed } = await wsExchange("/echo", [wsClose(code)]);
+    const close = frames.find(f => f.opcode === 0x8);
+    if (!close) throw new Error(`No close frame after close code ${code}`);
+    if (close.payload.readUInt16BE(0) !== 1002)
+      throw new Error(`Close code ${code} answered with ${close.payload.readUInt16BE(0)}, expected 1002`);
+    if (!closed) throw new Error(`Connection left open after close code ${code}`);
+  }
+}
+
+async function testWebSocketCloseFollowsQueuedFrames() {
+  const message = "x".repeat(900 * 1024);
+  const messages = Array.from({ length: 3 }, () => wsFrame(0x1, message));
+  const { frames, closed } = await wsExchange("/echo", [...messages, wsClose(1000, "bye")], { stall: 300 });
+
+  const echoed = frames.filter(f => f.opcode === 0x1).map(f => f.payload.length).reduce((a, b) => a + b, 0);
+  if (echoed !== 3 * message.length) throw new Error(`Echo truncated to ${echoed} bytes`);
+
+  const close = frames[frames.length - 1];
+  if (!close || close.opcode !== 0x8 || close.payload.readUInt16BE(0) !== 1000)
+    throw new Error("Expected the close frame (1000) after the echo");
+  if (!closed) throw new Error("Connection left open after the close handshake");
+}
+
+async function testWebSocketEchoAndClose() {
+  const { head, frames, closed } = await wsExchange("/echo", [wsFrame(0x1, "hello"), wsClose(1000, "bye")]);
+  if (!head.startsWith("HTTP/1.1 101")) throw new Error(`Expected 101, got "${head.split("\r\n")[0]}"`);
+
+  const [echo, close] = frames;
+  if (!echo || echo.opcode !== 0x1 || echo.payload.toString() !== "hello")
+    throw new Error("Expected the text frame echoed back");
+  if (!close || close.opcode !== 0x8 || close.payload.readUInt16BE(0) !== 1000)
+    throw new Error("Expected the close frame answered with 1000");
+  if (!closed) throw new Error("Connection left open after the close handshake");
+}
+
+async function testHttp2PriorKnowledgeLargeBody() {
+  const session = http2.connect(BASE);
+  try {
+    const { status, body } = await new Promise((resolve, reject) => {
+      const timer = setTimeout(() => reject(new Error("HTTP/2 request timed out")), 5000);
+      const stream = session.request({ ":path": "/large" });
+      const chunks = [];
+      let status;
+      stream.on("response", headers => { status = headers[":status"]; });
+      stream.on("data", chunk => chunks.push(chunk));
+      stream.on("end", () => { clearTimeout(timer); resolve({ status, body: Buffer.concat(chunks) }); });
+      stream.on("error", reject);
+      session.on("error", reject);
+      stream.end();
+    });
+
+    if (status !== 200) throw new Error(`Expected 200, got ${status}`);
+    if (body.length !== 256 * 1024) throw new Error(`Expected 262144 bytes, got ${body.length}`);
+    for (let i = 0; i < body.length; ++i) {
+      if (body[i] !== 97 + (i % 26)) throw new Error(`Body corrupted at byte ${i}`);
+    }
+  } finally {
+    session.close();
+  }
+}
+
 async function runAll() {
   console.log("Running Mini_http tests...\n");
 
@@ -383,7 +685,28 @@ async function runAll() {
   await runTest("Mixed endpoints (50 par.) → routing stable under load", testConcurrentMixedEndpoints);
   await runTest("Rapid fire (100 seq.) → no state leak", testRapidFireDoesNotLeak);
   await runTest("Connection: close → 200, valid JSON", testConnectionClose);
+  await runTest("Connection: Close / Keep-Alive, TE → tokens matched ignoring case", testConnectionTokensIgnoreCase);
   await runTest("Custom request headers → no crash", testCustomRequestHeaders);
+  await runTest("GET /health (static) → counted under its route in /metrics", testStaticRouteIsCounted);
+  await runTest("defer() then throw → late send stays on its connection", testDeferThenThrowDoesNotLeakIntoNextRequest);
+  await runTest("Deferred 4 MiB to a stalled reader → loop keeps serving, body arrives", testDeferredSendDoesNotStallLoop);
+  await runTest("defer() resolved in the handler → sent after middleware unwinds",
+                () => testLateMiddlewareRunsBeforeSend("/late/defer", "deferred"));
+  await runTest(".offload() route → handler runs after middleware unwinds",
+                () => testLateMiddlewareRunsBeforeSend("/late/offload", "offloaded"));
+  await runTest("GET /cached x2 within TTL → served from the cache", testCacheHitWithinTtl);
+  await runTest("Set-Cookie / private / Vary / shareable(false) → never cached", testPrivateResponsesAreNotCached);
+  await runTest("51 pipelined requests → 50 answered, the last with Connection: close", testMaxRequestsClosesConnection);
+  await runTest("Request past its route deadline → 503", testExpiredDeadlineIs503);
+  await runTest("SSE id with CR/LF → rejected, data split on lone CR", testEventFieldsCannotInjectLines);
+
+  console.log("\n── HTTP/2 ─────────────────────────────────────────────────");
+  await runTest("h2c prior knowledge GET /large → 256 KiB over many DATA frames", testHttp2PriorKnowledgeLargeBody);
+
+  console.log("\n── WebSocket ──────────────────────────────────────────────");
+  await runTest("Echo, then close 1000 → echoed frame and close handshake", testWebSocketEchoAndClose);
+  await runTest("Close with 1005/1006/1015/reserved code → 1002", testWebSocketRejectsReservedCloseCodes);
+  await runTest("Echo 3 x 900 KiB to a stalled reader, then close → all frames arrive", testWebSocketCloseFollowsQueuedFrames);
 
   console.log(`${passed} passed | ${failed} failed | ${passed + failed} total`);
 